@@ -1,17 +1,26 @@
 #include <chrono>
 #include <memory>
+#include <optional>
 #include <string_view>
 #include <thread>
+#include <tuple>
+import jowi.alloc_tracker;
 import jowi.crogger;
 import jowi.cli;
 import jowi.test_lib;
 namespace crogger = jowi::crogger;
 namespace cli = jowi::cli;
+namespace alloc_tracker = jowi::alloc_tracker;
 namespace test_lib = jowi::test_lib;
 
 auto crogger_id = cli::AppIdentity{.name = "Crogger Benchmarker"};
 
-crogger::Logger create_logger(std::string_view formatter, std::string_view emitter) {
+crogger::Logger create_logger(
+  std::string_view formatter,
+  std::string_view emitter,
+  std::string_view clock,
+  std::optional<unsigned int> record_limit
+) {
   crogger::Logger logger;
   if (formatter == "bw") {
     logger.set_formatter(crogger::BwFormatter());
@@ -23,18 +32,27 @@ crogger::Logger create_logger(std::string_view formatter, std::string_view emitt
   if (emitter == "empty") {
     logger.set_emitter(crogger::EmptyEmitter{});
   }
+  if (clock == "tsc") {
+    logger.set_clock(crogger::TscClock{});
+  }
+  if (record_limit) {
+    logger.set_record_limit(record_limit.value());
+  }
   return logger;
 }
 
 template <class F, class... Args>
   requires(std::invocable<F, Args...>)
-std::pair<std::invoke_result_t<F, Args...>, std::chrono::system_clock::duration> invoke_bench(
-  F &&f, Args &&...args
-) {
+std::tuple<
+  std::invoke_result_t<F, Args...>,
+  std::chrono::system_clock::duration,
+  alloc_tracker::AllocStats>
+  invoke_bench(F &&f, Args &&...args) {
+  alloc_tracker::AllocScope scope;
   auto beg = std::chrono::system_clock::now();
   auto res = std::invoke(std::forward<F>(f), std::forward<Args>(args)...);
   auto end = std::chrono::system_clock::now();
-  return std::pair{std::move(res), end - beg};
+  return std::tuple{std::move(res), end - beg, scope.stats()};
 }
 
 auto log_messages(const crogger::Logger &logger, std::string_view msg, unsigned count) {
@@ -54,6 +72,10 @@ int main(int argc, const char **argv) {
     .help("The length of messages to print per log, the default is to print: 80")
     .require_value()
     .optional();
+  app.add_argument("--record_limit")
+    .help("Render records into a bounded inline buffer of this many bytes")
+    .require_value()
+    .optional();
   app.add_argument("--emit")
     .help("The output emitter to use. The default is stdout")
     .require_value()
@@ -64,6 +86,16 @@ int main(int argc, const char **argv) {
         .move()
     )
     .optional();
+  app.add_argument("--clock")
+    .help("The source of record timestamps. The default is system")
+    .require_value()
+    .add_validator(
+      cli::ArgOptionsValidator{}
+        .add_option("system", "std::chrono::system_clock")
+        .add_option("tsc", "the CPU timestamp counter calibrated to the system clock")
+        .move()
+    )
+    .optional();
   app.add_argument("--format")
     .help("The format for the logger")
     .require_value()
@@ -87,16 +119,33 @@ int main(int argc, const char **argv) {
     app.args().first_of("--format").transform(cli::parse_arg<std::string>).value_or("color");
   auto emitter =
     app.args().first_of("--emit").transform(cli::parse_arg<std::string>).value_or("stdout");
+  auto clock =
+    app.args().first_of("--clock").transform(cli::parse_arg<std::string>).value_or("system");
+  auto record_limit = app.args().first_of("--record_limit").transform([&](std::string_view v) {
+    return app.expect(cli::parse_arg<unsigned int>(v));
+  });
   auto rnd_msg = test_lib::random_string(log_msg_length);
   crogger::warn(crogger::Message{"Begin: Logger Init"});
-  auto [logger, logger_init_time] = invoke_bench(create_logger, formatter, emitter);
-  crogger::warn(crogger::Message{"End: Logger Init ({})", logger_init_time});
+  auto [logger, logger_init_time, logger_init_allocs] =
+    invoke_bench(create_logger, formatter, emitter, clock, record_limit);
+  crogger::warn(
+    crogger::Message{
+      "End: Logger Init ({}, {} allocations, {} bytes)",
+      logger_init_time,
+      logger_init_allocs.allocations,
+      logger_init_allocs.bytes
+    }
+  );
   crogger::warn(crogger::Message{"Begin: Log Message"});
-  auto [log_count, logger_log_time] = invoke_bench(log_messages, logger, rnd_msg, count);
+  auto [log_count, logger_log_time, logger_log_allocs] =
+    invoke_bench(log_messages, logger, rnd_msg, count);
   crogger::warn(
     crogger::Message{
-      "End: Log Message ({})",
-      std::chrono::duration_cast<std::chrono::milliseconds>(logger_log_time)
+      "End: Log Message ({}, {} allocations, {} bytes, {} bytes peak)",
+      std::chrono::duration_cast<std::chrono::milliseconds>(logger_log_time),
+      logger_log_allocs.allocations,
+      logger_log_allocs.bytes,
+      logger_log_allocs.peak
     }
   );
   std::this_thread::sleep_for(std::chrono::seconds{1});
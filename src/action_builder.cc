@@ -1,79 +1,324 @@
 module;
-#include <cstdlib>
+#include <atomic>
+#include <cstdio>
+#include <deque>
+#include <exception>
+#include <expected>
+#include <format>
 #include <functional>
+#include <memory>
 #include <optional>
+#include <span>
 #include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
 export module jowi.cli:action_builder;
-import jowi.generic;
 import :app;
+import :arg;
+import :command_source;
+import :parse_error;
+import :parsed_arg;
+import :profiler;
+import :raw_args;
+import :shell_lexer;
+import :work_pool;
 import jowi.tui;
 namespace tui = jowi::tui;
 
 namespace jowi::cli {
   struct AppAction {
-    std::function<void(App &)> action;
+    std::string name;
     std::string help_text;
+    std::function<void(App &)> action;
 
     void run(App &app_) const {
       action(app_);
     }
   };
+
+  /*
+    ActionTable
+    the actions of one level of the command tree, found by name through a hash index. Actions
+    live in a deque such that the names keying the index stay valid as actions are added.
+  */
+  struct ActionTable {
+    std::deque<AppAction> actions;
+    std::unordered_map<std::string_view, uint32_t> index;
+
+    // declares name, replacing the previous action of the same name
+    void emplace(std::string_view name, std::string help_text, std::function<void(App &)> f) {
+      if (auto it = index.find(name); it != index.end()) {
+        auto &action = actions[it->second];
+        action.help_text = std::move(help_text);
+        action.action = std::move(f);
+        return;
+      }
+      auto &action =
+        actions.emplace_back(AppAction{std::string{name}, std::move(help_text), std::move(f)});
+      index.emplace(action.name, static_cast<uint32_t>(actions.size() - 1));
+    }
+    const AppAction *find(std::string_view name) const noexcept {
+      auto it = index.find(name);
+      return it == index.end() ? nullptr : &actions[it->second];
+    }
+  };
+
+  /*
+    ActionValidator
+    accepts the names of the ActionTable it shares with its builder. Actions added later are
+    accepted without rebuilding the validator, and the help listing them is only rendered when
+    printed.
+  */
+  struct ActionValidator {
+    std::shared_ptr<const ActionTable> table;
+
+    static constexpr std::string_view id = "arg_options";
+    std::optional<tui::DomNode> help() const {
+      if (table->actions.empty()) {
+        return std::nullopt;
+      }
+      auto layout = tui::Layout{};
+      layout.append_child(tui::DomNode::paragraph("Options:"));
+      auto entries = tui::Layout{}.style(tui::DomStyle{}.indent(2));
+      for (const auto &action : table->actions) {
+        entries.append_child(
+          tui::DomNode::paragraph(std::format("- {}: {}", action.name, action.help_text))
+        );
+      }
+      layout.append_child(tui::DomNode::vstack(std::move(entries)));
+      return tui::DomNode::vstack(std::move(layout));
+    }
+    std::expected<void, ParseError> validate(std::optional<std::string_view> value) const {
+      if (!value) {
+        return std::unexpected{ParseError{ParseErrorType::NO_VALUE_GIVEN, ""}};
+      }
+      if (table->find(value.value()) == nullptr) {
+        return std::unexpected{
+          ParseError{ParseErrorType::INVALID_VALUE, "{} is not a valid option.", value.value()}
+        };
+      }
+      return {};
+    }
+  };
+
+  /*
+    BatchCommand
+    one line of ActionBuilder::batch: its tokens, viewing line, and once done is set the exit
+    code and captured output of the command.
+  */
+  struct BatchCommand {
+    uint64_t line_no;
+    std::string line;
+    std::vector<std::string_view> tokens;
+    std::string out;
+    std::string err;
+    int code;
+    std::atomic<bool> done;
+
+    BatchCommand(uint64_t line_no, std::string line) :
+      line_no{line_no}, line{std::move(line)}, tokens{}, out{}, err{}, code{0}, done{false} {}
+  };
+  /*
+    ActionBuilder
+    chooses an action from the positional it declares. Nested commands (tool a b c) are groups
+    whose actions are declared by a builder for the next positional, created only once the
+    group was chosen: each level is a hash lookup, and the branches not taken cost a table entry
+    and their closure, none of their arguments or actions being declared.
+  */
   export struct ActionBuilder {
   private:
-    generic::KeyVector<std::string, AppAction> __actions;
+    std::shared_ptr<ActionTable> __actions;
     std::reference_wrapper<App> __app;
-    std::reference_wrapper<Arg> __arg;
-    bool __arg_updated;
     uint64_t __id;
 
   public:
     ActionBuilder(App &app_, std::optional<std::string> help_text) :
-      __app{std::ref(app_)}, __arg{std::ref(__app.get().add_argument())},
-      __id{__app.get().parser().size() - 1} {
+      __actions{std::make_shared<ActionTable>()}, __app{std::ref(app_)},
+      __id{__app.get().parser().size()} {
+      Arg &arg = __app.get().add_argument();
       if (help_text) {
-        __arg.get().help(help_text.value());
+        arg.help(help_text.value());
       }
-      __arg_updated = false;
+      arg.add_validator(ActionValidator{__actions});
     }
 
     template <class F>
       requires(std::is_invocable_r_v<void, F, App &>)
     ActionBuilder &add_action(std::string_view name, std::string help_text, F &&f) {
-      __actions.emplace(name, AppAction{f, std::move(help_text)});
-      __arg_updated = false;
+      __actions->emplace(name, std::move(help_text), std::forward<F>(f));
       return *this;
     }
 
-    ActionBuilder &update_args() {
-      if (!__arg_updated) {
-        auto options = ArgOptionsValidator{};
-        for (const auto &[n, a] : __actions) {
-          options.add_option(n, a.help_text);
+    /*
+      add_group
+      declares name as a group of nested actions. declare(builder) adds the actions of the group
+      to a builder for the next positional; it is called when name is chosen, never otherwise.
+    */
+    template <class F>
+      requires(std::is_invocable_r_v<void, F &, ActionBuilder &>)
+    ActionBuilder &add_group(std::string_view name, std::string help_text, F &&declare) {
+      auto group_help = help_text;
+      return add_action(
+        name,
+        std::move(help_text),
+        [declare = std::forward<F>(declare), group_help = std::move(group_help)](App &app) {
+          ActionBuilder group{app, group_help};
+          std::invoke(declare, group);
+          group.run();
         }
-        __arg.get().add_validator(std::move(options));
-        __arg_updated = true;
-      }
+      );
+    }
+
+    // the options of the positional follow the actions, there is nothing left to synchronize
+    ActionBuilder &update_args() {
       return *this;
     }
 
     void run() {
-      auto &app = __app.get();
-      update_args();
+      __dispatch(__app.get());
+    }
+
+  private:
+    void __dispatch(App &app) {
       app.parse_args(false);
       if (app.args().size() - 1 != __id) {
         if (app.args().contains("-h") || app.args().contains("--help")) {
           app.print_help();
-          std::exit(0);
         }
         app.error(1, "arg{}: {}", __id, ParseErrorType::NO_VALUE_GIVEN);
       }
       auto arg_value = app.args().arg();
-      auto action = __actions.get(arg_value);
-      if (!action) {
-        std::exit(1);
+      auto action = __actions->find(arg_value);
+      if (action == nullptr) {
+        App::exit(1);
       } else {
-        action->get().run(app);
+        ProfilePhase phase{"action", arg_value};
+        action->run(app);
+      }
+    }
+
+  public:
+    /*
+      serve
+      runs the command of every line source gives, as if the program had been started with the
+      line as its arguments. The App is built once: every command reuses its parser, rolled back
+      to the arguments declared before serve, the cached help, and the storage of the previous
+      command's line, tokens and parsed values. An error or help request ends the command only.
+      Returns the exit code of the last command.
+    */
+    int serve(CommandSource &source) {
+      auto &app = __app.get();
+      AppSession session{app};
+      ShellLexer lexer;
+      std::string line;
+      std::vector<std::string_view> command;
+      int code = 0;
+      while (source.next_line(line)) {
+        source.begin_command();
+        code = session.run([&](App &) {
+          auto tokens = lexer.split(line);
+          if (!tokens) {
+            App::error(1, "{}", tokens.error().what());
+          }
+          if (tokens->empty()) {
+            return;
+          }
+          command.clear();
+          command.emplace_back(app.program());
+          command.insert(command.end(), tokens->begin(), tokens->end());
+          app.reset_args(RawArgs{command});
+          run();
+        });
+        source.end_command(code);
+      }
+      return code;
+    }
+
+    /*
+      batch
+      runs the command of every line source gives, as serve does, on workers threads. All lines
+      are split and parsed up to the action first, such that a script with a mistake fails before
+      its first command runs. The commands then run concurrently and must be independent of each
+      other: each on the clone of the App owned by its worker, with its own parsed arguments,
+      taken from a work stealing pool. What a command prints to App::out and App::err is captured
+      and written in the order of the script as soon as the commands before it are done. Returns
+      0 when every command succeeded, the exit code of the first failing one otherwise.
+    */
+    int batch(CommandSource &source, uint64_t workers = std::thread::hardware_concurrency()) {
+      auto &app = __app.get();
+      std::deque<BatchCommand> commands;
+      {
+        ShellLexer lexer;
+        std::string line;
+        ParsedArg parsed{RawArgs{std::span<const std::string_view>{}}};
+        uint64_t line_no = 0;
+        while (source.next_line(line)) {
+          line_no += 1;
+          auto &command = commands.emplace_back(line_no, std::move(line));
+          auto tokens = lexer.split(command.line);
+          if (!tokens) {
+            App::error(1, "line {}: {}", line_no, tokens.error().what());
+          }
+          if (tokens->empty()) {
+            commands.pop_back();
+            continue;
+          }
+          command.tokens.emplace_back(app.program());
+          command.tokens.insert(command.tokens.end(), tokens->begin(), tokens->end());
+          parsed.reset(RawArgs{command.tokens});
+          auto res = app.parser().parse(parsed);
+          if (!res) {
+            App::error(1, "line {}: {}", line_no, res.error().what());
+          }
+          if (parsed.size() - 1 != __id) {
+            App::error(1, "line {}: arg{}: {}", line_no, __id, ParseErrorType::NO_VALUE_GIVEN);
+          }
+        }
+      }
+
+      std::vector<std::optional<App>> clones(workers == 0 ? 1 : workers);
+      WorkStealingPool pool{commands.size(), clones.size(), [&](uint64_t w, uint64_t i) {
+        auto &command = commands[i];
+        if (!clones[w]) {
+          clones[w].emplace(app.clone());
+        }
+        {
+          AppCapture capture;
+          AppSession session{*clones[w]};
+          command.code = session.run([&](App &clone) {
+            try {
+              clone.reset_args(RawArgs{command.tokens});
+              __dispatch(clone);
+            } catch (const AppExit &) {
+              throw;
+            } catch (const std::exception &e) {
+              App::error(1, "line {}: {}", command.line_no, e.what());
+            }
+          });
+          command.out = capture.out();
+          command.err = capture.err();
+        }
+        command.done.store(true, std::memory_order_release);
+        command.done.notify_one();
+      }};
+
+      int code = 0;
+      for (auto &command : commands) {
+        command.done.wait(false, std::memory_order_acquire);
+        std::fwrite(command.out.data(), 1, command.out.size(), App::out());
+        std::fwrite(command.err.data(), 1, command.err.size(), App::err());
+        std::fflush(App::out());
+        std::fflush(App::err());
+        if (code == 0) {
+          code = command.code;
+        }
+        command.out = std::string{};
+        command.err = std::string{};
       }
+      return code;
     }
   };
 }
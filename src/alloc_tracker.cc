@@ -0,0 +1,204 @@
+module;
+#include <malloc.h>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+export module jowi.alloc_tracker;
+
+/*
+  The replaceable global allocation functions of this file count every allocation of the thread
+  making it. Linking jowi_alloc_tracker is the opt in: the functions are pulled into a program
+  together with the rest of this module, the first time it uses thread_stats() or AllocScope.
+  Sizes are the usable sizes reported by malloc, such that nothing is stored next to the blocks.
+*/
+namespace jowi::alloc_tracker {
+  struct ThreadCounts {
+    uint64_t allocations;
+    uint64_t deallocations;
+    uint64_t bytes;
+    // may go negative on a thread freeing what another thread allocated
+    int64_t live;
+    int64_t peak;
+  };
+
+  constinit thread_local ThreadCounts counts{};
+
+  void note_allocation(void *p) noexcept {
+    auto size = static_cast<int64_t>(malloc_usable_size(p));
+    counts.allocations += 1;
+    counts.bytes += static_cast<uint64_t>(size);
+    counts.live += size;
+    counts.peak = std::max(counts.peak, counts.live);
+  }
+
+  void note_deallocation(void *p) noexcept {
+    if (p == nullptr) {
+      return;
+    }
+    counts.deallocations += 1;
+    counts.live -= static_cast<int64_t>(malloc_usable_size(p));
+  }
+
+  void *try_allocate(std::size_t size, std::size_t align) noexcept {
+    size = std::max<std::size_t>(size, 1);
+    void *p = align <= alignof(std::max_align_t)
+      ? std::malloc(size)
+      : std::aligned_alloc(align, (size + align - 1) / align * align);
+    if (p != nullptr) {
+      note_allocation(p);
+    }
+    return p;
+  }
+
+  void *allocate(std::size_t size, std::size_t align) {
+    while (true) {
+      if (void *p = try_allocate(size, align)) {
+        return p;
+      }
+      auto handler = std::get_new_handler();
+      if (handler == nullptr) {
+        throw std::bad_alloc{};
+      }
+      handler();
+    }
+  }
+
+  void *allocate_nothrow(std::size_t size, std::size_t align) noexcept {
+    try {
+      return allocate(size, align);
+    } catch (...) {
+      return nullptr;
+    }
+  }
+
+  void deallocate(void *p) noexcept {
+    note_deallocation(p);
+    std::free(p);
+  }
+
+  /*
+    AllocStats
+    the allocations made, the bytes handed out for them and the highest amount of bytes live at
+    once, counted on one thread.
+  */
+  export struct AllocStats {
+    uint64_t allocations;
+    uint64_t deallocations;
+    uint64_t bytes;
+    uint64_t peak;
+
+    bool allocation_free() const noexcept {
+      return allocations == 0;
+    }
+  };
+
+  /*
+    thread_stats
+    everything the calling thread counted since it started, peak is the peak live heap of the
+    thread.
+  */
+  export AllocStats thread_stats() noexcept {
+    return AllocStats{
+      counts.allocations,
+      counts.deallocations,
+      counts.bytes,
+      static_cast<uint64_t>(std::max<int64_t>(counts.peak, 0))
+    };
+  }
+
+  /*
+    AllocScope
+    counts the allocations of the calling thread from its construction on. peak is the highest
+    live heap above the one of the construction. Scopes nest, but have to be destroyed on the
+    thread that created them, in reverse order.
+  */
+  export struct AllocScope {
+  private:
+    ThreadCounts __start;
+
+  public:
+    AllocScope() noexcept : __start{counts} {
+      counts.peak = counts.live;
+    }
+    AllocScope(const AllocScope &) = delete;
+    AllocScope &operator=(const AllocScope &) = delete;
+    ~AllocScope() {
+      counts.peak = std::max(counts.peak, __start.peak);
+    }
+
+    AllocStats stats() const noexcept {
+      return AllocStats{
+        counts.allocations - __start.allocations,
+        counts.deallocations - __start.deallocations,
+        counts.bytes - __start.bytes,
+        static_cast<uint64_t>(std::max<int64_t>(counts.peak - __start.live, 0))
+      };
+    }
+  };
+}
+
+extern "C++" {
+  void *operator new(std::size_t size) {
+    return jowi::alloc_tracker::allocate(size, alignof(std::max_align_t));
+  }
+  void *operator new[](std::size_t size) {
+    return jowi::alloc_tracker::allocate(size, alignof(std::max_align_t));
+  }
+  void *operator new(std::size_t size, std::align_val_t align) {
+    return jowi::alloc_tracker::allocate(size, static_cast<std::size_t>(align));
+  }
+  void *operator new[](std::size_t size, std::align_val_t align) {
+    return jowi::alloc_tracker::allocate(size, static_cast<std::size_t>(align));
+  }
+  void *operator new(std::size_t size, const std::nothrow_t &) noexcept {
+    return jowi::alloc_tracker::allocate_nothrow(size, alignof(std::max_align_t));
+  }
+  void *operator new[](std::size_t size, const std::nothrow_t &) noexcept {
+    return jowi::alloc_tracker::allocate_nothrow(size, alignof(std::max_align_t));
+  }
+  void *operator new(std::size_t size, std::align_val_t align, const std::nothrow_t &) noexcept {
+    return jowi::alloc_tracker::allocate_nothrow(size, static_cast<std::size_t>(align));
+  }
+  void *operator new[](std::size_t size, std::align_val_t align, const std::nothrow_t &) noexcept {
+    return jowi::alloc_tracker::allocate_nothrow(size, static_cast<std::size_t>(align));
+  }
+
+  void operator delete(void *p) noexcept {
+    jowi::alloc_tracker::deallocate(p);
+  }
+  void operator delete[](void *p) noexcept {
+    jowi::alloc_tracker::deallocate(p);
+  }
+  void operator delete(void *p, std::size_t) noexcept {
+    jowi::alloc_tracker::deallocate(p);
+  }
+  void operator delete[](void *p, std::size_t) noexcept {
+    jowi::alloc_tracker::deallocate(p);
+  }
+  void operator delete(void *p, std::align_val_t) noexcept {
+    jowi::alloc_tracker::deallocate(p);
+  }
+  void operator delete[](void *p, std::align_val_t) noexcept {
+    jowi::alloc_tracker::deallocate(p);
+  }
+  void operator delete(void *p, std::size_t, std::align_val_t) noexcept {
+    jowi::alloc_tracker::deallocate(p);
+  }
+  void operator delete[](void *p, std::size_t, std::align_val_t) noexcept {
+    jowi::alloc_tracker::deallocate(p);
+  }
+  void operator delete(void *p, const std::nothrow_t &) noexcept {
+    jowi::alloc_tracker::deallocate(p);
+  }
+  void operator delete[](void *p, const std::nothrow_t &) noexcept {
+    jowi::alloc_tracker::deallocate(p);
+  }
+  void operator delete(void *p, std::align_val_t, const std::nothrow_t &) noexcept {
+    jowi::alloc_tracker::deallocate(p);
+  }
+  void operator delete[](void *p, std::align_val_t, const std::nothrow_t &) noexcept {
+    jowi::alloc_tracker::deallocate(p);
+  }
+}
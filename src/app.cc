@@ -1,10 +1,14 @@
 module;
 #include <algorithm>
+#include <cstdio>
 #include <cstdlib>
+#include <exception>
 #include <expected>
 #include <format>
 #include <iterator>
+#include <memory>
 #include <print>
+#include <span>
 #include <source_location>
 #include <string>
 #include <string_view>
@@ -17,35 +21,112 @@ import :arg_parser;
 import :parsed_arg;
 import :raw_args;
 import :app_identity;
+import :profiler;
 namespace tui = jowi::tui;
 
 namespace jowi::cli {
+  /*
+    AppExit
+    thrown instead of exiting the process by App::exit and the paths leading to it (error,
+    expect, print_help) while an AppSession is running, such that one command ends and the next
+    one can run.
+  */
+  export struct AppExit : public std::exception {
+    int code;
+
+    AppExit(int code) noexcept : code{code} {}
+    const char *what() const noexcept override {
+      return "application exit";
+    }
+  };
+
   export struct App {
   private:
+    std::unique_ptr<StartupProfiler> __profiler;
     ParsedArg __args;
     ArgParser __parser;
+    std::string_view __program;
+    // the rendered help of the whole app, rebuilt once arguments were declared since
+    uint64_t __generation;
+    mutable uint64_t __help_generation;
+    mutable std::string __help_cache;
+
+    static inline thread_local uint64_t __sessions = 0;
+    // where the calling thread prints, set while an AppCapture is alive
+    static inline thread_local FILE *__out = nullptr;
+    static inline thread_local FILE *__err = nullptr;
+    friend struct AppSession;
+    friend struct AppCapture;
+
+    App(AppIdentity id, ArgParser parser, std::string_view program) :
+      __profiler{}, __args{RawArgs{std::span<const std::string_view>{}}},
+      __parser{std::move(parser)}, __program{program}, __generation{0}, __help_generation{0},
+      __help_cache{}, id{std::move(id)} {}
+
+    static std::unique_ptr<StartupProfiler> __start_profiler(RawArgs args) {
+      auto profiler = StartupProfiler::from_args(args);
+      if (profiler) {
+        StartupProfiler::activate(profiler.get());
+        profiler->step("construction");
+      }
+      return profiler;
+    }
+    void __step(std::string_view name) {
+      if (__profiler) {
+        __profiler->step(name);
+      }
+    }
 
   public:
     AppIdentity id;
+    /*
+      Passing the hidden --profile-startup[=json] argument times the phases of the run
+      (construction, argument declaration, parsing and validation, help, actions), printed to
+      stderr at exit. See StartupProfiler.
+    */
     App(AppIdentity id, int argc, const char **argv, const char **envp = nullptr) :
-      __args{RawArgs{argc, argv}}, __parser{}, id{std::move(id)} {
+      __profiler{__start_profiler(RawArgs{argc, argv})}, __args{RawArgs{argc, argv}}, __parser{},
+      __program{argc > 0 ? argv[0] : ""}, __generation{0}, __help_generation{0}, __help_cache{},
+      id{std::move(id)} {
       add_help_argument();
+      __step("declare");
+    }
+    App(App &&) = default;
+    App &operator=(App &&) = default;
+    ~App() {
+      if (__profiler) {
+        __profiler->report();
+      }
     }
 
     static App create(AppIdentity id, int argc, const char **argv, const char **envp = nullptr) {
       return App{std::move(id), argc, argv, envp};
     }
 
-    Arg &add_argument() {
+    /*
+      clone
+      an App with the same identity, program and declared arguments, e.g. for running commands
+      on another thread. Parsed values are not copied and the clone does not profile.
+    */
+    App clone() const {
+      return App{id, __parser, __program};
+    }
 
+    Arg &add_argument() {
+      ProfilePhase phase{"add_argument"};
       Arg &arg = __parser.add_argument();
+      __generation += 1;
       add_help_argument();
       return arg;
     }
     Arg &add_argument(ArgKey k, Arg arg = Arg::flag()) {
+      ProfilePhase phase{"add_argument"};
+      __generation += 1;
       return __parser.add_argument(std::move(k), std::move(arg));
     }
     Arg &add_argument(std::string_view k, Arg arg = Arg::flag()) {
+      ProfilePhase phase{"add_argument"};
+      __generation += 1;
       return __parser.add_argument(std::move(k), std::move(arg));
     }
 
@@ -55,11 +136,36 @@ namespace jowi::cli {
     const ArgParser &parser() const noexcept {
       return __parser;
     }
+    std::string_view program() const noexcept {
+      return __program;
+    }
+
+    /*
+      out / err
+      where the help, errors and the output of actions go: stdout and stderr, unless an
+      AppCapture collects what the calling thread prints.
+    */
+    static FILE *out() noexcept {
+      return __out != nullptr ? __out : stdout;
+    }
+    static FILE *err() noexcept {
+      return __err != nullptr ? __err : stderr;
+    }
+
+    /*
+      reset_args
+      makes args the arguments the next parse_args reads, e.g. one command of an AppSession. The
+      values of the previous parse are forgotten, their storage is reused.
+    */
+    void reset_args(RawArgs args) noexcept {
+      __args.reset(args);
+    }
 
     /*
       Formatting with Error and Help
     */
     tui::DomNode help_dom() const {
+      ProfilePhase phase{"help_dom"};
       auto layout =
         tui::Layout{}.style(help_style).append_child(tui::Paragraph("{} v{}", id.name, id.version));
       if (!id.description.empty()) {
@@ -100,6 +206,9 @@ namespace jowi::cli {
           section.append_child(tui::Paragraph("Keyword Arguments:"));
           auto keyword_layout = tui::Layout{}.style(tui::DomStyle{}.indent(2));
           for (const auto &[k, validator_arg] : (*arg)) {
+            if (validator_arg.is_hidden()) {
+              continue;
+            }
             auto entry = tui::Layout{};
             entry.append_child(tui::Paragraph("{}:", k));
             if (auto validator_help = validator_arg.help()) {
@@ -120,8 +229,17 @@ namespace jowi::cli {
     }
 
     void print_help() const {
-      std::print("{}", help_dom());
-      std::exit(0);
+      ProfilePhase phase{"print_help"};
+      if (args().size() > 1) {
+        std::print(out(), "{}", help_dom());
+      } else {
+        if (__help_cache.empty() || __help_generation != __generation) {
+          __help_cache = std::format("{}", help_dom());
+          __help_generation = __generation;
+        }
+        std::print(out(), "{}", __help_cache);
+      }
+      exit(0);
     }
 
     void add_help_argument() {
@@ -133,9 +251,15 @@ namespace jowi::cli {
         .help("Show the help message for the application")
         .optional()
         .as_flag();
+      __parser.add_argument("--profile-startup")
+        .help("Prints the time spent in each startup phase to stderr, as JSON with =json")
+        .optional()
+        .as_flag()
+        .hidden();
     }
 
     std::expected<void, ParseError> parse_args(bool auto_help = true, bool auto_exit = true) {
+      __step("parse");
       auto res = __parser.parse(__args);
       auto help_arg_count = __args.count("-h") + __args.count("--help");
       if (help_arg_count != 0 && auto_help) {
@@ -147,6 +271,7 @@ namespace jowi::cli {
       if (!res) {
         return std::unexpected{std::move(res.error())};
       }
+      __step("run");
       return {};
     }
     template <
@@ -156,7 +281,7 @@ namespace jowi::cli {
     static T expect_or(std::expected<T, E> &&res, F &&f) {
       if (!res) {
         std::invoke(f, generic::ErrorFormatter{res.error()});
-        std::exit(1);
+        exit(1);
       } else {
         if constexpr (!std::same_as<T, void>) {
           return std::move(res.value());
@@ -173,13 +298,13 @@ namespace jowi::cli {
     ) {
       return expect_or(std::forward<std::expected<T, E> &&>(res), [&](generic::ErrorFormatter e) {
         std::print(
-          stderr,
+          err(),
           "{}",
           tui::Layout{}
             .style(error_style)
             .append_child(tui::Paragraph(fmt, e, std::forward<Args>(args)...))
         );
-        std::exit(1);
+        exit(1);
       });
     }
     template <class T, class E>
@@ -196,16 +321,132 @@ namespace jowi::cli {
     template <class... Args>
     static void error(int ret_code, std::format_string<Args...> fmt, Args &&...args) {
       std::print(
-        stderr,
+        err(),
         "{}",
         tui::Layout{}
           .style(error_style)
           .append_child(tui::Paragraph(fmt, std::forward<Args>(args)...))
       );
-      std::exit(ret_code);
+      exit(ret_code);
+    }
+
+    /*
+      exit
+      ends the program with code, or only the current command when an AppSession is running.
+    */
+    [[noreturn]] static void exit(int code) {
+      if (__sessions != 0) {
+        std::fflush(out());
+        std::fflush(err());
+        throw AppExit{code};
+      }
+      std::exit(code);
     }
 
     inline static tui::DomStyle error_style = tui::DomStyle{}.fg(tui::RgbColor::bright_yellow());
     inline static tui::DomStyle help_style = tui::DomStyle{}.fg(tui::RgbColor::bright_green());
   };
+
+  /*
+    AppSession
+    runs many commands in one App, e.g. the lines read by ActionBuilder::serve. The parser is
+    checkpointed when the session starts and rolled back around every command, such that the
+    arguments a command declares do not leak into the next one, and the exit paths of App throw
+    AppExit which ends the command only.
+  */
+  export struct AppSession {
+  private:
+    App &__app;
+    ArgParser::Checkpoint __cp;
+
+  public:
+    AppSession(App &app) : __app{app}, __cp{app.__parser.checkpoint()} {
+      App::__sessions += 1;
+    }
+    AppSession(const AppSession &) = delete;
+    AppSession &operator=(const AppSession &) = delete;
+    ~AppSession() {
+      __app.__parser.rollback(__cp);
+      App::__sessions -= 1;
+    }
+
+    /*
+      run
+      runs one command, f being expected to reset_args then parse. The result is the exit code
+      of the command: 0 when f returned, the code of the AppExit ending it otherwise.
+    */
+    template <std::invocable<App &> F> int run(F &&f) {
+      __app.__parser.rollback(__cp);
+      int code = 0;
+      try {
+        std::invoke(std::forward<F>(f), __app);
+      } catch (const AppExit &e) {
+        code = e.code;
+      }
+      std::fflush(App::out());
+      std::fflush(App::err());
+      return code;
+    }
+  };
+
+  /*
+    AppCapture
+    collects what App::out and App::err receive on the calling thread while it is alive, e.g. the
+    output of one command of ActionBuilder::batch, kept apart from the commands running on the
+    other threads. Falls back to the previous streams when no memory stream can be opened.
+  */
+  export struct AppCapture {
+  private:
+    char *__out_buf;
+    size_t __out_size;
+    char *__err_buf;
+    size_t __err_size;
+    FILE *__out;
+    FILE *__err;
+    FILE *__saved_out;
+    FILE *__saved_err;
+
+    static std::string_view __view(FILE *f, const char *buf, size_t size) noexcept {
+      if (f == nullptr) {
+        return {};
+      }
+      std::fflush(f);
+      return std::string_view{buf, size};
+    }
+
+  public:
+    AppCapture() :
+      __out_buf{nullptr}, __out_size{0}, __err_buf{nullptr}, __err_size{0},
+      __out{::open_memstream(&__out_buf, &__out_size)},
+      __err{::open_memstream(&__err_buf, &__err_size)}, __saved_out{App::__out},
+      __saved_err{App::__err} {
+      if (__out != nullptr) {
+        App::__out = __out;
+      }
+      if (__err != nullptr) {
+        App::__err = __err;
+      }
+    }
+    AppCapture(const AppCapture &) = delete;
+    AppCapture &operator=(const AppCapture &) = delete;
+    ~AppCapture() {
+      App::__out = __saved_out;
+      App::__err = __saved_err;
+      for (FILE *f : {__out, __err}) {
+        if (f != nullptr) {
+          std::fclose(f);
+        }
+      }
+      std::free(__out_buf);
+      std::free(__err_buf);
+    }
+
+    // views of what was captured so far, valid until the next print or the end of the capture
+    std::string_view out() noexcept {
+      return __view(__out, __out_buf, __out_size);
+    }
+    std::string_view err() noexcept {
+      return __view(__err, __err_buf, __err_size);
+    }
+  };
 }
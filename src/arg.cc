@@ -1,11 +1,18 @@
 module;
 #include <algorithm>
+#include <array>
 #include <concepts>
+#include <cstddef>
 #include <expected>
 #include <format>
+#include <functional>
+#include <memory>
+#include <new>
 #include <optional>
 #include <string>
 #include <string_view>
+#include <type_traits>
+#include <utility>
 #include <vector>
 export module jowi.cli:arg;
 import jowi.tui;
@@ -14,12 +21,23 @@ import :app_version;
 import :parse_error;
 import :parsed_arg;
 import :arg_key;
+import :profiler;
 namespace tui = jowi::tui;
 
 namespace jowi::cli {
   namespace validator {
     template <class T>
-    concept HasId = requires(const std::decay_t<T> t) {
+    concept HasId = requires() {
+      { std::decay_t<T>::id } -> std::convertible_to<std::string_view>;
+    };
+    /*
+      HasLegacyId
+      the std::optional<std::string> id() const validators used to declare. Such a validator is
+      rejected at compile time rather than treated as having no id, which would silently stop it
+      from replacing an earlier one.
+    */
+    template <class T>
+    concept HasLegacyId = requires(const std::decay_t<T> t) {
       { t.id() } -> std::same_as<std::optional<std::string>>;
     };
     template <class T>
@@ -41,56 +59,259 @@ namespace jowi::cli {
   }
   export template <class T>
   concept IsArgValidator = validator::HasId<T> || validator::HasHelp<T> ||
-    validator::HasValidate<T> || validator::HasPostValidate<T>;
-
-  template <class T>
-    requires(IsArgValidator<T> || std::same_as<T, void>)
-  struct ArgValidator;
-  template <> struct ArgValidator<void> {
-    virtual std::optional<std::string> id() const = 0;
-    virtual std::optional<tui::DomNode> help() const = 0;
-    virtual std::expected<void, ParseError> validate(
-      std::optional<std::string_view> value
-    ) const = 0;
-    virtual std::expected<void, ParseError> post_validate(
-      std::optional<std::reference_wrapper<const ArgKey>> key, ParsedArg &args
-    ) const = 0;
-    virtual ~ArgValidator() = default;
+    validator::HasValidate<T> || validator::HasPostValidate<T> || validator::HasLegacyId<T>;
+
+  /*
+    ValidatorVTable
+    one constant table per validator type. A capability the type does not implement is a null
+    entry, which Arg skips without making a call. id is the name the type declared, empty when it
+    declares none; a validator replaces an earlier one of the same non empty id.
+  */
+  struct ValidatorVTable {
+    std::string_view id;
+    std::optional<tui::DomNode> (*help)(const void *);
+    std::expected<void, ParseError> (*validate)(const void *, std::optional<std::string_view>);
+    std::expected<void, ParseError> (*post_validate)(
+      const void *, std::optional<std::reference_wrapper<const ArgKey>>, ParsedArg &
+    );
+    void (*relocate)(void *to, void *from) noexcept;
+    void (*copy)(void *to, const void *from);
+    void (*destroy)(void *) noexcept;
   };
 
-  template <IsArgValidator Validator>
-  struct ArgValidator<Validator> : private Validator, ArgValidator<void> {
-    using Validator::Validator;
-    ArgValidator(Validator validator) : Validator{std::move(validator)} {}
-    std::optional<std::string> id() const override {
-      if constexpr (validator::HasId<Validator>) {
-        return Validator::id();
+  /*
+    ArgValidator
+    a type erased validator kept in an inline buffer. Validators too large for it, which may
+    throw when moved or which cannot be copied are kept on the heap with the buffer holding a
+    shared pointer: a validator is never modified once added, copies of an Arg may share it.
+  */
+  struct ArgValidator {
+    static constexpr uint64_t inline_size = 32;
+
+  private:
+    template <class V>
+    static constexpr bool __fits = sizeof(V) <= inline_size &&
+      alignof(V) <= alignof(std::max_align_t) && std::is_nothrow_move_constructible_v<V> &&
+      std::is_copy_constructible_v<V>;
+    template <class V> using Shared = std::shared_ptr<const V>;
+
+    template <class V> struct Ops {
+      static const V &get(const void *p) noexcept {
+        if constexpr (__fits<V>) {
+          return *static_cast<const V *>(p);
+        } else {
+          return **static_cast<const Shared<V> *>(p);
+        }
+      }
+      static std::optional<tui::DomNode> help(const void *p) {
+        return get(p).help();
+      }
+      static std::expected<void, ParseError> validate(
+        const void *p, std::optional<std::string_view> value
+      ) {
+        return get(p).validate(value);
+      }
+      static std::expected<void, ParseError> post_validate(
+        const void *p, std::optional<std::reference_wrapper<const ArgKey>> key, ParsedArg &args
+      ) {
+        return get(p).post_validate(key, args);
+      }
+      static void relocate(void *to, void *from) noexcept {
+        if constexpr (__fits<V>) {
+          new (to) V{std::move(*static_cast<V *>(from))};
+          static_cast<V *>(from)->~V();
+        } else {
+          new (to) Shared<V>{std::move(*static_cast<Shared<V> *>(from))};
+          std::destroy_at(static_cast<Shared<V> *>(from));
+        }
+      }
+      static void copy(void *to, const void *from) {
+        if constexpr (__fits<V>) {
+          new (to) V{get(from)};
+        } else {
+          new (to) Shared<V>{*static_cast<const Shared<V> *>(from)};
+        }
+      }
+      static void destroy(void *p) noexcept {
+        if constexpr (__fits<V>) {
+          static_cast<V *>(p)->~V();
+        } else {
+          std::destroy_at(static_cast<Shared<V> *>(p));
+        }
+      }
+
+      static constexpr ValidatorVTable table{
+        []() -> std::string_view {
+          if constexpr (validator::HasId<V>) {
+            return V::id;
+          } else {
+            return {};
+          }
+        }(),
+        []() -> decltype(ValidatorVTable::help) {
+          if constexpr (validator::HasHelp<V>) {
+            return &help;
+          } else {
+            return nullptr;
+          }
+        }(),
+        []() -> decltype(ValidatorVTable::validate) {
+          if constexpr (validator::HasValidate<V>) {
+            return &validate;
+          } else {
+            return nullptr;
+          }
+        }(),
+        []() -> decltype(ValidatorVTable::post_validate) {
+          if constexpr (validator::HasPostValidate<V>) {
+            return &post_validate;
+          } else {
+            return nullptr;
+          }
+        }(),
+        &relocate,
+        &copy,
+        &destroy
+      };
+    };
+
+    alignas(std::max_align_t) std::byte __buf[inline_size];
+    const ValidatorVTable *__vt;
+
+  public:
+    ArgValidator() noexcept : __vt{nullptr} {}
+    template <IsArgValidator V>
+      requires(!std::same_as<std::decay_t<V>, ArgValidator>)
+    ArgValidator(V &&v) : __vt{&Ops<std::decay_t<V>>::table} {
+      static_assert(
+        !validator::HasLegacyId<V>,
+        "a validator id is a static constexpr std::string_view id, not an id() member"
+      );
+      using T = std::decay_t<V>;
+      if constexpr (__fits<T>) {
+        new (__buf) T{std::forward<V>(v)};
       } else {
-        return std::nullopt;
+        new (__buf) Shared<T>{std::make_shared<const T>(std::forward<V>(v))};
       }
     }
-    std::optional<tui::DomNode> help() const override {
-      if constexpr (validator::HasHelp<Validator>) {
-        return Validator::help();
-      } else {
+    ArgValidator(ArgValidator &&o) noexcept : __vt{std::exchange(o.__vt, nullptr)} {
+      if (__vt != nullptr) {
+        __vt->relocate(__buf, o.__buf);
+      }
+    }
+    ArgValidator &operator=(ArgValidator &&o) noexcept {
+      if (this != &o) {
+        reset();
+        __vt = std::exchange(o.__vt, nullptr);
+        if (__vt != nullptr) {
+          __vt->relocate(__buf, o.__buf);
+        }
+      }
+      return *this;
+    }
+    ArgValidator(const ArgValidator &o) : __vt{nullptr} {
+      if (o.__vt != nullptr) {
+        o.__vt->copy(__buf, o.__buf);
+        __vt = o.__vt;
+      }
+    }
+    ArgValidator &operator=(const ArgValidator &o) {
+      if (this != &o) {
+        reset();
+        if (o.__vt != nullptr) {
+          o.__vt->copy(__buf, o.__buf);
+          __vt = o.__vt;
+        }
+      }
+      return *this;
+    }
+    ~ArgValidator() {
+      reset();
+    }
+
+    void reset() noexcept {
+      if (__vt != nullptr) {
+        std::exchange(__vt, nullptr)->destroy(__buf);
+      }
+    }
+    bool replaces(const ArgValidator &o) const noexcept {
+      return !__vt->id.empty() && __vt->id == o.__vt->id;
+    }
+
+    std::optional<tui::DomNode> help() const {
+      if (__vt->help == nullptr) {
         return std::nullopt;
       }
+      return __vt->help(__buf);
     }
-    std::expected<void, ParseError> validate(std::optional<std::string_view> value) const override {
-      if constexpr (validator::HasValidate<Validator>) {
-        return Validator::validate(value);
-      } else {
+    std::expected<void, ParseError> validate(std::optional<std::string_view> value) const {
+      if (__vt->validate == nullptr) {
         return {};
       }
+      return __vt->validate(__buf, value);
     }
     std::expected<void, ParseError> post_validate(
       std::optional<std::reference_wrapper<const ArgKey>> key, ParsedArg &args
-    ) const override {
-      if constexpr (validator::HasPostValidate<Validator>) {
-        return Validator::post_validate(key, args);
-      } else {
+    ) const {
+      if (__vt->post_validate == nullptr) {
         return {};
       }
+      return __vt->post_validate(__buf, key, args);
+    }
+  };
+
+  /*
+    ValidatorList
+    the validators of an Arg, the first few stored inline such that declaring the usual argument
+    does not allocate.
+  */
+  struct ValidatorList {
+    static constexpr uint64_t inline_count = 3;
+
+  private:
+    std::array<ArgValidator, inline_count> __local;
+    std::vector<ArgValidator> __spilled;
+    uint64_t __size;
+
+  public:
+    ValidatorList() noexcept : __local{}, __spilled{}, __size{0} {}
+
+    ArgValidator &operator[](uint64_t i) noexcept {
+      return i < inline_count ? __local[i] : __spilled[i - inline_count];
+    }
+    const ArgValidator &operator[](uint64_t i) const noexcept {
+      return i < inline_count ? __local[i] : __spilled[i - inline_count];
+    }
+    uint64_t size() const noexcept {
+      return __size;
+    }
+    bool empty() const noexcept {
+      return __size == 0;
+    }
+
+    /*
+      add
+      appends v, first removing the validator it replaces.
+    */
+    void add(ArgValidator v) {
+      for (uint64_t i = 0; i != __size; i += 1) {
+        if ((*this)[i].replaces(v)) {
+          for (uint64_t j = i + 1; j != __size; j += 1) {
+            (*this)[j - 1] = std::move((*this)[j]);
+          }
+          __size -= 1;
+          if (__size >= inline_count) {
+            __spilled.pop_back();
+          }
+          break;
+        }
+      }
+      if (__size < inline_count) {
+        __local[__size] = std::move(v);
+      } else {
+        __spilled.emplace_back(std::move(v));
+      }
+      __size += 1;
     }
   };
 
@@ -174,9 +395,7 @@ namespace jowi::cli {
     /*
       Argument validation
     */
-    std::optional<std::string> id() const {
-      return "arg_options";
-    }
+    static constexpr std::string_view id = "arg_options";
     std::optional<tui::DomNode> help() const {
       if (empty()) {
         return std::nullopt;
@@ -235,9 +454,7 @@ namespace jowi::cli {
     }
 
     /* Validator Implementation */
-    std::optional<std::string> id() const {
-      return "ArgCountValidator";
-    }
+    static constexpr std::string_view id = "ArgCountValidator";
     std::optional<tui::DomNode> help() const {
       std::string desc;
       if (min_size == max_size && min_size != 1) {
@@ -280,9 +497,7 @@ namespace jowi::cli {
   public:
     ArgEmptyValidator(bool allow) : __allow{allow} {}
 
-    std::optional<std::string> id() const {
-      return "ArgEmptyValidator";
-    }
+    static constexpr std::string_view id = "ArgEmptyValidator";
     std::optional<tui::DomNode> help() const {
       if (!__allow) {
         return std::nullopt;
@@ -304,29 +519,33 @@ namespace jowi::cli {
     }
   };
 
+  /*
+    ArgDefaultValidator
+    adds the default value when the key is not given. ParsedArg only keeps a view of it, so the
+    text lives on the heap: a short string stored inline would move along with the validator
+    whenever the declarations grow.
+  */
   export struct ArgDefaultValidator {
   private:
-    std::string __v;
+    std::shared_ptr<const std::string> __v;
 
   public:
-    ArgDefaultValidator(std::string v) : __v{std::move(v)} {}
+    ArgDefaultValidator(std::string v) : __v{std::make_shared<const std::string>(std::move(v))} {}
     template <class T>
       requires(std::invocable<decltype(static_cast<std::string (*)(T)>(std::to_string)), T>)
-    ArgDefaultValidator(T v) : __v{std::to_string(v)} {}
+    ArgDefaultValidator(T v) : __v{std::make_shared<const std::string>(std::to_string(v))} {}
 
-    std::optional<std::string> id() const {
-      return "ArgDefaultValidator";
-    }
+    static constexpr std::string_view id = "ArgDefaultValidator";
 
     std::optional<tui::DomNode> help() const {
-      return tui::DomNode::paragraph("Default: {}", __v);
+      return tui::DomNode::paragraph("Default: {}", *__v);
     }
 
     std::expected<void, ParseError> post_validate(
       std::optional<std::reference_wrapper<const ArgKey>> key, ParsedArg &args
     ) const {
       if (key.has_value() && !args.contains(key.value().get())) {
-        args.add_argument(key.value(), __v);
+        args.add_argument(key.value(), *__v);
       }
       return {};
     }
@@ -334,11 +553,13 @@ namespace jowi::cli {
 
   export struct Arg {
   private:
-    std::vector<std::unique_ptr<ArgValidator<void>>> __vtors;
+    ValidatorList __vtors;
     std::optional<std::string> __help_text;
+    bool __hidden;
 
   public:
-    Arg(std::optional<std::string> h = std::nullopt) : __vtors{}, __help_text{std::move(h)} {}
+    Arg(std::optional<std::string> h = std::nullopt) :
+      __vtors{}, __help_text{std::move(h)}, __hidden{false} {}
 
     // Builder Pattern
     Arg &help(std::string help_text) {
@@ -350,21 +571,8 @@ namespace jowi::cli {
       return *this;
     }
     template <IsArgValidator Validator> Arg &add_validator(Validator &&v) {
-      std::unique_ptr<ArgValidator<void>> new_validator =
-        std::make_unique<ArgValidator<Validator>>(std::forward<Validator>(v));
-      auto new_validator_id = new_validator->id();
-      auto it =
-        std::ranges::find_if(__vtors, [&](const std::unique_ptr<ArgValidator<void>> &validator) {
-          auto validator_id = validator->id();
-          if (validator_id.has_value() && new_validator_id.has_value()) {
-            return validator_id.value() == new_validator_id.value();
-          }
-          return false;
-        });
-      if (it != __vtors.end()) {
-        __vtors.erase(it);
-      }
-      __vtors.emplace_back(std::move(new_validator));
+      ProfilePhase phase{"add_validator"};
+      __vtors.add(ArgValidator{std::forward<Validator>(v)});
       return *this;
     }
     template <class... Args>
@@ -403,6 +611,14 @@ namespace jowi::cli {
     Arg &optional() {
       return add_validators(ArgCountValidator::range(0, 1));
     }
+    /*
+      hidden
+      keeps the argument out of the help, e.g. for diagnostics flags.
+    */
+    Arg &hidden() {
+      __hidden = true;
+      return *this;
+    }
 
     // Validator Attributes
     uint64_t size() const noexcept {
@@ -411,6 +627,9 @@ namespace jowi::cli {
     bool empty() const noexcept {
       return __vtors.empty();
     }
+    bool is_hidden() const noexcept {
+      return __hidden;
+    }
     Arg move() noexcept {
       return std::move(*this);
     }
@@ -433,8 +652,8 @@ namespace jowi::cli {
         layout.append_child(tui::DomNode::paragraph(__help_text.value()));
         has_content = true;
       }
-      for (const auto &vtor : __vtors) {
-        if (auto node = vtor->help()) {
+      for (uint64_t i = 0; i != __vtors.size(); i += 1) {
+        if (auto node = __vtors[i].help()) {
           layout.append_child(std::move(node.value()));
           has_content = true;
         }
@@ -446,8 +665,8 @@ namespace jowi::cli {
     }
 
     std::expected<void, ParseError> validate(std::optional<std::string_view> value) const {
-      for (const auto &vtor : __vtors) {
-        auto res = vtor->validate(value);
+      for (uint64_t i = 0; i != __vtors.size(); i += 1) {
+        auto res = __vtors[i].validate(value);
         if (!res) {
           return res;
         }
@@ -457,8 +676,8 @@ namespace jowi::cli {
     std::expected<void, ParseError> post_validate(
       std::optional<std::reference_wrapper<const ArgKey>> key, ParsedArg &args
     ) const {
-      for (const auto &vtor : __vtors) {
-        auto res = vtor->post_validate(key, args);
+      for (uint64_t i = 0; i != __vtors.size(); i += 1) {
+        auto res = __vtors[i].post_validate(key, args);
         if (!res) {
           return res;
         }
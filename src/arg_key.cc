@@ -1,11 +1,14 @@
 module;
-#include <algorithm>
 #include <concepts>
+#include <cstdint>
+#include <deque>
 #include <expected>
 #include <format>
 #include <optional>
 #include <string>
 #include <string_view>
+#include <unordered_map>
+#include <utility>
 export module jowi.cli:arg_key;
 import jowi.generic;
 import :parse_error;
@@ -28,20 +31,33 @@ namespace jowi::cli {
     /*
       Factory Functions
     */
-    static bool is_arg_key(std::string_view v) {
+    static constexpr bool is_arg_key(std::string_view v) {
       return (v.starts_with("--") && v.size() > 2) || (v.starts_with("-") && v.size() == 2);
     }
+    /*
+      split_arg
+      the key and the value after '=' of a token, without copying either. std::nullopt when the
+      token is not a key.
+    */
+    static std::optional<std::pair<std::string_view, std::optional<std::string_view>>> split_arg(
+      std::string_view v
+    ) noexcept {
+      if (!is_arg_key(v)) {
+        return std::nullopt;
+      }
+      auto eq = v.find('=');
+      if (eq == std::string_view::npos) {
+        return std::pair{v, std::nullopt};
+      }
+      return std::pair{v.substr(0, eq), std::optional{v.substr(eq + 1)}};
+    }
     static std::expected<std::pair<ArgKey, std::optional<std::string_view>>, ParseError>
     parse_arg(std::string_view v) {
-      if (!is_arg_key(v)) {
+      auto kv = split_arg(v);
+      if (!kv) {
         return std::unexpected{ParseError{ParseErrorType::NOT_ARGUMENT_KEY, "{}", v}};
       }
-      auto eq_it = std::ranges::find(v, '=');
-      if (eq_it == v.end()) {
-        return std::pair{ArgKey{v}, std::nullopt};
-      } else {
-        return std::pair{ArgKey{v.begin(), eq_it}, std::string_view{eq_it + 1, v.end()}};
-      }
+      return std::pair{ArgKey{kv->first}, kv->second};
     }
     static std::expected<ArgKey, ParseError> make(std::string_view v) {
       if (!is_arg_key(v)) {
@@ -61,6 +77,62 @@ namespace jowi::cli {
       return l.__value == r.__value;
     }
   };
+
+  /*
+    ArgSymbols
+    the parser's symbol table: every declared key is interned once and referred to by a small
+    integer id from then on. Names live in a deque such that the views keying the lookup stay
+    valid as keys are added.
+  */
+  struct ArgSymbols {
+    using Id = uint32_t;
+    std::deque<std::string> names;
+    std::unordered_map<std::string_view, Id> ids;
+
+    ArgSymbols() = default;
+    // the keys of ids view names, a copy points them to its own names
+    ArgSymbols(const ArgSymbols &o) : names{o.names}, ids{} {
+      for (uint64_t id = 0; id != names.size(); id += 1) {
+        ids.emplace(names[id], static_cast<Id>(id));
+      }
+    }
+    ArgSymbols(ArgSymbols &&) = default;
+    ArgSymbols &operator=(const ArgSymbols &) = delete;
+    ArgSymbols &operator=(ArgSymbols &&) = delete;
+
+    Id intern(std::string_view k) {
+      auto it = ids.find(k);
+      if (it != ids.end()) {
+        return it->second;
+      }
+      auto id = static_cast<Id>(names.size());
+      ids.emplace(names.emplace_back(k), id);
+      return id;
+    }
+    std::optional<Id> find(std::string_view k) const noexcept {
+      auto it = ids.find(k);
+      if (it == ids.end()) return std::nullopt;
+      return it->second;
+    }
+    std::string_view name(Id id) const noexcept {
+      return names[id];
+    }
+    uint64_t size() const noexcept {
+      return names.size();
+    }
+  };
+
+  /*
+    key_view
+    the text of anything an ArgKey compares to.
+  */
+  template <class T> std::string_view key_view(const T &key) noexcept {
+    if constexpr (std::same_as<T, ArgKey>) {
+      return key.value();
+    } else {
+      return std::string_view{key};
+    }
+  }
 }
 
 template <class CharType> struct std::formatter<jowi::cli::ArgKey, CharType> {
@@ -1,28 +1,84 @@
 module;
+#include <algorithm>
 #include <expected>
 #include <format>
 #include <functional>
+#include <memory>
 #include <optional>
+#include <span>
+#include <string>
 #include <string_view>
+#include <utility>
 #include <vector>
 export module jowi.cli:arg_parser;
-import jowi.generic;
 import :arg_key;
 import :parsed_arg;
 import :arg;
 import :parse_error;
+import :profiler;
+import :raw_args;
 
 namespace jowi::cli {
   template <class T> using Ref = std::reference_wrapper<T>;
 
+  /*
+    ArgDecl
+    a positional and the keyword arguments declared after it. params keeps the declaration order
+    for the help, slots maps the interned id of a key to its index in params, npos for keys
+    declared after another positional.
+  */
   struct ArgDecl {
+    static constexpr uint64_t npos = static_cast<uint64_t>(-1);
     Arg pos;
-    generic::KeyVector<ArgKey, Arg> params;
+    std::vector<std::pair<ArgKey, Arg>> params;
+    std::vector<uint64_t> slots;
 
-    ArgDecl(Arg pos) : pos{std::move(pos)}, params{} {}
+    ArgDecl(Arg pos) : pos{std::move(pos)}, params{}, slots{} {}
+
+    /*
+      emplace
+      declares k, replacing the previous declaration of the same key. A replaced Arg among the
+      first keep params is moved into replaced along with its index, see ArgParser::Checkpoint.
+    */
+    Arg &emplace(
+      ArgSymbols &symbols,
+      ArgKey k,
+      Arg arg,
+      std::vector<std::pair<uint64_t, Arg>> &replaced,
+      uint64_t keep
+    ) {
+      auto id = symbols.intern(k.value());
+      if (id >= slots.size()) {
+        slots.resize(id + 1, npos);
+      }
+      if (slots[id] != npos) {
+        auto &old = params[slots[id]].second;
+        if (slots[id] < keep) {
+          replaced.emplace_back(slots[id], std::move(old));
+        }
+        return old = std::move(arg);
+      }
+      slots[id] = params.size();
+      return params.emplace_back(std::move(k), std::move(arg)).second;
+    }
+
+    /*
+      truncate
+      drops the params declared after the first n.
+    */
+    void truncate(const ArgSymbols &symbols, uint64_t n) {
+      for (uint64_t i = n; i < params.size(); i += 1) {
+        slots[symbols.find(params[i].first.value()).value()] = npos;
+      }
+      params.erase(params.begin() + std::min(n, params.size()), params.end());
+    }
+
+    const std::pair<ArgKey, Arg> *find(ArgSymbols::Id id) const noexcept {
+      return id < slots.size() && slots[id] != npos ? &params[slots[id]] : nullptr;
+    }
 
     std::expected<Ref<ParsedArg>, ParseError> parse(
-      uint64_t pos_id, ParsedArg &args, bool parse_positional
+      const ArgSymbols &symbols, uint64_t pos_id, ParsedArg &args, bool parse_positional
     ) const {
       auto opt_current_arg = args.raw();
       if (parse_positional && opt_current_arg.has_value()) {
@@ -34,6 +90,7 @@ namespace jowi::cli {
             pos_id
           }};
         }
+        ProfilePhase phase{"validate", "positional"};
         auto res = pos.validate(current_arg);
         if (!res) {
           return std::unexpected{
@@ -44,39 +101,37 @@ namespace jowi::cli {
         auto post_res = pos.post_validate(std::nullopt, args);
         opt_current_arg = args.next_raw();
       }
-      bool is_parser_run = true;
-      while (is_parser_run && opt_current_arg.has_value()) {
-        is_parser_run = false;
-        auto kv_res = ArgKey::parse_arg(opt_current_arg.value());
+      while (opt_current_arg.has_value()) {
+        // resolving a token copies nothing, its key and value stay views into the raw arguments
+        auto kv_res = ArgKey::split_arg(opt_current_arg.value());
         if (!kv_res) break;
-        auto kv = std::move(kv_res.value());
-        for (const auto &[k, arg] : params) {
-          if (kv.first == k) {
-            is_parser_run = true;
-            auto res = arg.validate(kv.second)
-                         .or_else([&](auto &&e) {
-                           if (e.err_type() == ParseErrorType::NO_VALUE_GIVEN) {
-                             kv.second = args.next_raw();
-                             return arg.validate(kv.second);
-                           } else {
-                             return std::expected<void, ParseError>{std::unexpected{std::move(e)}};
-                           }
-                         })
-                         .transform_error([&](auto &&e) {
-                           return ParseError{e.err_type(), "{} - {}", k, e.msg_only()};
-                         });
-            if (!res) {
-              return std::unexpected{std::move(res.error())};
-            }
-            args.add_argument(kv.first, kv.second.value_or(""));
-            opt_current_arg = args.next_raw();
-          }
-        }
-        if (!is_parser_run) {
-          break;
+        auto kv = kv_res.value();
+        auto id = symbols.find(kv.first);
+        if (!id) break;
+        auto param = find(*id);
+        if (param == nullptr) break;
+        const auto &[k, arg] = *param;
+        ProfilePhase phase{"validate", k.value()};
+        auto res = arg.validate(kv.second)
+                     .or_else([&](auto &&e) {
+                       if (e.err_type() == ParseErrorType::NO_VALUE_GIVEN) {
+                         kv.second = args.next_raw();
+                         return arg.validate(kv.second);
+                       } else {
+                         return std::expected<void, ParseError>{std::unexpected{std::move(e)}};
+                       }
+                     })
+                     .transform_error([&](auto &&e) {
+                       return ParseError{e.err_type(), "{} - {}", k, e.msg_only()};
+                     });
+        if (!res) {
+          return std::unexpected{std::move(res.error())};
         }
+        args.add_argument(*id, kv.second.value_or(""));
+        opt_current_arg = args.next_raw();
       }
       for (const auto &[k, arg] : params) {
+        ProfilePhase phase{"post_validate", k.value()};
         auto res = arg.post_validate(std::cref(k), args);
         if (!res) {
           return std::unexpected{
@@ -104,18 +159,46 @@ namespace jowi::cli {
   };
 
   export struct ArgParser {
+    /*
+      Checkpoint
+      the declarations made so far. rollback drops every positional and key declared after the
+      checkpoint and gives a key redeclared since the Arg it had at the checkpoint.
+    */
+    struct Checkpoint {
+      uint64_t decls;
+      uint64_t params;
+    };
+
   private:
     std::vector<ArgDecl> __args;
+    // shared with the ParsedArg of every parse, whose params only hold the key ids
+    std::shared_ptr<ArgSymbols> __symbols;
+    // the last checkpoint and the Args of its keys replaced since, oldest first
+    Checkpoint __mark;
+    std::vector<std::pair<uint64_t, Arg>> __replaced;
+
+    uint64_t __kept_params() const noexcept {
+      return __args.size() == __mark.decls ? __mark.params : 0;
+    }
 
   public:
-    ArgParser() : __args{} {
+    ArgParser() : __args{}, __symbols{std::make_shared<ArgSymbols>()}, __mark{0, 0}, __replaced{} {
       add_argument().help("main executable");
     }
+    // a copy interns the keys it declares from then on into its own symbols
+    ArgParser(const ArgParser &o) :
+      __args{o.__args}, __symbols{std::make_shared<ArgSymbols>(*o.__symbols)}, __mark{o.__mark},
+      __replaced{o.__replaced} {}
+    ArgParser(ArgParser &&) = default;
+    ArgParser &operator=(const ArgParser &) = delete;
+    ArgParser &operator=(ArgParser &&) = default;
     Arg &add_argument(ArgKey k, Arg arg = Arg::flag()) {
-      return __args.back().params.emplace(k, std::move(arg));
+      return __args.back().emplace(
+        *__symbols, std::move(k), std::move(arg), __replaced, __kept_params()
+      );
     }
     Arg &add_argument(std::string_view k, Arg arg = Arg::flag()) {
-      return __args.back().params.emplace(ArgKey::make(k).value(), std::move(arg));
+      return add_argument(ArgKey::make(k).value(), std::move(arg));
     }
     Arg &add_argument() {
       __args.emplace_back(Arg::positional());
@@ -141,22 +224,47 @@ namespace jowi::cli {
       return __args.back().params.size();
     }
 
+    /*
+      checkpoint
+      marks the declarations made so far. From then on a checkpointed key being redeclared has
+      its Arg set aside, such that rollback, to this checkpoint only, can restore it.
+    */
+    Checkpoint checkpoint() noexcept {
+      __mark = Checkpoint{__args.size(), __args.back().params.size()};
+      __replaced.clear();
+      return __mark;
+    }
+    void rollback(Checkpoint cp) {
+      __args.erase(__args.begin() + cp.decls, __args.end());
+      auto &decl = __args.back();
+      for (auto it = __replaced.rbegin(); it != __replaced.rend(); ++it) {
+        decl.params[it->first].second = std::move(it->second);
+      }
+      __replaced.clear();
+      decl.truncate(*__symbols, cp.params);
+    }
+
     /*
       Argument Parsing
     */
     std::expected<Ref<ParsedArg>, ParseError> parse(ParsedArg &args) const {
+      args.bind(__symbols);
       for (auto arg_id = std::max(0, static_cast<int>(args.size()) - 1); arg_id != size();
            arg_id += 1) {
-        auto res = __args[arg_id].parse(arg_id, args, args.size() <= arg_id);
+        auto res = __args[arg_id].parse(*__symbols, arg_id, args, args.size() <= arg_id);
         if (!res) {
           return std::unexpected{std::move(res.error())};
         }
       }
+      args.index();
       return std::ref(args);
     }
     std::expected<ParsedArg, ParseError> parse(RawArgs raw) const {
       ParsedArg args{raw};
       return parse(args).transform([](auto &&args) { return std::move(args); });
     }
+    std::expected<ParsedArg, ParseError> parse(std::span<const std::string_view> tokens) const {
+      return parse(RawArgs{tokens});
+    }
   };
 }
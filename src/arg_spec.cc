@@ -0,0 +1,378 @@
+module;
+#include <algorithm>
+#include <array>
+#include <concepts>
+#include <cstdint>
+#include <expected>
+#include <optional>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+export module jowi.cli:arg_spec;
+import :arg_key;
+import :arg_shortcut;
+import :parse_error;
+import :raw_args;
+
+namespace jowi::cli {
+  /*
+    ArgName
+    a string usable as a template argument, the keys and options of an ArgSpec.
+  */
+  export template <uint64_t N> struct ArgName {
+    char data[N];
+
+    constexpr ArgName(const char (&s)[N]) {
+      std::copy_n(s, N, data);
+    }
+    constexpr std::string_view view() const noexcept {
+      return std::string_view{data, N - 1};
+    }
+  };
+
+  /*
+    ArgValues
+    the values of a repeated key, stored inline up to N of them. An ArgSpec never gives a key
+    more values than the capacity of the member it fills.
+  */
+  export template <class T, uint64_t N> struct ArgValues {
+  private:
+    std::array<T, N> __values;
+    uint64_t __size;
+
+  public:
+    using value_type = T;
+    static constexpr uint64_t capacity = N;
+
+    constexpr ArgValues() : __values{}, __size{0} {}
+
+    constexpr T &emplace_back(T v) {
+      return __values[__size++] = std::move(v);
+    }
+    constexpr uint64_t size() const noexcept {
+      return __size;
+    }
+    constexpr bool empty() const noexcept {
+      return __size == 0;
+    }
+    constexpr const T &operator[](uint64_t i) const noexcept {
+      return __values[i];
+    }
+    constexpr auto begin() const noexcept {
+      return __values.begin();
+    }
+    constexpr auto end() const noexcept {
+      return __values.begin() + __size;
+    }
+  };
+
+  /*
+    ParamRules
+    how often a key may be given. Unless set, max_count is 1 for a scalar member and the capacity
+    of a list member.
+  */
+  export struct ParamRules {
+    static constexpr uint64_t deduced = static_cast<uint64_t>(-1);
+    uint64_t min_count = 0;
+    uint64_t max_count = deduced;
+
+    static constexpr ParamRules required() {
+      return ParamRules{1, 1};
+    }
+    static constexpr ParamRules at_least(uint64_t min_count) {
+      return ParamRules{min_count, deduced};
+    }
+    static constexpr ParamRules range(uint64_t min_count, uint64_t max_count) {
+      return ParamRules{min_count, max_count};
+    }
+  };
+
+  template <class M> struct SpecMember {
+    using value_type = M;
+    static constexpr bool repeated = false;
+    static constexpr bool optional = false;
+    static constexpr uint64_t capacity = 1;
+  };
+  template <class T> struct SpecMember<std::optional<T>> : SpecMember<T> {
+    static constexpr bool optional = true;
+  };
+  template <class T, uint64_t N> struct SpecMember<ArgValues<T, N>> {
+    using value_type = T;
+    static constexpr bool repeated = true;
+    static constexpr bool optional = true;
+    static constexpr uint64_t capacity = N;
+  };
+  template <class T, class Alloc> struct SpecMember<std::vector<T, Alloc>> {
+    using value_type = T;
+    static constexpr bool repeated = true;
+    static constexpr bool optional = true;
+    static constexpr uint64_t capacity = static_cast<uint64_t>(-1);
+  };
+
+  template <class M> struct MemberOf;
+  template <class C, class M> struct MemberOf<M C::*> {
+    using owner = C;
+    using type = M;
+  };
+
+  // std::string_view members keep pointing into argv, everything else goes through parse_arg
+  template <class T> std::expected<T, ParseError> spec_value(std::string_view v) {
+    if constexpr (std::same_as<T, std::string_view>) {
+      return v;
+    } else {
+      return parse_arg<T>(v);
+    }
+  }
+
+  template <auto Member, ArgName... Options> struct SpecField {
+    using member = MemberOf<decltype(Member)>;
+    using owner = typename member::owner;
+    using traits = SpecMember<typename member::type>;
+    using value_type = typename traits::value_type;
+    static constexpr bool is_flag = std::same_as<value_type, bool>;
+
+    static std::expected<void, ParseError> assign(owner &out, std::optional<std::string_view> v) {
+      if constexpr (is_flag) {
+        if (v) {
+          return std::unexpected{ParseError{ParseErrorType::INVALID_VALUE, "flag given {}", *v}};
+        }
+        return store(out, true);
+      } else {
+        if (!v) {
+          return std::unexpected{ParseError{ParseErrorType::NO_VALUE_GIVEN, ""}};
+        }
+        if constexpr (sizeof...(Options) != 0) {
+          if (!((*v == Options.view()) || ...)) {
+            return std::unexpected{
+              ParseError{ParseErrorType::INVALID_VALUE, "{} is not a valid option.", *v}
+            };
+          }
+        }
+        auto value = spec_value<value_type>(*v);
+        if (!value) {
+          return std::unexpected{std::move(value.error())};
+        }
+        return store(out, std::move(value.value()));
+      }
+    }
+
+    static std::expected<void, ParseError> store(owner &out, value_type v) {
+      if constexpr (traits::repeated) {
+        (out.*Member).emplace_back(std::move(v));
+      } else {
+        out.*Member = std::move(v);
+      }
+      return {};
+    }
+  };
+
+  /*
+    Param
+    declares the keyword argument Key filling Member, a pointer to a data member of the result
+    struct. The type of the member decides the parsing: bool is a flag, std::string_view keeps a
+    view of argv, std::optional marks an argument that may be missing, ArgValues or std::vector
+    collect every value given, anything else is converted with parse_arg. The default is the
+    member's initializer. Options restricts the accepted values.
+  */
+  export template <ArgName Key, auto Member, ParamRules Rules = ParamRules{}, ArgName... Options>
+  struct Param : SpecField<Member, Options...> {
+    using field = SpecField<Member, Options...>;
+    static_assert(ArgKey::is_arg_key(Key.view()), "keys are -k or --key");
+
+    static constexpr bool positional = false;
+    static constexpr std::string_view key = Key.view();
+    static constexpr uint64_t min_count = Rules.min_count;
+    static constexpr uint64_t max_count =
+      Rules.max_count == ParamRules::deduced ? field::traits::capacity : Rules.max_count;
+    static_assert(max_count <= field::traits::capacity, "more values than the member holds");
+    static_assert(min_count <= max_count);
+  };
+
+  /*
+    Positional
+    declares the next positional argument, filling Member. It is required unless Member is a
+    std::optional.
+  */
+  export template <auto Member, ArgName... Options>
+  struct Positional : SpecField<Member, Options...> {
+    using field = SpecField<Member, Options...>;
+    static_assert(!field::is_flag && !field::traits::repeated, "a positional takes one value");
+
+    static constexpr bool positional = true;
+    static constexpr std::string_view key = {};
+    static constexpr uint64_t min_count = field::traits::optional ? 0 : 1;
+    static constexpr uint64_t max_count = 1;
+  };
+
+  template <class P, class T>
+  concept IsSpecParam = requires(T &out, std::optional<std::string_view> v) {
+    { P::positional } -> std::convertible_to<bool>;
+    { P::key } -> std::convertible_to<std::string_view>;
+    { P::assign(out, v) } -> std::same_as<std::expected<void, ParseError>>;
+  };
+
+  /*
+    ArgSpec
+    a parser generated at compile time from a list of Param and Positional. parse fills a T with
+    typed values: a key is resolved through a table sorted at compile time and handled by the
+    function its Param generated, no validator object is built, no virtual call is made and,
+    unless T holds owning members such as std::string, nothing is allocated. The runtime ArgParser
+    remains for arguments only known at runtime.
+  */
+  export template <std::default_initializable T, class... Params>
+    requires(IsSpecParam<Params, T> && ...)
+  struct ArgSpec {
+  private:
+    static constexpr uint64_t __size = sizeof...(Params);
+    using Assign = std::expected<void, ParseError> (*)(T &, std::optional<std::string_view>);
+    struct KeyEntry {
+      std::string_view key;
+      uint64_t id;
+    };
+
+    static constexpr std::array<Assign, __size> __assign{&Params::assign...};
+    static constexpr std::array<bool, __size> __flags{Params::is_flag...};
+    static constexpr std::array<uint64_t, __size> __min{Params::min_count...};
+    static constexpr std::array<uint64_t, __size> __max{Params::max_count...};
+    static constexpr uint64_t __key_count = (uint64_t{!Params::positional} + ... + 0);
+
+    static constexpr auto __keys = []() {
+      std::array<bool, __size> positional{Params::positional...};
+      std::array<std::string_view, __size> keys{Params::key...};
+      std::array<KeyEntry, __key_count> table{};
+      uint64_t i = 0;
+      for (uint64_t id = 0; id != __size; id += 1) {
+        if (!positional[id]) {
+          table[i++] = KeyEntry{keys[id], id};
+        }
+      }
+      std::ranges::sort(table, {}, &KeyEntry::key);
+      return table;
+    }();
+    static_assert(
+      std::ranges::adjacent_find(__keys, {}, &KeyEntry::key) == __keys.end(),
+      "a key is declared twice"
+    );
+
+    static constexpr auto __positionals = []() {
+      std::array<bool, __size> positional{Params::positional...};
+      std::array<uint64_t, __size - __key_count> ids{};
+      uint64_t i = 0;
+      for (uint64_t id = 0; id != __size; id += 1) {
+        if (positional[id]) {
+          ids[i++] = id;
+        }
+      }
+      return ids;
+    }();
+
+    static std::optional<uint64_t> __find(std::string_view k) noexcept {
+      auto it = std::ranges::lower_bound(__keys, k, {}, &KeyEntry::key);
+      if (it == __keys.end() || it->key != k) {
+        return std::nullopt;
+      }
+      return it->id;
+    }
+
+    static std::string_view __name(uint64_t id) noexcept {
+      static constexpr std::array<std::string_view, __size> names{Params::key...};
+      return names[id];
+    }
+
+  public:
+    /*
+      parse_into
+      parses every argument after the executable into out, which keeps the values it was
+      initialized with for the arguments not given.
+    */
+    static std::expected<void, ParseError> parse_into(T &out, RawArgs args) {
+      std::array<uint64_t, __size> counts{};
+      uint64_t positionals = 0;
+      auto it = args.begin();
+      auto end = args.end();
+      if (it != end) {
+        ++it;
+      }
+      for (; it != end; ++it) {
+        std::string_view token = *it;
+        auto kv = ArgKey::split_arg(token);
+        if (!kv) {
+          if (positionals == __positionals.size()) {
+            return std::unexpected{
+              ParseError{ParseErrorType::NOT_POSITIONAL, "{} - unexpected positional", token}
+            };
+          }
+          auto id = __positionals[positionals];
+          positionals += 1;
+          auto res = __assign[id](out, token);
+          if (!res) {
+            return std::unexpected{ParseError{
+              res.error().err_type(), "arg{} - {}", positionals, res.error().msg_only()
+            }};
+          }
+          counts[id] += 1;
+          continue;
+        }
+        auto [k, value] = kv.value();
+        auto id = __find(k);
+        if (!id) {
+          return std::unexpected{
+            ParseError{ParseErrorType::NOT_REQUIRED_ARGUMENT, "{} - unknown argument", k}
+          };
+        }
+        if (counts[*id] == __max[*id]) {
+          return std::unexpected{ParseError{
+            ParseErrorType::TOO_MANY_VALUE_GIVEN,
+            "{} - {} not in {} <= x <= {}",
+            k,
+            counts[*id] + 1,
+            __min[*id],
+            __max[*id]
+          }};
+        }
+        if (!value && !__flags[*id]) {
+          auto next = it;
+          ++next;
+          if (next != end) {
+            value = *next;
+            it = next;
+          }
+        }
+        auto res = __assign[*id](out, value);
+        if (!res) {
+          return std::unexpected{
+            ParseError{res.error().err_type(), "{} - {}", k, res.error().msg_only()}
+          };
+        }
+        counts[*id] += 1;
+      }
+      for (uint64_t id = 0; id != __size; id += 1) {
+        if (counts[id] < __min[id]) {
+          auto name = __name(id);
+          return std::unexpected{ParseError{
+            ParseErrorType::TOO_MANY_VALUE_GIVEN,
+            "{} - {} not in {} <= x <= {}",
+            name.empty() ? "positional" : name,
+            counts[id],
+            __min[id],
+            __max[id]
+          }};
+        }
+      }
+      return {};
+    }
+
+    static std::expected<T, ParseError> parse(RawArgs args) {
+      T out{};
+      auto res = parse_into(out, args);
+      if (!res) {
+        return std::unexpected{std::move(res.error())};
+      }
+      return out;
+    }
+    static std::expected<T, ParseError> parse(int argc, const char **argv) {
+      return parse(RawArgs{argc, argv});
+    }
+  };
+}
@@ -0,0 +1,259 @@
+module;
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <cerrno>
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <expected>
+#include <fcntl.h>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <unistd.h>
+#include <utility>
+export module jowi.cli:command_source;
+import :parse_error;
+
+namespace jowi::cli {
+  namespace fs = std::filesystem;
+
+  /*
+    CommandSource
+    where ActionBuilder::serve reads its command lines from: stdin, a file, or a Unix domain
+    socket accepting one client after the other. The output of a command read from a socket goes
+    back to its client, followed by a NUL byte, the exit code in decimal and a newline.
+  */
+  export struct CommandSource {
+  private:
+    int __fd;
+    int __listen_fd;
+    bool __owns;
+    fs::path __socket;
+    std::string __buf;
+    uint64_t __pos;
+    bool __eof;
+    int __saved_out;
+    int __saved_err;
+    struct sigaction __saved_pipe;
+    // between begin_command and end_command of a command read from a socket
+    bool __in_command;
+
+    CommandSource(int fd, int listen_fd, bool owns, fs::path socket) :
+      __fd{fd}, __listen_fd{listen_fd}, __owns{owns}, __socket{std::move(socket)}, __buf{},
+      __pos{0}, __eof{false}, __saved_out{-1}, __saved_err{-1}, __saved_pipe{},
+      __in_command{false} {}
+
+    void __close_client() noexcept {
+      if (__fd != -1 && __owns) {
+        ::close(__fd);
+      }
+      __fd = -1;
+      __buf.clear();
+      __pos = 0;
+    }
+    bool __accept() {
+      while (true) {
+        int fd = ::accept4(__listen_fd, nullptr, nullptr, SOCK_CLOEXEC);
+        if (fd != -1) {
+          __fd = fd;
+          return true;
+        }
+        if (errno != EINTR && errno != ECONNABORTED) {
+          return false;
+        }
+      }
+    }
+    static void __write_all(int fd, std::string_view d) noexcept {
+      while (!d.empty()) {
+        auto n = ::write(fd, d.data(), d.size());
+        if (n < 0 && errno == EINTR) {
+          continue;
+        }
+        if (n <= 0) {
+          return;
+        }
+        d.remove_prefix(static_cast<uint64_t>(n));
+      }
+    }
+
+  public:
+    CommandSource(CommandSource &&o) noexcept :
+      __fd{std::exchange(o.__fd, -1)}, __listen_fd{std::exchange(o.__listen_fd, -1)},
+      __owns{o.__owns}, __socket{std::move(o.__socket)}, __buf{std::move(o.__buf)},
+      __pos{o.__pos}, __eof{o.__eof}, __saved_out{std::exchange(o.__saved_out, -1)},
+      __saved_err{std::exchange(o.__saved_err, -1)}, __saved_pipe{o.__saved_pipe},
+      __in_command{std::exchange(o.__in_command, false)} {
+      o.__socket.clear();
+    }
+    CommandSource &operator=(CommandSource &&) = delete;
+    CommandSource(const CommandSource &) = delete;
+    CommandSource &operator=(const CommandSource &) = delete;
+    ~CommandSource() {
+      __close_client();
+      if (__listen_fd != -1) {
+        ::close(__listen_fd);
+        std::error_code ec;
+        fs::remove(__socket, ec);
+      }
+    }
+
+    static CommandSource from_stdin() {
+      return CommandSource{STDIN_FILENO, -1, false, {}};
+    }
+    static std::expected<CommandSource, ParseError> open(const fs::path &p) {
+      int fd = ::open(p.c_str(), O_RDONLY | O_CLOEXEC);
+      if (fd == -1) {
+        return std::unexpected{
+          ParseError::invalid_value("cannot open {}: {}", p.c_str(), std::strerror(errno))
+        };
+      }
+      return CommandSource{fd, -1, true, {}};
+    }
+
+    /*
+      listen
+      binds a Unix domain socket at p, replacing a stale socket file left there. A socket another
+      server still accepts connections on is an error. The file is removed when the source is
+      destroyed.
+    */
+    static std::expected<CommandSource, ParseError> listen(const fs::path &p) {
+      sockaddr_un addr{};
+      addr.sun_family = AF_UNIX;
+      if (p.native().size() >= sizeof(addr.sun_path)) {
+        return std::unexpected{ParseError::invalid_value("socket path too long {}", p.c_str())};
+      }
+      std::memcpy(addr.sun_path, p.c_str(), p.native().size());
+      int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+      if (fd == -1) {
+        return std::unexpected{
+          ParseError::invalid_value("cannot create socket: {}", std::strerror(errno))
+        };
+      }
+      std::error_code ec;
+      if (fs::is_socket(p, ec)) {
+        // a socket file nobody answers on was left by a server which is gone
+        int probe = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        bool live =
+          probe != -1 && ::connect(probe, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) == 0;
+        if (probe != -1) {
+          ::close(probe);
+        }
+        if (live) {
+          ::close(fd);
+          return std::unexpected{
+            ParseError::invalid_value("a server already listens on {}", p.c_str())
+          };
+        }
+        fs::remove(p, ec);
+      }
+      if (::bind(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0 ||
+          ::listen(fd, 16) != 0) {
+        int err = errno;
+        ::close(fd);
+        return std::unexpected{
+          ParseError::invalid_value("cannot listen on {}: {}", p.c_str(), std::strerror(err))
+        };
+      }
+      return CommandSource{-1, fd, true, p};
+    }
+
+    /*
+      next_line
+      reads the next line, without its newline, into line. Returns false once the input ended;
+      a socket source instead waits for the next client when one disconnects.
+    */
+    bool next_line(std::string &line) {
+      char chunk[4096];
+      while (true) {
+        if (__eof) {
+          __eof = false;
+          __close_client();
+          if (__listen_fd == -1) {
+            return false;
+          }
+        }
+        if (__fd == -1 && (__listen_fd == -1 || !__accept())) {
+          return false;
+        }
+        auto nl = __buf.find('\n', __pos);
+        if (nl != std::string::npos) {
+          line.assign(__buf, __pos, nl - __pos);
+          __pos = nl + 1;
+          return true;
+        }
+        if (__pos != 0) {
+          __buf.erase(0, __pos);
+          __pos = 0;
+        }
+        auto n = ::read(__fd, chunk, sizeof(chunk));
+        if (n < 0 && errno == EINTR) {
+          continue;
+        }
+        if (n > 0) {
+          __buf.append(chunk, static_cast<uint64_t>(n));
+          continue;
+        }
+        // the client stays connected until its last line, which may lack a newline, ran
+        __eof = true;
+        if (!__buf.empty()) {
+          line.assign(__buf);
+          __buf.clear();
+          return true;
+        }
+      }
+    }
+
+    /*
+      begin_command / end_command
+      point stdout and stderr to the client for the duration of a command read from a socket,
+      then send the exit code. SIGPIPE is ignored meanwhile, a client leaving early must not end
+      the server. Both do nothing for the other sources. When the descriptors cannot be
+      duplicated the command writes to the server's own stdout and stderr, the client still gets
+      its exit code.
+    */
+    void begin_command() {
+      if (__listen_fd == -1 || __fd == -1) {
+        return;
+      }
+      struct sigaction ignore{};
+      ignore.sa_handler = SIG_IGN;
+      ::sigaction(SIGPIPE, &ignore, &__saved_pipe);
+      __in_command = true;
+      std::fflush(stdout);
+      std::fflush(stderr);
+      int out = ::dup(STDOUT_FILENO);
+      int err = ::dup(STDERR_FILENO);
+      if (out != -1 && err != -1 && ::dup2(__fd, STDOUT_FILENO) != -1) {
+        if (::dup2(__fd, STDERR_FILENO) != -1) {
+          __saved_out = out;
+          __saved_err = err;
+          return;
+        }
+        ::dup2(out, STDOUT_FILENO);
+      }
+      if (out != -1) ::close(out);
+      if (err != -1) ::close(err);
+    }
+    void end_command(int code) {
+      if (!std::exchange(__in_command, false)) {
+        return;
+      }
+      std::fflush(stdout);
+      std::fflush(stderr);
+      if (__saved_out != -1) {
+        ::dup2(__saved_out, STDOUT_FILENO);
+        ::dup2(__saved_err, STDERR_FILENO);
+        ::close(std::exchange(__saved_out, -1));
+        ::close(std::exchange(__saved_err, -1));
+      }
+      if (__fd != -1) {
+        char trailer[16];
+        auto n = std::snprintf(trailer, sizeof(trailer), "%c%d\n", '\0', code);
+        __write_all(__fd, std::string_view{trailer, static_cast<uint64_t>(n)});
+      }
+      ::sigaction(SIGPIPE, &__saved_pipe, nullptr);
+    }
+  };
+}
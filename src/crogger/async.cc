@@ -0,0 +1,278 @@
+module;
+#include <atomic>
+#include <condition_variable>
+#include <coroutine>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <expected>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <utility>
+export module jowi.crogger:async;
+import :error;
+
+namespace jowi::crogger {
+  /*
+    EmitterCallback
+    how an emitter reports the completion of an operation running in the background, e.g. a flush
+    waiting for the disk. It is called once, on any thread.
+  */
+  export using EmitterCallback = std::move_only_function<void(std::expected<void, LogError>)>;
+
+  export template <class T = void> struct Task;
+
+  template <class T> struct TaskResult {
+    std::optional<T> value;
+
+    void return_value(T v) {
+      value.emplace(std::move(v));
+    }
+    T take() {
+      return std::move(value.value());
+    }
+  };
+  template <> struct TaskResult<void> {
+    void return_void() noexcept {}
+    void take() noexcept {}
+  };
+
+  /*
+    Task
+    a lazily started coroutine, run by co_await-ing it from another Task or by handing it to
+    Executor::spawn. Exceptions escaping the coroutine are rethrown to the awaiter.
+  */
+  export template <class T> struct Task {
+    struct promise_type : public TaskResult<T> {
+      std::coroutine_handle<> continuation;
+      std::exception_ptr error;
+
+      Task get_return_object() noexcept {
+        return Task{std::coroutine_handle<promise_type>::from_promise(*this)};
+      }
+      std::suspend_always initial_suspend() noexcept {
+        return {};
+      }
+      auto final_suspend() noexcept {
+        struct Continue {
+          bool await_ready() const noexcept {
+            return false;
+          }
+          std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> h) noexcept {
+            auto c = h.promise().continuation;
+            return c ? c : std::noop_coroutine();
+          }
+          void await_resume() const noexcept {}
+        };
+        return Continue{};
+      }
+      void unhandled_exception() noexcept {
+        error = std::current_exception();
+      }
+    };
+
+  private:
+    std::coroutine_handle<promise_type> __h;
+
+    explicit Task(std::coroutine_handle<promise_type> h) noexcept : __h{h} {}
+
+  public:
+    Task(Task &&o) noexcept : __h{std::exchange(o.__h, nullptr)} {}
+    Task &operator=(Task &&o) noexcept {
+      std::swap(__h, o.__h);
+      return *this;
+    }
+    Task(const Task &) = delete;
+    Task &operator=(const Task &) = delete;
+    ~Task() {
+      if (__h) {
+        __h.destroy();
+      }
+    }
+
+    bool await_ready() const noexcept {
+      return false;
+    }
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiter) noexcept {
+      __h.promise().continuation = awaiter;
+      return __h;
+    }
+    T await_resume() {
+      if (__h.promise().error) {
+        std::rethrow_exception(__h.promise().error);
+      }
+      return __h.promise().take();
+    }
+  };
+
+  /*
+    Executor
+    a single threaded executor: run() resumes the spawned tasks on the calling thread until all of
+    them completed. Other threads hand work back to it with post(), which is how background I/O
+    (see EmitterAwaitable) resumes a task without ever blocking the loop.
+  */
+  export struct Executor {
+  private:
+    struct Detached {
+      struct promise_type {
+        Detached get_return_object() noexcept {
+          return Detached{std::coroutine_handle<promise_type>::from_promise(*this)};
+        }
+        std::suspend_always initial_suspend() noexcept {
+          return {};
+        }
+        std::suspend_never final_suspend() noexcept {
+          return {};
+        }
+        void return_void() noexcept {}
+        void unhandled_exception() noexcept {
+          std::terminate();
+        }
+      };
+      std::coroutine_handle<promise_type> h;
+    };
+
+    std::mutex __mut;
+    std::condition_variable __cv;
+    std::deque<std::coroutine_handle<>> __ready;
+    uint64_t __live;
+    std::exception_ptr __error;
+
+    static inline thread_local Executor *__current = nullptr;
+
+    static Detached __drive(Executor &ex, Task<void> task) {
+      std::exception_ptr err;
+      try {
+        co_await task;
+      } catch (...) {
+        err = std::current_exception();
+      }
+      std::unique_lock lck{ex.__mut};
+      ex.__live -= 1;
+      if (err && !ex.__error) {
+        ex.__error = err;
+      }
+    }
+
+  public:
+    Executor() : __live{0} {}
+    Executor(const Executor &) = delete;
+    Executor &operator=(const Executor &) = delete;
+
+    /*
+      post
+      queues h to be resumed by run(), callable from any thread.
+    */
+    void post(std::coroutine_handle<> h) {
+      // notified under the lock, run() may return and the executor be gone right after
+      std::unique_lock lck{__mut};
+      __ready.emplace_back(h);
+      __cv.notify_one();
+    }
+
+    void spawn(Task<void> task) {
+      auto d = __drive(*this, std::move(task));
+      {
+        std::unique_lock lck{__mut};
+        __live += 1;
+      }
+      post(d.h);
+    }
+
+    /*
+      run
+      resumes tasks until every spawned task completed, then rethrows the first exception one of
+      them ended with.
+    */
+    void run() {
+      auto *prev = std::exchange(__current, this);
+      std::unique_lock lck{__mut};
+      while (__live != 0) {
+        __cv.wait(lck, [&]() { return !__ready.empty(); });
+        auto h = __ready.front();
+        __ready.pop_front();
+        lck.unlock();
+        h.resume();
+        lck.lock();
+      }
+      __current = prev;
+      if (__error) {
+        std::rethrow_exception(std::exchange(__error, nullptr));
+      }
+    }
+
+    /*
+      yield
+      lets the other ready tasks run before continuing.
+    */
+    auto yield() {
+      struct Yield {
+        Executor &ex;
+        bool await_ready() const noexcept {
+          return false;
+        }
+        void await_suspend(std::coroutine_handle<> h) {
+          ex.post(h);
+        }
+        void await_resume() const noexcept {}
+      };
+      return Yield{*this};
+    }
+
+    /*
+      current
+      the executor running on this thread, nullptr outside of run().
+    */
+    static Executor *current() noexcept {
+      return __current;
+    }
+  };
+
+  /*
+    EmitterAwaitable
+    turns an operation completing through an EmitterCallback into something to co_await. The
+    awaiting task is resumed on the executor it was running on, or right on the completing
+    thread when it was not running on one.
+  */
+  export struct EmitterAwaitable {
+  private:
+    std::move_only_function<void(EmitterCallback)> __start;
+    std::expected<void, LogError> __result;
+    std::coroutine_handle<> __h;
+    Executor *__ex;
+    // set by whichever of await_suspend and the callback finishes first
+    std::atomic<bool> __done;
+
+    void __resume() {
+      if (__ex != nullptr) {
+        __ex->post(__h);
+      } else {
+        __h.resume();
+      }
+    }
+
+  public:
+    explicit EmitterAwaitable(std::move_only_function<void(EmitterCallback)> start) :
+      __start{std::move(start)}, __result{}, __h{}, __ex{nullptr}, __done{false} {}
+
+    bool await_ready() const noexcept {
+      return false;
+    }
+    bool await_suspend(std::coroutine_handle<> h) {
+      __h = h;
+      __ex = Executor::current();
+      __start([this](std::expected<void, LogError> res) {
+        __result = std::move(res);
+        if (__done.exchange(true, std::memory_order_acq_rel)) {
+          __resume();
+        }
+      });
+      // false when the operation already completed, the task then simply continues
+      return !__done.exchange(true, std::memory_order_acq_rel);
+    }
+    std::expected<void, LogError> await_resume() {
+      return std::move(__result);
+    }
+  };
+}
@@ -0,0 +1,239 @@
+module;
+#include <algorithm>
+#include <cerrno>
+#include <condition_variable>
+#include <cstdint>
+#include <expected>
+#include <fcntl.h>
+#include <filesystem>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+export module jowi.crogger:async_file;
+import :async;
+import :emitter;
+import :error;
+
+namespace jowi::crogger {
+  namespace fs = std::filesystem;
+
+  /*
+    AsyncFileState
+    records are counted in bytes: queued is the end of the last record handed to the emitter,
+    written and synced how far the worker got. A waiter fires once its offset is reached.
+  */
+  struct AsyncFileState {
+    using Waiter = std::pair<uint64_t, EmitterCallback>;
+
+    std::mutex mut;
+    std::condition_variable cv;
+    std::string filling;
+    uint64_t queued;
+    uint64_t written;
+    uint64_t synced;
+    std::vector<Waiter> write_waiters;
+    std::vector<Waiter> sync_waiters;
+    std::optional<LogError> error;
+    bool stopped;
+    int fd;
+    fs::path path;
+    std::thread worker;
+
+    AsyncFileState(int fd, fs::path p) :
+      queued{0}, written{0}, synced{0}, stopped{false}, fd{fd}, path{std::move(p)} {}
+    ~AsyncFileState() {
+      ::close(fd);
+    }
+
+    std::expected<void, LogError> write_all(std::string_view d) noexcept {
+      while (!d.empty()) {
+        auto n = ::write(fd, d.data(), d.size());
+        if (n < 0 && errno == EINTR) {
+          continue;
+        }
+        if (n <= 0) {
+          return std::unexpected{LogError::io_error("cannot write to file {}", path.c_str())};
+        }
+        d.remove_prefix(static_cast<uint64_t>(n));
+      }
+      return {};
+    }
+
+    std::expected<uint64_t, LogError> queue(std::string_view d) {
+      bool was_empty;
+      uint64_t end;
+      {
+        std::unique_lock lck{mut};
+        if (error) {
+          return std::unexpected{error.value()};
+        }
+        was_empty = filling.empty();
+        filling.append(d);
+        queued += d.size();
+        end = queued;
+      }
+      if (was_empty) {
+        cv.notify_one();
+      }
+      return end;
+    }
+
+    // calls done once the bytes up to offset are written, or synced when sync is set
+    void wait_for(uint64_t offset, bool sync, EmitterCallback done) {
+      std::unique_lock lck{mut};
+      if (error) {
+        lck.unlock();
+        done(std::unexpected{error.value()});
+        return;
+      }
+      if ((sync ? synced : written) >= offset) {
+        lck.unlock();
+        done({});
+        return;
+      }
+      (sync ? sync_waiters : write_waiters).emplace_back(offset, std::move(done));
+      lck.unlock();
+      if (sync) {
+        cv.notify_one();
+      }
+    }
+
+    // requires mut, moves the waiters at or below offset into ready
+    static void take_ready(
+      std::vector<Waiter> &waiters, uint64_t offset, std::vector<Waiter> &ready
+    ) {
+      std::erase_if(waiters, [&](Waiter &w) {
+        if (w.first > offset) {
+          return false;
+        }
+        ready.emplace_back(std::move(w));
+        return true;
+      });
+    }
+
+    void run() {
+      std::string batch;
+      std::vector<Waiter> ready;
+      std::unique_lock lck{mut};
+      while (true) {
+        cv.wait(lck, [&]() { return stopped || !filling.empty() || !sync_waiters.empty(); });
+        if (stopped && filling.empty() && sync_waiters.empty()) {
+          break;
+        }
+        batch.clear();
+        std::swap(batch, filling);
+        uint64_t end = queued;
+        bool sync = !sync_waiters.empty();
+        lck.unlock();
+        auto res = write_all(batch);
+        if (res && sync && fdatasync(fd) != 0) {
+          res = std::unexpected{LogError::io_error("cannot sync file {}", path.c_str())};
+        }
+        lck.lock();
+        if (res) {
+          written = end;
+          synced = sync ? end : synced;
+          take_ready(write_waiters, written, ready);
+          take_ready(sync_waiters, synced, ready);
+        } else {
+          // records are lost from here on, everyone waiting is told so
+          error = res.error();
+          std::ranges::move(write_waiters, std::back_inserter(ready));
+          std::ranges::move(sync_waiters, std::back_inserter(ready));
+          write_waiters.clear();
+          sync_waiters.clear();
+          filling.clear();
+        }
+        if (ready.empty()) {
+          continue;
+        }
+        lck.unlock();
+        for (auto &[offset, done] : ready) {
+          done(res);
+        }
+        ready.clear();
+        lck.lock();
+      }
+    }
+  };
+
+  /*
+    AsyncFileEmitter
+    writes records to a file from a background thread, such that logging never waits for the disk.
+    emit only appends the record to the batch the worker writes next. Coroutines running on an
+    Executor can co_await emit_async to wait until their record is written, and co_await
+    Logger::flush() until everything logged before is on the disk, without blocking the loop.
+  */
+  export struct AsyncFileEmitter {
+  private:
+    struct Stopper {
+      void operator()(AsyncFileState *state) {
+        {
+          std::unique_lock lck{state->mut};
+          state->stopped = true;
+        }
+        state->cv.notify_all();
+        state->worker.join();
+        delete state;
+      }
+    };
+    std::unique_ptr<AsyncFileState, Stopper> __state;
+
+    AsyncFileEmitter(std::unique_ptr<AsyncFileState, Stopper> state) :
+      __state{std::move(state)} {}
+
+  public:
+    std::expected<void, LogError> emit(std::string_view d) const {
+      return __state->queue(d).transform([](uint64_t) {});
+    }
+
+    /*
+      emit_async
+      queues the record right away, awaiting the result resumes once it is written.
+    */
+    EmitterAwaitable emit_async(std::string_view d) const {
+      return EmitterAwaitable{
+        [state = __state.get(), end = __state->queue(d)](EmitterCallback done) mutable {
+          if (!end) {
+            done(std::unexpected{end.error()});
+            return;
+          }
+          state->wait_for(end.value(), false, std::move(done));
+        }
+      };
+    }
+
+    void flush_async(EmitterCallback done) const {
+      uint64_t end;
+      {
+        std::unique_lock lck{__state->mut};
+        end = __state->queued;
+      }
+      __state->wait_for(end, true, std::move(done));
+    }
+
+    const fs::path &path() const noexcept {
+      return __state->path;
+    }
+
+    static std::expected<AsyncFileEmitter, LogError> open(const fs::path &p, bool append) {
+      int flags = O_WRONLY | O_CREAT | O_CLOEXEC | (append ? O_APPEND : O_TRUNC);
+      int fd = ::open(p.c_str(), flags, 0644);
+      if (fd == -1) {
+        return std::unexpected{LogError::io_error("cannot open file {}", p.c_str())};
+      }
+      auto state = std::unique_ptr<AsyncFileState, Stopper>{new AsyncFileState{fd, p}};
+      state->worker = std::thread{[s = state.get()]() { s->run(); }};
+      return AsyncFileEmitter{std::move(state)};
+    }
+  };
+
+  template struct Emitter<AsyncFileEmitter>;
+}
@@ -0,0 +1,235 @@
+module;
+#if defined(__x86_64__) || defined(__i386__)
+  #include <cpuid.h>
+  #include <x86intrin.h>
+#endif
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <concepts>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <stop_token>
+#include <thread>
+export module jowi.crogger:clock;
+
+namespace jowi::crogger {
+  export template <typename T>
+  concept IsClock = requires(const T clock) {
+    { clock.now() } -> std::same_as<std::chrono::system_clock::time_point>;
+  };
+
+  // Void specialization - abstract base class
+  export template <typename T = void> struct Clock;
+
+  export template <> struct Clock<void> {
+    virtual ~Clock() = default;
+
+    virtual std::chrono::system_clock::time_point now() const noexcept = 0;
+  };
+
+  export template <IsClock ClockType>
+  struct Clock<ClockType> : private ClockType, public Clock<void> {
+    using ClockType::ClockType; // Inherit constructors
+
+    Clock(ClockType &&clock) : ClockType(std::move(clock)) {}
+
+    std::chrono::system_clock::time_point now() const noexcept override {
+      return ClockType::now();
+    }
+  };
+
+  export struct SystemClock {
+    std::chrono::system_clock::time_point now() const noexcept {
+      return std::chrono::system_clock::now();
+    }
+  };
+
+  /*
+    read_ticks
+    reads the CPU timestamp counter, or returns 0 when the target has none we trust.
+  */
+  inline uint64_t read_ticks() noexcept {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#elif defined(__aarch64__)
+    uint64_t v;
+    asm volatile("mrs %0, cntvct_el0" : "=r"(v));
+    return v;
+#else
+    return 0;
+#endif
+  }
+
+  /*
+    has_invariant_ticks
+    true when the counter read by read_ticks runs at a constant rate across power states and
+    cores. On x86 this is the invariant TSC bit (CPUID 0x80000007, EDX bit 8), the ARM generic
+    timer always qualifies.
+  */
+  bool has_invariant_ticks() noexcept {
+#if defined(__x86_64__) || defined(__i386__)
+    unsigned int eax, ebx, ecx, edx;
+    if (__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx) == 0) {
+      return false;
+    }
+    return (edx & (1u << 8)) != 0;
+#elif defined(__aarch64__)
+    return true;
+#else
+    return false;
+#endif
+  }
+
+  struct TickSample {
+    uint64_t ticks;
+    int64_t ns;
+
+    /*
+      takes the wall clock between two counter reads, keeping the tightest of a few attempts so
+      that a preemption does not skew the pair.
+    */
+    static TickSample take() noexcept {
+      TickSample best{0, 0};
+      uint64_t best_window = static_cast<uint64_t>(-1);
+      for (int i = 0; i != 5; i += 1) {
+        uint64_t beg = read_ticks();
+        auto t = std::chrono::system_clock::now();
+        uint64_t end = read_ticks();
+        if (end - beg < best_window) {
+          best_window = end - beg;
+          best = TickSample{
+            beg + (end - beg) / 2,
+            std::chrono::duration_cast<std::chrono::nanoseconds>(t.time_since_epoch()).count()
+          };
+        }
+      }
+      return best;
+    }
+  };
+
+  /*
+    TickCalibration
+    maps counter values to wall time as ns + (ticks - anchor) * mult / 2^32. A single writer
+    updates it under a sequence counter, readers retry while an update is in flight.
+  */
+  struct TickCalibration {
+    std::atomic<uint32_t> seq{0};
+    std::atomic<uint64_t> anchor{0};
+    std::atomic<int64_t> ns{0};
+    std::atomic<uint64_t> mult{0};
+
+    void store(TickSample sample, uint64_t new_mult) noexcept {
+      uint32_t s = seq.load(std::memory_order_relaxed);
+      seq.store(s + 1, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_release);
+      anchor.store(sample.ticks, std::memory_order_relaxed);
+      ns.store(sample.ns, std::memory_order_relaxed);
+      mult.store(new_mult, std::memory_order_relaxed);
+      seq.store(s + 2, std::memory_order_release);
+    }
+
+    /*
+      converts ticks to nanoseconds since the epoch, false while the rate is not known yet.
+    */
+    bool convert(uint64_t ticks, int64_t &out) const noexcept {
+      while (true) {
+        uint32_t s = seq.load(std::memory_order_acquire);
+        if ((s & 1) != 0) {
+          continue;
+        }
+        uint64_t a = anchor.load(std::memory_order_relaxed);
+        int64_t n = ns.load(std::memory_order_relaxed);
+        uint64_t m = mult.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (seq.load(std::memory_order_relaxed) != s) {
+          continue;
+        }
+        if (m == 0) {
+          return false;
+        }
+        uint64_t delta = ticks > a ? ticks - a : 0;
+        out = n + static_cast<int64_t>((static_cast<__uint128_t>(delta) * m) >> 32);
+        return true;
+      }
+    }
+  };
+
+  /*
+    TickCalibrator
+    owns the calibration and the thread refreshing it. The rate is measured from the first sample,
+    so it gets more precise over time, while the anchor moves to the latest sample to follow
+    adjustments of the wall clock.
+  */
+  struct TickCalibrator {
+    TickCalibration calibration;
+    std::chrono::milliseconds refresh;
+    std::mutex mut;
+    std::condition_variable_any cv;
+    std::jthread worker;
+
+    TickCalibrator(std::chrono::milliseconds refresh_interval) : refresh{refresh_interval} {
+      worker = std::jthread{[this](std::stop_token stop) { run(stop); }};
+    }
+
+    bool sleep(std::stop_token &stop, std::chrono::milliseconds d) {
+      std::unique_lock lock{mut};
+      return !cv.wait_for(lock, stop, d, []() { return false; }) && !stop.stop_requested();
+    }
+
+    void run(std::stop_token stop) {
+      auto first = TickSample::take();
+      auto wait = std::chrono::milliseconds{10};
+      while (sleep(stop, wait)) {
+        auto latest = TickSample::take();
+        if (latest.ticks > first.ticks && latest.ns > first.ns) {
+          auto elapsed_ns = static_cast<__uint128_t>(latest.ns - first.ns);
+          auto elapsed_ticks = latest.ticks - first.ticks;
+          uint64_t mult = static_cast<uint64_t>((elapsed_ns << 32) / elapsed_ticks);
+          calibration.store(latest, mult);
+        }
+        wait = std::min(wait * 2, refresh);
+      }
+    }
+  };
+
+  /*
+    TscClock
+    reads the CPU timestamp counter and converts it to wall time with a calibration refreshed
+    every refresh_interval by a background thread. Falls back to the system clock (a vDSO call on
+    Linux) when the counter is not invariant, and during the first few milliseconds while the rate
+    is being measured.
+  */
+  export struct TscClock {
+  private:
+    std::unique_ptr<TickCalibrator> __calibrator;
+
+  public:
+    TscClock(std::chrono::milliseconds refresh_interval = std::chrono::seconds{1}) :
+      __calibrator{
+        has_invariant_ticks() ? std::make_unique<TickCalibrator>(refresh_interval) : nullptr
+      } {}
+
+    /*
+      uses_ticks
+      false when every reading comes from the system clock.
+    */
+    bool uses_ticks() const noexcept {
+      return __calibrator != nullptr;
+    }
+
+    std::chrono::system_clock::time_point now() const noexcept {
+      int64_t ns;
+      if (__calibrator && __calibrator->calibration.convert(read_ticks(), ns)) {
+        return std::chrono::system_clock::time_point{
+          std::chrono::duration_cast<std::chrono::system_clock::duration>(
+            std::chrono::nanoseconds{ns}
+          )
+        };
+      }
+      return std::chrono::system_clock::now();
+    }
+  };
+}
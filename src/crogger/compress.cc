@@ -0,0 +1,407 @@
+module;
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <expected>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+export module jowi.crogger:compress;
+import :emitter;
+import :error;
+import :hash;
+import :mapped_file;
+
+namespace jowi::crogger {
+  namespace fs = std::filesystem;
+
+  /*
+    BlockCompressor
+    a byte oriented LZ77 compressor in the spirit of LZ4. A block is a list of sequences:
+      token (literal length << 4 | match length - 4), [extra literal length], literals,
+      offset (2 bytes, little endian), [extra match length]
+    a length nibble of 15 continues in the following bytes (255 means keep reading). The last
+    sequence of a block only holds literals.
+  */
+  export struct BlockCompressor {
+  private:
+    static constexpr uint64_t __hash_bits = 12;
+    static constexpr uint64_t __min_match = 4;
+    static constexpr uint64_t __max_offset = 65535;
+    std::array<uint32_t, 1 << __hash_bits> __table;
+
+    static uint32_t __read32(const char *p) noexcept {
+      uint32_t v;
+      std::memcpy(&v, p, 4);
+      return v;
+    }
+    static uint32_t __hash(uint32_t v) noexcept {
+      return (v * 2654435761u) >> (32 - __hash_bits);
+    }
+    static void __put_length(std::string &out, uint64_t len) {
+      while (len >= 255) {
+        out.push_back(static_cast<char>(255));
+        len -= 255;
+      }
+      out.push_back(static_cast<char>(len));
+    }
+    static void __put_sequence(
+      std::string &out, std::string_view literals, uint64_t offset, uint64_t match_len
+    ) {
+      uint64_t lit_len = literals.size();
+      uint8_t token = static_cast<uint8_t>(std::min<uint64_t>(lit_len, 15) << 4);
+      if (match_len != 0) {
+        token |= static_cast<uint8_t>(std::min<uint64_t>(match_len - __min_match, 15));
+      }
+      out.push_back(static_cast<char>(token));
+      if (lit_len >= 15) __put_length(out, lit_len - 15);
+      out.append(literals);
+      if (match_len == 0) return;
+      out.push_back(static_cast<char>(offset & 0xff));
+      out.push_back(static_cast<char>(offset >> 8));
+      if (match_len - __min_match >= 15) __put_length(out, match_len - __min_match - 15);
+    }
+
+  public:
+    BlockCompressor() noexcept : __table{} {}
+
+    /*
+      compress
+      appends the compressed form of in to out. The output is at most
+      max_compressed_size(in.size()) bytes long.
+    */
+    void compress(std::string_view in, std::string &out) {
+      __table.fill(0);
+      const char *p = in.data();
+      uint64_t n = in.size();
+      uint64_t anchor = 0;
+      uint64_t ip = 0;
+      uint64_t match_limit = n > 12 ? n - 12 : 0;
+      uint64_t extend_limit = n > 5 ? n - 5 : 0;
+      while (ip < match_limit) {
+        uint32_t seq = __read32(p + ip);
+        uint32_t h = __hash(seq);
+        uint64_t ref = __table[h];
+        __table[h] = static_cast<uint32_t>(ip);
+        if (ref < ip && ip - ref <= __max_offset && __read32(p + ref) == seq) {
+          uint64_t len = __min_match;
+          while (ip + len < extend_limit && p[ref + len] == p[ip + len]) {
+            len += 1;
+          }
+          while (ip > anchor && ref > 0 && p[ip - 1] == p[ref - 1]) {
+            ip -= 1;
+            ref -= 1;
+            len += 1;
+          }
+          __put_sequence(out, in.substr(anchor, ip - anchor), ip - ref, len);
+          ip += len;
+          anchor = ip;
+        } else {
+          ip += 1;
+        }
+      }
+      __put_sequence(out, in.substr(anchor), 0, 0);
+    }
+
+    static constexpr uint64_t max_compressed_size(uint64_t n) noexcept {
+      return n + n / 255 + 16;
+    }
+  };
+
+  std::optional<uint64_t> read_length(std::string_view in, uint64_t &ip) noexcept {
+    uint64_t len = 0;
+    while (ip != in.size()) {
+      uint8_t b = static_cast<uint8_t>(in[ip]);
+      ip += 1;
+      len += b;
+      if (b != 255) return len;
+    }
+    return std::nullopt;
+  }
+
+  /*
+    decompress_block
+    appends the raw_size bytes encoded in in to out. Malformed input never reads or writes out of
+    bounds, it produces a FORMAT_ERROR instead.
+  */
+  export std::expected<void, LogError> decompress_block(
+    std::string_view in, uint64_t raw_size, std::string &out
+  ) {
+    uint64_t base = out.size();
+    uint64_t ip = 0;
+    out.reserve(base + raw_size);
+    while (ip < in.size()) {
+      uint8_t token = static_cast<uint8_t>(in[ip]);
+      ip += 1;
+      uint64_t lit_len = token >> 4;
+      if (lit_len == 15) {
+        auto extra = read_length(in, ip);
+        if (!extra) return std::unexpected{LogError::format_error("truncated literal length")};
+        lit_len += extra.value();
+      }
+      if (in.size() - ip < lit_len || out.size() - base + lit_len > raw_size) {
+        return std::unexpected{LogError::format_error("literals out of bounds")};
+      }
+      out.append(in.substr(ip, lit_len));
+      ip += lit_len;
+      if (ip == in.size()) break;
+      if (in.size() - ip < 2) {
+        return std::unexpected{LogError::format_error("truncated match offset")};
+      }
+      uint64_t offset = static_cast<uint8_t>(in[ip]) |
+        (static_cast<uint64_t>(static_cast<uint8_t>(in[ip + 1])) << 8);
+      ip += 2;
+      uint64_t match_len = (token & 15) + 4;
+      if ((token & 15) == 15) {
+        auto extra = read_length(in, ip);
+        if (!extra) return std::unexpected{LogError::format_error("truncated match length")};
+        match_len += extra.value();
+      }
+      uint64_t produced = out.size() - base;
+      if (offset == 0 || offset > produced || produced + match_len > raw_size) {
+        return std::unexpected{LogError::format_error("match out of bounds")};
+      }
+      uint64_t from = out.size() - offset;
+      for (uint64_t i = 0; i != match_len; i += 1) {
+        char c = out[from + i];
+        out.push_back(c);
+      }
+    }
+    if (out.size() - base != raw_size) {
+      return std::unexpected{LogError::format_error("block size mismatch")};
+    }
+    return {};
+  }
+
+  /*
+    FrameHeader
+    precedes every compressed block in a file. A block that does not shrink is stored as is, which
+    is signalled by packed_size == raw_size. The checksum covers the raw bytes.
+  */
+  export struct FrameHeader {
+    uint32_t magic;
+    uint32_t raw_size;
+    uint32_t packed_size;
+    uint32_t checksum;
+
+    static constexpr uint32_t frame_magic = 0x46475243;
+  };
+
+  /*
+    BlockReader
+    decodes a compressed log file block by block. A frame cut short at the end of the file (the
+    writer was interrupted) ends the iteration, the blocks before it stay readable.
+  */
+  export struct BlockReader {
+  private:
+    MappedFile __file;
+    uint64_t __offset;
+    std::string __buf;
+
+    BlockReader(MappedFile file) : __file{std::move(file)}, __offset{0}, __buf{} {}
+
+  public:
+    std::expected<std::optional<std::string_view>, LogError> next() {
+      auto data = __file.view();
+      if (data.size() - __offset < sizeof(FrameHeader)) {
+        return std::nullopt;
+      }
+      FrameHeader header;
+      std::memcpy(&header, data.data() + __offset, sizeof(FrameHeader));
+      if (header.magic != FrameHeader::frame_magic) {
+        return std::unexpected{LogError::format_error("bad frame at {}", __offset)};
+      }
+      if (data.size() - __offset - sizeof(FrameHeader) < header.packed_size) {
+        return std::nullopt;
+      }
+      auto payload = data.substr(__offset + sizeof(FrameHeader), header.packed_size);
+      __buf.clear();
+      if (header.packed_size == header.raw_size) {
+        __buf.append(payload);
+      } else {
+        auto res = decompress_block(payload, header.raw_size, __buf);
+        if (!res) {
+          return std::unexpected{std::move(res.error())};
+        }
+      }
+      if (static_cast<uint32_t>(fast_hash(__buf)) != header.checksum) {
+        return std::unexpected{LogError::format_error("checksum mismatch at {}", __offset)};
+      }
+      __offset += sizeof(FrameHeader) + header.packed_size;
+      return std::string_view{__buf};
+    }
+
+    static std::expected<BlockReader, LogError> open(const fs::path &p) {
+      return MappedFile::open(p).transform([](MappedFile &&f) {
+        return BlockReader{std::move(f)};
+      });
+    }
+  };
+
+  struct CompressState {
+    std::mutex mut;
+    std::condition_variable cv;
+    std::string filling;
+    std::deque<std::string> pending;
+    std::vector<std::string> spare;
+    std::optional<LogError> error;
+    bool stopped;
+    uint64_t block_size;
+    std::unique_ptr<FILE, FileCloser> f;
+    fs::path path;
+    std::thread worker;
+
+    static constexpr uint64_t max_pending = 8;
+    static constexpr std::chrono::milliseconds flush_interval{1000};
+
+    CompressState(std::unique_ptr<FILE, FileCloser> f, fs::path p, uint64_t block_size) :
+      stopped{false}, block_size{block_size}, f{std::move(f)}, path{std::move(p)} {
+      filling.reserve(block_size);
+    }
+
+    std::string take_spare() {
+      if (spare.empty()) {
+        std::string buf;
+        buf.reserve(block_size);
+        return buf;
+      }
+      auto buf = std::move(spare.back());
+      spare.pop_back();
+      return buf;
+    }
+
+    std::expected<void, LogError> write_block(
+      BlockCompressor &compressor, std::string_view block, std::string &packed
+    ) {
+      packed.clear();
+      compressor.compress(block, packed);
+      bool stored = packed.size() >= block.size();
+      auto payload = stored ? block : std::string_view{packed};
+      FrameHeader header{
+        FrameHeader::frame_magic,
+        static_cast<uint32_t>(block.size()),
+        static_cast<uint32_t>(payload.size()),
+        static_cast<uint32_t>(fast_hash(block))
+      };
+      if (fwrite(&header, sizeof(FrameHeader), 1, f.get()) != 1 ||
+          fwrite(payload.data(), sizeof(char), payload.size(), f.get()) != payload.size() ||
+          fflush(f.get()) != 0) {
+        return std::unexpected{LogError::io_error("cannot write to file {}", path.c_str())};
+      }
+      return {};
+    }
+
+    void run() {
+      BlockCompressor compressor;
+      std::string packed;
+      packed.reserve(BlockCompressor::max_compressed_size(block_size));
+      std::unique_lock lck{mut};
+      while (true) {
+        cv.wait_for(lck, flush_interval, [&]() { return stopped || !pending.empty(); });
+        if (pending.empty() && !filling.empty()) {
+          pending.emplace_back(std::exchange(filling, take_spare()));
+        }
+        if (pending.empty()) {
+          if (stopped) break;
+          continue;
+        }
+        auto block = std::move(pending.front());
+        pending.pop_front();
+        cv.notify_all();
+        lck.unlock();
+        auto res = write_block(compressor, block, packed);
+        block.clear();
+        lck.lock();
+        if (!res) {
+          error.emplace(std::move(res.error()));
+        }
+        spare.emplace_back(std::move(block));
+      }
+    }
+  };
+
+  /*
+    CompressedFileEmitter
+    collects records into blocks of block_size bytes. Filled blocks are compressed and written on
+    a background thread, partially filled blocks are written after at most a second. Producers
+    only wait when max_pending blocks are already queued.
+  */
+  export struct CompressedFileEmitter {
+  private:
+    struct Stopper {
+      void operator()(CompressState *state) {
+        {
+          std::unique_lock lck{state->mut};
+          state->stopped = true;
+        }
+        state->cv.notify_all();
+        state->worker.join();
+        delete state;
+      }
+    };
+    std::unique_ptr<CompressState, Stopper> __state;
+
+    CompressedFileEmitter(std::unique_ptr<CompressState, Stopper> state) :
+      __state{std::move(state)} {}
+
+  public:
+    std::expected<void, LogError> emit(std::string_view d) const {
+      auto &state = *__state;
+      std::unique_lock lck{state.mut};
+      if (state.error) {
+        auto e = std::move(state.error.value());
+        state.error.reset();
+        return std::unexpected{std::move(e)};
+      }
+      state.filling.append(d);
+      if (state.filling.size() >= state.block_size) {
+        state.cv.wait(lck, [&]() {
+          return state.pending.size() < CompressState::max_pending;
+        });
+        state.pending.emplace_back(std::exchange(state.filling, state.take_spare()));
+        state.cv.notify_all();
+      }
+      return {};
+    }
+
+    const fs::path &path() const noexcept {
+      return __state->path;
+    }
+
+    /*
+      open
+      block_size is below 4 GiB, the sizes of a frame being 32 bits wide.
+    */
+    static std::expected<CompressedFileEmitter, LogError> open(
+      const fs::path &p, bool append, uint64_t block_size = 64 * 1024
+    ) {
+      if (block_size >= (uint64_t{1} << 32)) {
+        return std::unexpected{
+          LogError::io_error("block size {} of {} is not below 4 GiB", block_size, p.c_str())
+        };
+      }
+      FILE *f = fopen(p.c_str(), append ? "a" : "w");
+      if (f == nullptr) {
+        return std::unexpected{LogError::io_error("cannot open file {}", p.c_str())};
+      }
+      auto state = std::unique_ptr<CompressState, Stopper>{new CompressState{
+        std::unique_ptr<FILE, FileCloser>{f, FileCloser{}}, p, std::max<uint64_t>(block_size, 1)
+      }};
+      state->worker = std::thread{[s = state.get()]() { s->run(); }};
+      return CompressedFileEmitter{std::move(state)};
+    }
+  };
+
+  template struct Emitter<CompressedFileEmitter>;
+}
@@ -0,0 +1,277 @@
+module;
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <expected>
+#include <filesystem>
+#include <format>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+export module jowi.crogger:control;
+import :error;
+import :shared_file;
+
+namespace jowi::crogger {
+  namespace fs = std::filesystem;
+
+  constexpr uint32_t control_magic = 0x43475243; // CRGC
+  constexpr uint32_t control_version = 1;
+
+  /*
+    ControlSlot
+    a named value of the control file. A slot is claimed by moving state from free to claiming
+    with a compare exchange, writing the name, then publishing it as ready.
+  */
+  struct ControlSlot {
+    static constexpr uint32_t free = 0;
+    static constexpr uint32_t claiming = 1;
+    static constexpr uint32_t ready = 2;
+
+    char name[56];
+    uint32_t state;
+    uint32_t value;
+
+    uint32_t load_state() noexcept {
+      return std::atomic_ref<uint32_t>{state}.load(std::memory_order_acquire);
+    }
+    std::string_view view_name() const noexcept {
+      return std::string_view{name, strnlen(name, sizeof(name))};
+    }
+  };
+  static_assert(sizeof(ControlSlot) == 64);
+
+  struct ControlHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t logger_slots;
+    uint32_t feature_slots;
+    uint64_t generation;
+    uint64_t pid;
+  };
+
+  export struct ControlEntry {
+    std::string name;
+    std::optional<unsigned int> value;
+  };
+
+  /*
+    FeatureToggle
+    a switch living in the control file, flipped from outside the process with croggerctl.
+  */
+  export struct FeatureToggle {
+  private:
+    uint32_t *__value;
+
+  public:
+    FeatureToggle(uint32_t *value) noexcept : __value{value} {}
+
+    bool enabled() const noexcept {
+      return std::atomic_ref<uint32_t>{*__value}.load(std::memory_order_relaxed) != 0;
+    }
+    explicit operator bool() const noexcept {
+      return enabled();
+    }
+  };
+
+  export fs::path control_path(uint64_t pid) {
+    return fs::path{std::format("/dev/shm/crogger.{}", pid)};
+  }
+
+  /*
+    ControlBlock
+    a shared memory file holding logger level overrides and feature toggles of one process. The
+    process maps it with create(), croggerctl with open(). Every level change bumps the
+    generation so that the loggers of the process resolve their level again; the values are plain
+    words read with relaxed atomic loads, there is no thread nor signal involved.
+    Only the loggers of the LoggerRegistry the block is attached to follow it: get_logger() and the
+    shortcuts without a logger argument do, a Logger used directly, root() included, does not.
+  */
+  export struct ControlBlock {
+    static constexpr uint32_t no_level = static_cast<uint32_t>(-1);
+
+  private:
+    SharedFile __file;
+
+    ControlBlock(SharedFile file) noexcept : __file{std::move(file)} {}
+
+    ControlHeader &__header() const noexcept {
+      return *reinterpret_cast<ControlHeader *>(__file.data());
+    }
+    ControlSlot *__loggers() const noexcept {
+      return reinterpret_cast<ControlSlot *>(__file.data() + sizeof(ControlSlot));
+    }
+    ControlSlot *__features() const noexcept {
+      return __loggers() + __header().logger_slots;
+    }
+
+    static ControlSlot *__find(ControlSlot *slots, uint32_t n, std::string_view name) noexcept {
+      for (uint32_t i = 0; i != n; i += 1) {
+        uint32_t state = slots[i].load_state();
+        while (state == ControlSlot::claiming) {
+          state = slots[i].load_state();
+        }
+        if (state == ControlSlot::free) {
+          return nullptr;
+        }
+        if (slots[i].view_name() == name) {
+          return slots + i;
+        }
+      }
+      return nullptr;
+    }
+
+    std::expected<ControlSlot *, LogError> __claim(
+      ControlSlot *slots, uint32_t n, std::string_view name, uint32_t initial
+    ) const {
+      if (name.size() >= sizeof(ControlSlot::name)) {
+        return std::unexpected{LogError::format_error("control name {} is too long", name)};
+      }
+      for (uint32_t i = 0; i != n; i += 1) {
+        auto &slot = slots[i];
+        uint32_t state = ControlSlot::free;
+        if (std::atomic_ref<uint32_t>{slot.state}.compare_exchange_strong(
+              state, ControlSlot::claiming, std::memory_order_acquire
+            )) {
+          std::memset(slot.name, 0, sizeof(slot.name));
+          std::memcpy(slot.name, name.data(), name.size());
+          std::atomic_ref<uint32_t>{slot.value}.store(initial, std::memory_order_relaxed);
+          std::atomic_ref<uint32_t>{slot.state}.store(
+            ControlSlot::ready, std::memory_order_release
+          );
+          return &slot;
+        }
+        while (state == ControlSlot::claiming) {
+          state = slot.load_state();
+        }
+        if (slot.view_name() == name) {
+          return &slot;
+        }
+      }
+      return std::unexpected{
+        LogError::io_error("control file {} is full", __file.path().c_str())
+      };
+    }
+
+    static std::vector<ControlEntry> __list(ControlSlot *slots, uint32_t n) {
+      std::vector<ControlEntry> entries;
+      for (uint32_t i = 0; i != n && slots[i].load_state() == ControlSlot::ready; i += 1) {
+        uint32_t v = std::atomic_ref<uint32_t>{slots[i].value}.load(std::memory_order_relaxed);
+        entries.emplace_back(
+          ControlEntry{
+            std::string{slots[i].view_name()},
+            v == no_level ? std::nullopt : std::optional<unsigned int>{v}
+          }
+        );
+      }
+      return entries;
+    }
+
+
+  public:
+    const fs::path &path() const noexcept {
+      return __file.path();
+    }
+    uint64_t pid() const noexcept {
+      return __header().pid;
+    }
+    uint64_t generation() const noexcept {
+      return std::atomic_ref<uint64_t>{__header().generation}.load(std::memory_order_relaxed);
+    }
+
+    /*
+      logger_level
+      the level word of a named logger, claimed when the name has no slot yet. Holds no_level while
+      the logger follows its in process configuration.
+    */
+    std::expected<uint32_t *, LogError> logger_level(std::string_view name) const {
+      return __claim(__loggers(), __header().logger_slots, name, no_level)
+        .transform([](ControlSlot *slot) { return &slot->value; });
+    }
+
+    std::expected<void, LogError> set_logger_level(
+      std::string_view name, std::optional<unsigned int> level
+    ) {
+      return __claim(__loggers(), __header().logger_slots, name, no_level)
+        .transform([&](ControlSlot *slot) {
+          std::atomic_ref<uint32_t>{slot->value}.store(
+            level.value_or(no_level), std::memory_order_relaxed
+          );
+          std::atomic_ref<uint64_t>{__header().generation}.fetch_add(
+            1, std::memory_order_release
+          );
+        });
+    }
+
+    /*
+      feature
+      the toggle called name, created with initial when it does not exist yet.
+    */
+    std::expected<FeatureToggle, LogError> feature(std::string_view name, bool initial = false) {
+      return __claim(__features(), __header().feature_slots, name, initial ? 1 : 0)
+        .transform([](ControlSlot *slot) { return FeatureToggle{&slot->value}; });
+    }
+
+    std::expected<void, LogError> set_feature(std::string_view name, bool enabled) {
+      auto *slot = __find(__features(), __header().feature_slots, name);
+      if (slot == nullptr) {
+        return std::unexpected{LogError::io_error("unknown feature {}", name)};
+      }
+      std::atomic_ref<uint32_t>{slot->value}.store(enabled ? 1 : 0, std::memory_order_relaxed);
+      return {};
+    }
+
+    std::vector<ControlEntry> loggers() const {
+      return __list(__loggers(), __header().logger_slots);
+    }
+    std::vector<ControlEntry> features() const {
+      return __list(__features(), __header().feature_slots);
+    }
+
+    /*
+      create
+      creates the control file of this process, removed again when the block is destroyed.
+    */
+    static std::expected<ControlBlock, LogError> create(
+      const fs::path &p = control_path(static_cast<uint64_t>(getpid())),
+      uint32_t logger_slots = 128,
+      uint32_t feature_slots = 64
+    ) {
+      uint64_t size = sizeof(ControlSlot) * (1 + logger_slots + feature_slots);
+      return SharedFile::create(p, size, true).transform([&](SharedFile &&file) {
+        ControlBlock block{std::move(file)};
+        auto &h = block.__header();
+        h.logger_slots = logger_slots;
+        h.feature_slots = feature_slots;
+        h.generation = 0;
+        h.pid = static_cast<uint64_t>(getpid());
+        h.version = control_version;
+        std::atomic_ref<uint32_t>{h.magic}.store(control_magic, std::memory_order_release);
+        return block;
+      });
+    }
+
+    static std::expected<ControlBlock, LogError> open(const fs::path &p) {
+      return SharedFile::open(p).and_then(
+        [&](SharedFile &&file) -> std::expected<ControlBlock, LogError> {
+          uint64_t size = file.size();
+          ControlBlock block{std::move(file)};
+          if (size < sizeof(ControlSlot)) {
+            return std::unexpected{LogError::io_error("{} is not a control file", p.c_str())};
+          }
+          auto &h = block.__header();
+          uint64_t slots = uint64_t{h.logger_slots} + h.feature_slots;
+          if (std::atomic_ref<uint32_t>{h.magic}.load(std::memory_order_acquire) != control_magic ||
+              h.version != control_version || sizeof(ControlSlot) * (1 + slots) > size) {
+            return std::unexpected{LogError::io_error("{} is not a control file", p.c_str())};
+          }
+          return block;
+        }
+      );
+    }
+  };
+}
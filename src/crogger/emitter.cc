@@ -1,12 +1,22 @@
 module;
+#include <cerrno>
+#include <chrono>
 #include <concepts>
+#include <cstdio>
 #include <expected>
 #include <filesystem>
 #include <memory>
+#include <mutex>
+#include <pthread.h>
 #include <string>
 #include <string_view>
+#include <unistd.h>
+#include <utility>
 export module jowi.crogger:emitter;
+import :async;
 import :error;
+import :log_context;
+import :log_index;
 
 namespace jowi::crogger {
   namespace fs = std::filesystem;
@@ -15,10 +25,45 @@ namespace jowi::crogger {
     { Emitter.emit(data) } -> std::same_as<std::expected<void, LogError>>;
   };
 
+  /*
+    IsContextEmitter
+    emitters that want the record metadata (time, level) alongside the formatted bytes. The Logger
+    always calls the context overload, emitters without it receive the bytes only.
+  */
+  export template <class T>
+  concept IsContextEmitter =
+    requires(const T Emitter, const LogContext &ctx, std::string_view data) {
+      { Emitter.emit(ctx, data) } -> std::same_as<std::expected<void, LogError>>;
+    };
+
+  /*
+    IsFlushableEmitter
+    emitters buffering records, flush() returns once the buffered records are written out.
+  */
+  export template <class T>
+  concept IsFlushableEmitter = requires(const T Emitter) {
+    { Emitter.flush() } -> std::same_as<std::expected<void, LogError>>;
+  };
+
+  /*
+    IsAsyncEmitter
+    emitters doing their I/O in the background. emit only queues the record, emit_async also lets
+    a coroutine wait until it is written, and flush_async calls back once every record queued
+    before is durable.
+  */
+  export template <class T>
+  concept IsAsyncEmitter =
+    IsEmitter<T> && requires(const T Emitter, std::string_view data, EmitterCallback done) {
+      { Emitter.emit_async(data) } -> std::same_as<EmitterAwaitable>;
+      { Emitter.flush_async(std::move(done)) } -> std::same_as<void>;
+    };
+
   export template <class T = void> struct Emitter;
 
   template <> struct Emitter<void> {
     virtual std::expected<void, LogError> emit(std::string_view) const = 0;
+    virtual std::expected<void, LogError> emit(const LogContext &, std::string_view) const = 0;
+    virtual void flush(EmitterCallback done) const = 0;
     virtual ~Emitter() = default;
 
     template <IsEmitter EmitterType, class... Args>
@@ -44,6 +89,22 @@ namespace jowi::crogger {
     std::expected<void, LogError> emit(std::string_view d) const override {
       return T::emit(d);
     }
+    std::expected<void, LogError> emit(const LogContext &ctx, std::string_view d) const override {
+      if constexpr (IsContextEmitter<T>) {
+        return T::emit(ctx, d);
+      } else {
+        return T::emit(d);
+      }
+    }
+    void flush(EmitterCallback done) const override {
+      if constexpr (IsAsyncEmitter<T>) {
+        T::flush_async(std::move(done));
+      } else if constexpr (IsFlushableEmitter<T>) {
+        done(T::flush());
+      } else {
+        done({});
+      }
+    }
   };
 
   export struct EmptyEmitter {
@@ -65,11 +126,12 @@ namespace jowi::crogger {
     using FilePtrType = std::unique_ptr<FILE, FileCloser>;
     FilePtrType __f;
     fs::path __path;
+    std::unique_ptr<IndexWriter> __index;
 
-    FileEmitter(FilePtrType f, fs::path p) : __f{std::move(f)}, __path{std::move(p)} {}
+    FileEmitter(FilePtrType f, fs::path p, std::unique_ptr<IndexWriter> index = nullptr) :
+      __f{std::move(f)}, __path{std::move(p)}, __index{std::move(index)} {}
 
-  public:
-    std::expected<void, LogError> emit(std::string_view v) const {
+    std::expected<void, LogError> __write(std::string_view v) const {
       auto res = fwrite(v.data(), sizeof(char), v.length(), __f.get());
       if (res != v.length()) {
         return std::unexpected{LogError::io_error("cannot write to file {}", __path.c_str())};
@@ -77,9 +139,44 @@ namespace jowi::crogger {
       return {};
     }
 
+    std::expected<void, LogError> __write_indexed(
+      std::chrono::system_clock::time_point t, unsigned int level, std::string_view v
+    ) const {
+      std::unique_lock lck{__index->mutex()};
+      return __write(v).transform([&]() { __index->record(t, level, v.length()); });
+    }
+
+  public:
+    std::expected<void, LogError> emit(std::string_view v) const {
+      if (__index) {
+        return __write_indexed(std::chrono::system_clock::now(), 0, v);
+      }
+      return __write(v);
+    }
+    std::expected<void, LogError> emit(const LogContext &ctx, std::string_view v) const {
+      if (__index) {
+        return __write_indexed(ctx.time, ctx.status.level, v);
+      }
+      return __write(v);
+    }
+
+    /*
+      flush
+      writes out what stdio buffered and waits for the data to reach the disk.
+    */
+    std::expected<void, LogError> flush() const {
+      if (fflush(__f.get()) != 0 || fdatasync(fileno(__f.get())) != 0) {
+        return std::unexpected{LogError::io_error("cannot flush file {}", __path.c_str())};
+      }
+      return {};
+    }
+
     const fs::path &path() const noexcept {
       return __path;
     }
+    bool is_indexed() const noexcept {
+      return __index != nullptr;
+    }
 
     static std::expected<FileEmitter, LogError> open(const fs::path &p, bool append) {
       FILE *f = fopen(p.c_str(), append ? "a" : "w");
@@ -89,19 +186,193 @@ namespace jowi::crogger {
       FilePtrType ptr{f, FileCloser{}};
       return FileEmitter{std::move(ptr), p};
     }
+
+    /*
+      open_indexed
+      opens a file emitter that also maintains a sidecar index ({path}.idx) holding the time range,
+      levels and byte range of every block of about index_every bytes. Records are written under a
+      lock such that the offsets in the index match the file.
+    */
+    static std::expected<FileEmitter, LogError> open_indexed(
+      const fs::path &p, bool append, uint64_t index_every = 64 * 1024
+    ) {
+      FILE *f = fopen(p.c_str(), append ? "a" : "w");
+      if (f == nullptr) {
+        return std::unexpected{LogError::io_error("cannot open file {}", p.c_str())};
+      }
+      FilePtrType ptr{f, FileCloser{}};
+      return IndexWriter::open(p, f, append, index_every).transform([&](auto &&index) {
+        return FileEmitter{std::move(ptr), p, std::move(index)};
+      });
+    }
   };
 
-  export struct StdoutEmitter {
-    std::expected<void, LogError> emit(std::string_view d) const noexcept {
-      fwrite(d.data(), sizeof(char), d.length(), stdout);
+  /*
+    ConsoleSink
+    the buffer shared by every emitter of one console fd, written with write(2) so that no stdio
+    lock is taken. An unbuffered sink (stderr) writes every record right away. Otherwise, on a
+    terminal every record is written as soon as it is complete; when the fd is redirected records
+    are batched and written once the buffer is full, by the first record arriving flush_interval
+    after the last write, by flush() or at exit. There is no timer, a quiet redirected sink keeps
+    its last records until one of those happens. out() and err() are written out before a fork,
+    a forked child starts with an empty buffer and checks again for a terminal, as it may have
+    since been given another fd (e.g. a request served by a daemon).
+  */
+  export struct ConsoleSink {
+    std::mutex mut;
+    int fd;
+    const char *name;
+    bool tty;
+    bool stale_tty;
+    bool buffered;
+    std::string buf;
+    std::chrono::steady_clock::time_point last_flush;
+
+    static constexpr uint64_t capacity = 64 * 1024;
+    static constexpr std::chrono::milliseconds flush_interval{200};
+
+    ConsoleSink(int fd, const char *name, bool buffered = true) :
+      fd{fd}, name{name}, tty{isatty(fd) == 1}, stale_tty{false}, buffered{buffered},
+      last_flush{std::chrono::steady_clock::now()} {
+      if (buffered) {
+        buf.reserve(capacity);
+      }
+    }
+    ~ConsoleSink() {
+      std::lock_guard lck{mut};
+      static_cast<void>(flush_locked());
+    }
+
+    std::expected<void, LogError> write_all(std::string_view d) noexcept {
+      while (!d.empty()) {
+        auto n = ::write(fd, d.data(), d.size());
+        if (n < 0 && errno == EINTR) {
+          continue;
+        }
+        if (n <= 0) {
+          return std::unexpected{LogError::io_error("cannot write to {}", name)};
+        }
+        d.remove_prefix(static_cast<uint64_t>(n));
+      }
+      return {};
+    }
+
+    // requires mut
+    std::expected<void, LogError> flush_locked() noexcept {
+      auto res = write_all(buf);
+      buf.clear();
+      last_flush = std::chrono::steady_clock::now();
+      return res;
+    }
+
+    // requires mut
+    bool tty_locked() noexcept {
+      if (stale_tty) {
+        tty = isatty(fd) == 1;
+        stale_tty = false;
+      }
+      return tty;
+    }
+
+    bool is_tty() {
+      std::lock_guard lck{mut};
+      return tty_locked();
+    }
+
+    std::expected<void, LogError> emit(std::string_view d) {
+      std::lock_guard lck{mut};
+      if (!buffered) {
+        return write_all(d);
+      }
+      if (tty_locked()) {
+        if (buf.empty() && d.ends_with('\n')) {
+          return write_all(d);
+        }
+        buf.append(d);
+        return d.find('\n') == std::string_view::npos ? std::expected<void, LogError>{}
+                                                        : flush_locked();
+      }
+      if (buf.size() + d.size() > capacity) {
+        auto res = flush_locked();
+        if (!res) return res;
+      }
+      if (d.size() >= capacity) {
+        return write_all(d);
+      }
+      buf.append(d);
+      if (std::chrono::steady_clock::now() - last_flush >= flush_interval) {
+        return flush_locked();
+      }
       return {};
     }
+
+    std::expected<void, LogError> flush() {
+      std::lock_guard lck{mut};
+      return flush_locked();
+    }
+
+    /*
+      Holds mut across a fork, writing the buffer out first. Otherwise the child would write the
+      parent's records a second time, and a fork while another thread emits would leave the
+      child's mut locked.
+    */
+    template <ConsoleSink &(*get)()> static void at_fork() {
+      ::pthread_atfork(
+        []() {
+          auto &sink = get();
+          sink.mut.lock();
+          static_cast<void>(sink.flush_locked());
+        },
+        []() { get().mut.unlock(); },
+        []() {
+          auto &sink = get();
+          sink.stale_tty = true;
+          sink.mut.unlock();
+        }
+      );
+    }
+
+    static ConsoleSink &out() {
+      static ConsoleSink sink{STDOUT_FILENO, "stdout"};
+      [[maybe_unused]] static bool forks = (at_fork<out>(), true);
+      return sink;
+    }
+    static ConsoleSink &err() {
+      static ConsoleSink sink{STDERR_FILENO, "stderr", false};
+      [[maybe_unused]] static bool forks = (at_fork<err>(), true);
+      return sink;
+    }
   };
 
+  /*
+    StdoutEmitter
+    writes to fd 1 through the buffer shared by all StdoutEmitters, bypassing the stdout FILE.
+  */
+  export struct StdoutEmitter {
+    std::expected<void, LogError> emit(std::string_view d) const {
+      return ConsoleSink::out().emit(d);
+    }
+    std::expected<void, LogError> flush() const {
+      return ConsoleSink::out().flush();
+    }
+    static bool is_tty() {
+      return ConsoleSink::out().is_tty();
+    }
+  };
+
+  /*
+    StderrEmitter
+    writes every record to fd 2 as it comes, like an unbuffered stderr FILE.
+  */
   export struct StderrEmitter {
-    std::expected<void, LogError> emit(std::string_view d) const noexcept {
-      fwrite(d.data(), sizeof(char), d.length(), stderr);
-      return {};
+    std::expected<void, LogError> emit(std::string_view d) const {
+      return ConsoleSink::err().emit(d);
+    }
+    std::expected<void, LogError> flush() const {
+      return ConsoleSink::err().flush();
+    }
+    static bool is_tty() {
+      return ConsoleSink::err().is_tty();
     }
   };
 
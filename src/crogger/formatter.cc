@@ -1,13 +1,16 @@
 module;
+#include <algorithm>
 #include <concepts>
 #include <expected>
 #include <format>
 #include <iterator>
+#include <string>
 export module jowi.crogger:formatter;
 import jowi.tui;
 import :error;
 import :log_context;
 import :emitter;
+import :record_buffer;
 
 namespace tui = jowi::tui;
 namespace jowi::crogger {
@@ -16,12 +19,24 @@ namespace jowi::crogger {
     { Formatter.format(ctx) } -> std::same_as<std::expected<std::string, LogError>>;
   };
 
+  /*
+    IsBoundedFormatter
+    formatters that can render straight into a RecordIterator. These are used by the Logger when a
+    record limit is set, such that formatting never allocates.
+  */
+  export template <class T>
+  concept IsBoundedFormatter =
+    requires(const T Formatter, const LogContext &ctx, RecordIterator &it) {
+      { Formatter.format_to(ctx, it) } -> std::same_as<std::expected<void, LogError>>;
+    };
+
   export template <class T = void> struct Formatter;
 
   export template <> struct Formatter<void> {
     virtual ~Formatter() = default;
 
     virtual std::expected<std::string, LogError> format(const LogContext &) const = 0;
+    virtual std::expected<void, LogError> format_to(const LogContext &, RecordIterator &) const = 0;
   };
   export template <IsFormatter FormatterType>
   struct Formatter<FormatterType> : private FormatterType, public Formatter<void> {
@@ -33,8 +48,26 @@ namespace jowi::crogger {
     std::expected<std::string, LogError> format(const LogContext &ctx) const override {
       return FormatterType::format(ctx);
     }
+
+    std::expected<void, LogError> format_to(
+      const LogContext &ctx, RecordIterator &it
+    ) const override {
+      if constexpr (IsBoundedFormatter<FormatterType>) {
+        return FormatterType::format_to(ctx, it);
+      } else {
+        return FormatterType::format(ctx).transform([&](std::string &&msg) {
+          it = std::ranges::copy(msg, it).out;
+        });
+      }
+    }
   };
 
+  /*
+    ColorfulFormatter
+    BwFormatter with the level tag coloured after its level. The escape codes are the ones
+    tui::ansi renders for a Layout styled with that colour, written straight to the output such
+    that format_to does not allocate.
+  */
   export struct ColorfulFormatter {
     tui::RgbColor get_level_color(unsigned int lvl) const noexcept {
       if (lvl < 10) return tui::RgbColor::cyan();
@@ -44,23 +77,41 @@ namespace jowi::crogger {
       if (lvl < 50) return tui::RgbColor::magenta();
       return tui::RgbColor::red();
     }
+    // the SGR foreground code of get_level_color(lvl)
+    unsigned int get_level_code(unsigned int lvl) const noexcept {
+      if (lvl < 10) return 36;
+      if (lvl < 20) return 34;
+      if (lvl < 30) return 32;
+      if (lvl < 40) return 33;
+      if (lvl < 50) return 35;
+      return 31;
+    }
     std::expected<std::string, LogError> format(const LogContext &ctx) const {
       std::expected<std::string, LogError> buf{std::string{}};
       std::back_insert_iterator<std::string> it = std::back_inserter(buf.value());
-      std::format_to(
+      it = std::format_to(
         it,
-        "{} {:%FT%TZ} ",
-        tui::DomNode::vstack(
-          tui::Layout{}
-            .style(tui::DomStyle{}.fg(get_level_color(ctx.status.level)))
-            .append_child(tui::Paragraph("[{}]", ctx.status.name).no_newline())
-        ),
+        "\x1b[0m\x1b[{}m[{}]\x1b[0m {:%FT%TZ} ",
+        get_level_code(ctx.status.level),
+        ctx.status.name,
         ctx.time
       );
       ctx.message.format(it);
       it = '\n';
       return buf;
     }
+    std::expected<void, LogError> format_to(const LogContext &ctx, RecordIterator &it) const {
+      it = std::format_to(
+        it,
+        "\x1b[0m\x1b[{}m[{}]\x1b[0m {:%FT%TZ} ",
+        get_level_code(ctx.status.level),
+        ctx.status.name,
+        ctx.time
+      );
+      ctx.message.format(it);
+      it = '\n';
+      return {};
+    }
   };
 
   export struct BwFormatter {
@@ -72,12 +123,21 @@ namespace jowi::crogger {
       it = '\n';
       return buf;
     }
+    std::expected<void, LogError> format_to(const LogContext &ctx, RecordIterator &it) const {
+      it = std::format_to(it, "[{}] {:%FT%TZ} ", ctx.status.name, ctx.time);
+      ctx.message.format(it);
+      it = '\n';
+      return {};
+    }
   };
 
   export struct EmptyFormatter {
     std::expected<std::string, LogError> format(const LogContext &ctx) const {
       return {};
     }
+    std::expected<void, LogError> format_to(const LogContext &ctx, RecordIterator &it) const {
+      return {};
+    }
   };
 
   export struct PlainFormatter {
@@ -88,6 +148,11 @@ namespace jowi::crogger {
       it = '\n';
       return buf;
     }
+    std::expected<void, LogError> format_to(const LogContext &ctx, RecordIterator &it) const {
+      ctx.message.format(it);
+      it = '\n';
+      return {};
+    }
   };
 
   template struct Formatter<BwFormatter>;
@@ -0,0 +1,35 @@
+module;
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+export module jowi.crogger:hash;
+
+namespace jowi::crogger {
+  constexpr uint64_t hash_mix(uint64_t a, uint64_t b) noexcept {
+    __uint128_t r = static_cast<__uint128_t>(a) * b;
+    return static_cast<uint64_t>(r) ^ static_cast<uint64_t>(r >> 64);
+  }
+
+  /*
+    fast_hash
+    a non cryptographic 64 bit hash consuming eight bytes per step. Used to checksum compressed
+    blocks and to recognise repeated records, never for anything security sensitive.
+  */
+  export uint64_t fast_hash(std::string_view data, uint64_t seed = 0) noexcept {
+    uint64_t h = seed ^ 0x9e3779b97f4a7c15ull ^ data.size();
+    const char *p = data.data();
+    uint64_t n = data.size();
+    uint64_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+      uint64_t w;
+      std::memcpy(&w, p + i, 8);
+      h = hash_mix(h ^ w, 0xbf58476d1ce4e5b9ull);
+    }
+    if (i != n) {
+      uint64_t w = 0;
+      std::memcpy(&w, p + i, n - i);
+      h = hash_mix(h ^ w, 0x94d049bb133111ebull);
+    }
+    return hash_mix(h, 0x2545f4914f6cdd1dull);
+  }
+}
@@ -5,13 +5,14 @@ module;
 #include <string_view>
 export module jowi.crogger:log_context;
 import :log_level;
-import :emitter;
+import :record_buffer;
 
 namespace jowi::crogger {
   export struct RawMessage {
   public:
     virtual ~RawMessage() = default;
     virtual void format(std::back_insert_iterator<std::string> &it) const = 0;
+    virtual void format(RecordIterator &it) const = 0;
   };
 
   // Concrete implementation that holds format string and arguments
@@ -30,6 +31,15 @@ namespace jowi::crogger {
         __args
       );
     }
+
+    void format(RecordIterator &it) const override {
+      std::apply(
+        [&](const auto &...args) {
+          it = std::vformat_to(it, __fmt, std::make_format_args(args...));
+        },
+        __args
+      );
+    }
   };
 
   /*
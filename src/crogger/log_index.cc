@@ -0,0 +1,188 @@
+module;
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <expected>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <system_error>
+#include <vector>
+export module jowi.crogger:log_index;
+import :error;
+import :mapped_file;
+
+namespace jowi::crogger {
+  namespace fs = std::filesystem;
+
+  /*
+    IndexEntry
+    describes a block of consecutive records in a log file: the byte range, the time range and a
+    mask of the levels present (bit level / 10).
+  */
+  export struct IndexEntry {
+    int64_t first_time;
+    int64_t last_time;
+    uint64_t offset;
+    uint64_t size;
+    uint32_t level_mask;
+    uint32_t reserved;
+
+    bool has_level_at_least(unsigned int level) const noexcept {
+      return (level_mask >> std::min(level / 10, 31u)) != 0;
+    }
+  };
+
+  export struct IndexRange {
+    uint64_t offset;
+    uint64_t size;
+  };
+
+  export fs::path index_path(const fs::path &p) {
+    return fs::path{p}.concat(".idx");
+  }
+
+  /*
+    IndexWriter
+    accumulates the records written to a log file into blocks of about every bytes, and appends an
+    IndexEntry to the sidecar once a block is complete. The caller holds mutex() around the write of
+    the record and the call to record(), such that offsets match the file. The log is flushed
+    before an entry is written, a reader following the index never runs past the written data.
+  */
+  export struct IndexWriter {
+  private:
+    std::mutex __mut;
+    FILE *__f;
+    FILE *__log;
+    fs::path __path;
+    uint64_t __every;
+    uint64_t __offset;
+    std::optional<IndexEntry> __block;
+
+    void __write_block() {
+      if (__block) {
+        fflush(__log);
+        fwrite(&__block.value(), sizeof(IndexEntry), 1, __f);
+        fflush(__f);
+        __block.reset();
+      }
+    }
+
+    IndexWriter(FILE *f, FILE *log, fs::path p, uint64_t every, uint64_t offset) :
+      __f{f}, __log{log}, __path{std::move(p)}, __every{every}, __offset{offset},
+      __block{std::nullopt} {}
+
+  public:
+    IndexWriter(const IndexWriter &) = delete;
+    IndexWriter &operator=(const IndexWriter &) = delete;
+    ~IndexWriter() {
+      __write_block();
+      fclose(__f);
+    }
+
+    std::mutex &mutex() noexcept {
+      return __mut;
+    }
+
+    void record(std::chrono::system_clock::time_point t, unsigned int level, uint64_t size) {
+      int64_t time =
+        std::chrono::duration_cast<std::chrono::nanoseconds>(t.time_since_epoch()).count();
+      if (!__block) {
+        __block.emplace(IndexEntry{time, time, __offset, 0, 0, 0});
+      }
+      auto &block = __block.value();
+      block.first_time = std::min(block.first_time, time);
+      block.last_time = std::max(block.last_time, time);
+      block.size += size;
+      block.level_mask |= 1u << std::min(level / 10, 31u);
+      __offset += size;
+      if (block.size >= __every) {
+        __write_block();
+      }
+    }
+
+    /*
+      open
+      the index of log_path, whose records are written to log. log must outlive the writer.
+    */
+    static std::expected<std::unique_ptr<IndexWriter>, LogError> open(
+      const fs::path &log_path, FILE *log, bool append, uint64_t every
+    ) {
+      std::error_code ec;
+      uint64_t offset = fs::exists(log_path, ec) ? fs::file_size(log_path, ec) : 0;
+      if (ec) {
+        return std::unexpected{LogError::io_error("cannot stat file {}", log_path.c_str())};
+      }
+      auto p = index_path(log_path);
+      FILE *f = fopen(p.c_str(), append ? "a" : "w");
+      if (f == nullptr) {
+        return std::unexpected{LogError::io_error("cannot open index {}", p.c_str())};
+      }
+      return std::unique_ptr<IndexWriter>{new IndexWriter{f, log, std::move(p), every, offset}};
+    }
+  };
+
+  /*
+    IndexReader
+    loads the sidecar of a log file and selects the byte ranges that may hold records of a time
+    window. Blocks are assumed to be written in roughly increasing time, as a single emitter does.
+  */
+  export struct IndexReader {
+  private:
+    std::vector<IndexEntry> __entries;
+
+    IndexReader(std::vector<IndexEntry> entries) : __entries{std::move(entries)} {}
+
+  public:
+    const std::vector<IndexEntry> &entries() const noexcept {
+      return __entries;
+    }
+
+    /*
+      covered_until
+      the end of the last indexed block, records after it are not in the index yet.
+    */
+    uint64_t covered_until() const noexcept {
+      if (__entries.empty()) return 0;
+      return __entries.back().offset + __entries.back().size;
+    }
+
+    std::vector<IndexRange> select(
+      std::chrono::sys_time<std::chrono::nanoseconds> from,
+      std::chrono::sys_time<std::chrono::nanoseconds> to,
+      unsigned int min_level
+    ) const {
+      int64_t from_ns = from.time_since_epoch().count();
+      int64_t to_ns = to.time_since_epoch().count();
+      std::vector<IndexRange> ranges;
+      auto it = std::ranges::partition_point(__entries, [&](const IndexEntry &e) {
+        return e.last_time < from_ns;
+      });
+      for (; it != __entries.end() && it->first_time <= to_ns; ++it) {
+        if (!it->has_level_at_least(min_level)) {
+          continue;
+        }
+        if (!ranges.empty() && ranges.back().offset + ranges.back().size == it->offset) {
+          ranges.back().size += it->size;
+        } else {
+          ranges.emplace_back(IndexRange{it->offset, it->size});
+        }
+      }
+      return ranges;
+    }
+
+    static std::expected<IndexReader, LogError> open(const fs::path &log_path) {
+      return MappedFile::open(index_path(log_path)).transform([](MappedFile &&f) {
+        auto data = f.view();
+        std::vector<IndexEntry> entries(data.size() / sizeof(IndexEntry));
+        if (!entries.empty()) {
+          std::memcpy(entries.data(), data.data(), entries.size() * sizeof(IndexEntry));
+        }
+        return IndexReader{std::move(entries)};
+      });
+    }
+  };
+}
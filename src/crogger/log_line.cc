@@ -0,0 +1,132 @@
+module;
+#include <charconv>
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+export module jowi.crogger:log_line;
+import :log_level;
+
+namespace jowi::crogger {
+  /*
+    LogLine
+    the head of a record as written by BwFormatter or ColorfulFormatter:
+      [LEVEL] YYYY-MM-DDTHH:MM:SS.fffZ message
+  */
+  export struct LogLine {
+    std::string_view level;
+    std::chrono::sys_time<std::chrono::nanoseconds> time;
+    std::string_view message;
+  };
+
+  template <class T> std::optional<T> parse_number(std::string_view v) noexcept {
+    T num;
+    auto res = std::from_chars(v.data(), v.data() + v.size(), num);
+    if (res.ec != std::errc{} || res.ptr != v.data() + v.size()) {
+      return std::nullopt;
+    }
+    return num;
+  }
+
+  uint64_t skip_escapes(std::string_view v, uint64_t pos) noexcept {
+    while (v.substr(pos).starts_with("\x1b[")) {
+      auto end = v.find('m', pos);
+      if (end == std::string_view::npos) return pos;
+      pos = end + 1;
+    }
+    return pos;
+  }
+
+  /*
+    parse_log_time
+    parses the %FT%TZ timestamps emitted by the formatters, the fractional seconds are optional.
+  */
+  export std::optional<std::chrono::sys_time<std::chrono::nanoseconds>> parse_log_time(
+    std::string_view v
+  ) noexcept {
+    if (v.size() < 20 || v[4] != '-' || v[7] != '-' || v[10] != 'T' || v[13] != ':' ||
+        v[16] != ':' || v.back() != 'Z') {
+      return std::nullopt;
+    }
+    auto y = parse_number<int>(v.substr(0, 4));
+    auto m = parse_number<unsigned int>(v.substr(5, 2));
+    auto d = parse_number<unsigned int>(v.substr(8, 2));
+    auto hh = parse_number<int64_t>(v.substr(11, 2));
+    auto mm = parse_number<int64_t>(v.substr(14, 2));
+    auto ss = parse_number<int64_t>(v.substr(17, 2));
+    if (!y || !m || !d || !hh || !mm || !ss) {
+      return std::nullopt;
+    }
+    int64_t frac_ns = 0;
+    auto frac = v.substr(19, v.size() - 20);
+    if (!frac.empty()) {
+      if (frac[0] != '.' || frac.size() > 10) {
+        return std::nullopt;
+      }
+      auto digits = frac.substr(1);
+      auto num = parse_number<int64_t>(digits);
+      if (!num) {
+        return std::nullopt;
+      }
+      frac_ns = num.value();
+      for (auto i = digits.size(); i < 9; i += 1) {
+        frac_ns *= 10;
+      }
+    }
+    auto ymd = std::chrono::year{y.value()} / std::chrono::month{m.value()} /
+      std::chrono::day{d.value()};
+    if (!ymd.ok()) {
+      return std::nullopt;
+    }
+    return std::chrono::sys_days{ymd} + std::chrono::hours{hh.value()} +
+      std::chrono::minutes{mm.value()} + std::chrono::seconds{ss.value()} +
+      std::chrono::nanoseconds{frac_ns};
+  }
+
+  /*
+    parse_level
+    accepts the name of a built in LogLevel (e.g. WARN) or a numeric level.
+  */
+  export std::optional<unsigned int> parse_level(std::string_view v) noexcept {
+    for (const auto &l : {
+           LogLevel::trace(),
+           LogLevel::debug(),
+           LogLevel::info(),
+           LogLevel::warn(),
+           LogLevel::error(),
+           LogLevel::critical()
+         }) {
+      if (std::string_view{l.name.c_str()} == v) {
+        return l.level;
+      }
+    }
+    return parse_number<unsigned int>(v);
+  }
+
+  export std::optional<LogLine> parse_log_line(std::string_view line) noexcept {
+    uint64_t beg = skip_escapes(line, 0);
+    if (beg == line.size() || line[beg] != '[') {
+      return std::nullopt;
+    }
+    auto close = line.find(']', beg);
+    if (close == std::string_view::npos) {
+      return std::nullopt;
+    }
+    auto level = line.substr(beg + 1, close - beg - 1);
+    auto time_beg = skip_escapes(line, close + 1);
+    if (time_beg == line.size() || line[time_beg] != ' ') {
+      return std::nullopt;
+    }
+    time_beg += 1;
+    auto time_end = line.find(' ', time_beg);
+    if (time_end == std::string_view::npos) {
+      time_end = line.size();
+    }
+    auto time = parse_log_time(line.substr(time_beg, time_end - time_beg));
+    if (!time) {
+      return std::nullopt;
+    }
+    auto message = time_end == line.size() ? std::string_view{} : line.substr(time_end + 1);
+    return LogLine{level, time.value(), message};
+  }
+}
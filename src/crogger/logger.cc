@@ -1,27 +1,149 @@
 module;
+#include <algorithm>
+#include <array>
 #include <chrono>
+#include <cstdint>
 #include <expected>
+#include <iterator>
 #include <memory>
+#include <mutex>
+#include <optional>
 #include <source_location>
+#include <string>
+#include <string_view>
 export module jowi.crogger:logger;
+import :async;
+import :clock;
 import :emitter;
 import :filter;
 import :formatter;
 import :error;
+import :hash;
 import :log_context;
+import :record_buffer;
 
 namespace jowi::crogger {
+  /*
+    DedupState
+    the run of identical records being collapsed: its hash, the first record's level, call site and
+    time, and how many records were swallowed since.
+  */
+  struct DedupState {
+    std::mutex mut;
+    std::chrono::system_clock::duration window;
+    uint64_t hash;
+    LogLevel status;
+    std::source_location loc;
+    std::chrono::system_clock::time_point first;
+    uint64_t repeated;
+
+    DedupState(std::chrono::system_clock::duration w) :
+      window{w}, hash{0}, status{LogLevel::trace()}, loc{}, first{}, repeated{0} {}
+
+    /*
+      record_hash
+      hashes the rendered message together with the level and call site, the time is left out.
+    */
+    static uint64_t record_hash(const LogContext &ctx, std::string_view text) noexcept {
+      uint64_t h = reinterpret_cast<uintptr_t>(ctx.loc.file_name()) ^
+        (uint64_t{ctx.loc.line()} << 32) ^ ctx.status.level;
+      return fast_hash(text, h);
+    }
+  };
+
+  /*
+    RenderedMessage
+    a message rendered once, such that dedup hashes the very bytes that are then written. The text
+    stays inline up to N bytes, a longer one moves to the heap as it is rendered.
+  */
+  template <uint64_t N> struct RenderedMessage : public RawMessage {
+  private:
+    std::array<char, N> __local;
+    std::string __spilled;
+    std::string_view __text;
+
+  public:
+    RenderedMessage(const RawMessage &msg) {
+      RecordIterator it{
+        __local.data(),
+        __local.data() + __local.size(),
+        [](void *arg, std::string_view d) noexcept { static_cast<std::string *>(arg)->append(d); },
+        &__spilled
+      };
+      msg.format(it);
+      if (__spilled.empty()) {
+        __text = std::string_view{it.begin(), it.size()};
+      } else {
+        __spilled.append(it.begin(), it.size());
+        __text = __spilled;
+      }
+    }
+    RenderedMessage(const RenderedMessage &) = delete;
+    RenderedMessage &operator=(const RenderedMessage &) = delete;
+
+    std::string_view text() const noexcept {
+      return __text;
+    }
+    void format(std::back_insert_iterator<std::string> &it) const override {
+      it = std::copy(__text.begin(), __text.end(), it);
+    }
+    void format(RecordIterator &it) const override {
+      it = std::copy(__text.begin(), __text.end(), it);
+    }
+  };
+
   export struct Logger {
   private:
     std::unique_ptr<ContextFilter<void>> __flt;
     std::unique_ptr<Formatter<void>> __fmt;
     mutable std::unique_ptr<Emitter<void>> __emt;
+    std::unique_ptr<Clock<void>> __clk;
+    std::optional<uint64_t> __record_limit;
+    std::unique_ptr<DedupState> __dedup;
+
+    static std::unique_ptr<Formatter<void>> __default_formatter() {
+      if (StdoutEmitter::is_tty()) {
+        return std::make_unique<Formatter<ColorfulFormatter>>();
+      }
+      return std::make_unique<Formatter<BwFormatter>>();
+    }
+
+    // the report itself failing (e.g. stdout is closed) is ignored
+    static void __report_error(const LogError &e) {
+      static_cast<void>(
+        __default_formatter()
+          ->format(
+            {LogLevel::error(),
+             std::source_location::current(),
+             std::chrono::system_clock::now(),
+             Message{"{}", e.what()}}
+          )
+          .and_then([&](auto msg) { return StdoutEmitter{}.emit(std::move(msg)); })
+      );
+    }
 
   public:
+    /*
+      The largest record that can be rendered without allocation, see set_record_limit.
+    */
+    static constexpr uint64_t inline_record_size = 2048;
+
+    /*
+      Writes to stdout, with colors when it is a terminal and with BwFormatter when redirected.
+    */
     Logger(uint64_t buf_size = 120) :
       __flt{std::make_unique<ContextFilter<NoFilter>>()},
-      __fmt{std::make_unique<Formatter<ColorfulFormatter>>()},
-      __emt{std::make_unique<Emitter<StdoutEmitter>>()} {}
+      __fmt{__default_formatter()},
+      __emt{std::make_unique<Emitter<StdoutEmitter>>()},
+      __clk{std::make_unique<Clock<SystemClock>>()}, __record_limit{std::nullopt},
+      __dedup{nullptr} {}
+    Logger(Logger &&) = default;
+    Logger &operator=(Logger &&) = default;
+    ~Logger() {
+      if (__dedup) {
+        __close_run(*__dedup, now());
+      }
+    }
     Logger &set_filter(IsFilter auto &&flt) {
       __flt = std::make_unique<ContextFilter<std::decay_t<decltype(flt)>>>(
         std::forward<decltype(flt)>(flt)
@@ -41,22 +163,122 @@ namespace jowi::crogger {
       return *this;
     }
 
-    void log(const LogContext &ctx) const {
-      if (__flt->filter(ctx)) {
+    /*
+      set_clock
+      replaces the source of LogContext::time, e.g. with a TscClock.
+    */
+    Logger &set_clock(IsClock auto &&clk) {
+      __clk =
+        std::make_unique<Clock<std::decay_t<decltype(clk)>>>(std::forward<decltype(clk)>(clk));
+      return *this;
+    }
+    std::chrono::system_clock::time_point now() const noexcept {
+      return __clk->now();
+    }
+
+    /*
+      set_dedup
+      collapses identical consecutive records (same level, call site and rendered message) arriving
+      within window of the first one: the first is written, the others are counted and reported
+      as a single "repeated N times" record when the run ends.
+    */
+    Logger &set_dedup(std::chrono::system_clock::duration window) {
+      __dedup = std::make_unique<DedupState>(window);
+      return *this;
+    }
+    Logger &unset_dedup() {
+      if (__dedup) {
+        std::lock_guard lock{__dedup->mut};
+        __close_run(*__dedup, now());
+      }
+      __dedup.reset();
+      return *this;
+    }
+
+    /*
+      set_record_limit
+      renders every record into an inline buffer of at most limit bytes (capped at
+      inline_record_size). Records exceeding the limit are cut and end with a truncation marker.
+      Formatters satisfying IsBoundedFormatter render without touching the heap.
+    */
+    Logger &set_record_limit(uint64_t limit) {
+      __record_limit = std::min(limit, inline_record_size);
+      return *this;
+    }
+    Logger &unset_record_limit() {
+      __record_limit.reset();
+      return *this;
+    }
+    std::optional<uint64_t> record_limit() const noexcept {
+      return __record_limit;
+    }
+
+  private:
+    // emits the "repeated N times" line closing the current run, if any
+    void __close_run(DedupState &d, std::chrono::system_clock::time_point t) const {
+      if (d.repeated != 0) {
+        __write(LogContext{d.status, d.loc, t, Message{"repeated {} times", d.repeated}});
+        d.repeated = 0;
+      }
+    }
+
+    void __write(const LogContext &ctx) const {
+      if (__record_limit) {
+        RecordBuffer<inline_record_size> buf;
+        auto it = buf.writer(__record_limit.value());
+        __fmt->format_to(ctx, it)
+          .and_then([&]() { return __emt->emit(ctx, buf.finish(it)); })
+          .or_else([&](auto &&e) {
+            __report_error(e);
+            return std::expected<void, LogError>{};
+          });
+      } else {
         __fmt->format(ctx)
-          .and_then([&](auto msg) { return __emt->emit(std::move(msg)); })
+          .and_then([&](auto msg) { return __emt->emit(ctx, msg); })
           .or_else([&](auto &&e) {
-            return ColorfulFormatter{}
-              .format(
-                {LogLevel::error(),
-                 std::source_location::current(),
-                 std::chrono::system_clock::now(),
-                 Message{"{}", e.what()}}
-              )
-              .and_then([&](auto msg) { return StdoutEmitter{}.emit(std::move(msg)); });
-          })
-          .value();
+            __report_error(e);
+            return std::expected<void, LogError>{};
+          });
+      }
+    }
+
+  public:
+    /*
+      flush
+      resumes the awaiting task once every record logged before is written out, and on the disk
+      for file emitters. Emitters without a buffer complete right away. A pending dedup run is
+      closed first, its "repeated N times" record being part of what is flushed.
+    */
+    EmitterAwaitable flush() const {
+      if (__dedup) {
+        std::lock_guard lock{__dedup->mut};
+        __close_run(*__dedup, now());
+      }
+      return EmitterAwaitable{[this](EmitterCallback done) { __emt->flush(std::move(done)); }};
+    }
+
+    void log(const LogContext &ctx) const {
+      if (!__flt->filter(ctx)) {
+        return;
+      }
+      if (__dedup) {
+        auto &d = *__dedup;
+        RenderedMessage<inline_record_size> msg{ctx.message};
+        uint64_t h = DedupState::record_hash(ctx, msg.text());
+        std::lock_guard lock{d.mut};
+        if (h == d.hash && ctx.time - d.first <= d.window) {
+          d.repeated += 1;
+          return;
+        }
+        __close_run(d, ctx.time);
+        d.hash = h;
+        d.status = ctx.status;
+        d.loc = ctx.loc;
+        d.first = ctx.time;
+        __write(LogContext{ctx.status, ctx.loc, ctx.time, msg});
+        return;
       }
+      __write(ctx);
     }
   };
-}
\ No newline at end of file
+}
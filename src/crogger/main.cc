@@ -2,6 +2,7 @@ module;
 #include <chrono>
 #include <expected>
 #include <source_location>
+#include <string_view>
 export module jowi.crogger;
 export import :log_context;
 export import :emitter;
@@ -10,6 +11,22 @@ export import :filter;
 export import :formatter;
 export import :logger;
 export import :log_level;
+export import :record_buffer;
+export import :mapped_file;
+export import :shard;
+export import :hash;
+export import :compress;
+export import :log_index;
+export import :log_line;
+export import :scan;
+export import :clock;
+export import :shared_file;
+export import :control;
+export import :registry;
+export import :socket_emitter;
+export import :ring;
+export import :async;
+export import :async_file;
 
 /*
   Static Variables and usage
@@ -17,28 +34,36 @@ export import :log_level;
 
 namespace jowi::crogger {
   static Logger root_logger{};
+  static LoggerRegistry root_registry{root_logger};
 
   export Logger &root() {
     return root_logger;
   }
 
+  /*
+    registry
+    the registry of named loggers, its root logger writes to root().
+  */
+  export LoggerRegistry &registry() {
+    return root_registry;
+  }
+
+  export NamedLogger get_logger(std::string_view name) {
+    return root_registry.get(name);
+  }
+
+  static NamedLogger root_named = root_registry.get("");
+
   export void log(
     const Logger &l,
     LogLevel status,
     const RawMessage &fmt,
     std::source_location loc = std::source_location::current()
   ) {
-    auto t = std::chrono::system_clock::now();
+    auto t = l.now();
     return static_cast<void>(l.log(LogContext{status, loc, t, fmt}));
   }
 
-  export void log(
-    LogLevel status,
-    const RawMessage &fmt,
-    std::source_location loc = std::source_location::current()
-  ) {
-    return log(root(), status, fmt, loc);
-  }
   export void trace(
     const Logger &l,
     const RawMessage &fmt,
@@ -87,7 +112,82 @@ namespace jowi::crogger {
     return log(l, LogLevel::critical(), fmt, loc);
   }
 
-  // Global shortcuts (using root_logger)
+  // Named logger shortcuts, the level is checked before the time is taken
+  export void log(
+    const NamedLogger &l,
+    LogLevel status,
+    const RawMessage &fmt,
+    std::source_location loc = std::source_location::current()
+  ) {
+    if (!l.enabled(status.level)) {
+      return;
+    }
+    const auto &sink = l.sink();
+    sink.log(LogContext{status, loc, sink.now(), fmt});
+  }
+
+  export void trace(
+    const NamedLogger &l,
+    const RawMessage &fmt,
+    std::source_location loc = std::source_location::current()
+  ) {
+    return log(l, LogLevel::trace(), fmt, loc);
+  }
+
+  export void debug(
+    const NamedLogger &l,
+    const RawMessage &fmt,
+    std::source_location loc = std::source_location::current()
+  ) {
+    return log(l, LogLevel::debug(), fmt, loc);
+  }
+
+  export void info(
+    const NamedLogger &l,
+    const RawMessage &fmt,
+    std::source_location loc = std::source_location::current()
+  ) {
+    return log(l, LogLevel::info(), fmt, loc);
+  }
+
+  export void warn(
+    const NamedLogger &l,
+    const RawMessage &fmt,
+    std::source_location loc = std::source_location::current()
+  ) {
+    return log(l, LogLevel::warn(), fmt, loc);
+  }
+
+  export void error(
+    const NamedLogger &l,
+    const RawMessage &fmt,
+    std::source_location loc = std::source_location::current()
+  ) {
+    return log(l, LogLevel::error(), fmt, loc);
+  }
+
+  export void critical(
+    const NamedLogger &l,
+    const RawMessage &fmt,
+    std::source_location loc = std::source_location::current()
+  ) {
+    return log(l, LogLevel::critical(), fmt, loc);
+  }
+
+  /*
+    log
+    logs to the root logger of registry(), such that the level croggerctl sets for root applies.
+    Records then go to root() unless registry() gave the root logger another sink.
+  */
+  export void log(
+    LogLevel status,
+    const RawMessage &fmt,
+    std::source_location loc = std::source_location::current()
+  ) {
+    return log(root_named, status, fmt, loc);
+  }
+
+  // Global shortcuts (using the root logger of registry())
   export void trace(
     const RawMessage &fmt, std::source_location loc = std::source_location::current()
   ) {
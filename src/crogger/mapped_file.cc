@@ -0,0 +1,107 @@
+module;
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <cstdint>
+#include <expected>
+#include <fcntl.h>
+#include <filesystem>
+#include <string_view>
+#include <unistd.h>
+#include <utility>
+export module jowi.crogger:mapped_file;
+import :error;
+
+namespace jowi::crogger {
+  namespace fs = std::filesystem;
+
+  /*
+    MappedFile
+    a read only memory mapping of a log file, used by the tools consuming crogger output.
+  */
+  export struct MappedFile {
+  private:
+    void *__addr;
+    uint64_t __map_size;
+    uint64_t __view_offset;
+    uint64_t __size;
+    fs::path __path;
+
+    MappedFile(
+      void *addr, uint64_t map_size, uint64_t view_offset, uint64_t size, fs::path p
+    ) noexcept :
+      __addr{addr}, __map_size{map_size}, __view_offset{view_offset}, __size{size},
+      __path{std::move(p)} {}
+
+  public:
+    MappedFile(MappedFile &&o) noexcept :
+      __addr{std::exchange(o.__addr, nullptr)}, __map_size{std::exchange(o.__map_size, 0)},
+      __view_offset{std::exchange(o.__view_offset, 0)}, __size{std::exchange(o.__size, 0)},
+      __path{std::move(o.__path)} {}
+    MappedFile &operator=(MappedFile &&o) noexcept {
+      std::swap(__addr, o.__addr);
+      std::swap(__map_size, o.__map_size);
+      std::swap(__view_offset, o.__view_offset);
+      std::swap(__size, o.__size);
+      std::swap(__path, o.__path);
+      return *this;
+    }
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+    ~MappedFile() {
+      if (__addr != nullptr) {
+        munmap(__addr, __map_size);
+      }
+    }
+
+    std::string_view view() const noexcept {
+      if (__addr == nullptr) {
+        return std::string_view{};
+      }
+      return std::string_view{static_cast<const char *>(__addr) + __view_offset, __size};
+    }
+    uint64_t size() const noexcept {
+      return __size;
+    }
+    const fs::path &path() const noexcept {
+      return __path;
+    }
+
+    /*
+      open
+      maps length bytes of the file starting at offset, the whole file by default. The range is
+      clamped to the size of the file.
+    */
+    static std::expected<MappedFile, LogError> open(
+      const fs::path &p, uint64_t offset = 0, uint64_t length = static_cast<uint64_t>(-1)
+    ) {
+      int fd = ::open(p.c_str(), O_RDONLY | O_CLOEXEC);
+      if (fd == -1) {
+        return std::unexpected{LogError::io_error("cannot open file {}", p.c_str())};
+      }
+      struct stat st;
+      if (fstat(fd, &st) != 0) {
+        ::close(fd);
+        return std::unexpected{LogError::io_error("cannot stat file {}", p.c_str())};
+      }
+      uint64_t file_size = static_cast<uint64_t>(st.st_size);
+      offset = std::min(offset, file_size);
+      uint64_t size = std::min(length, file_size - offset);
+      if (size == 0) {
+        ::close(fd);
+        return MappedFile{nullptr, 0, 0, 0, p};
+      }
+      uint64_t page_size = static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+      uint64_t map_offset = offset - offset % page_size;
+      uint64_t map_size = size + (offset - map_offset);
+      void *addr =
+        mmap(nullptr, map_size, PROT_READ, MAP_PRIVATE, fd, static_cast<off_t>(map_offset));
+      ::close(fd);
+      if (addr == MAP_FAILED) {
+        return std::unexpected{LogError::io_error("cannot map file {}", p.c_str())};
+      }
+      madvise(addr, map_size, MADV_SEQUENTIAL);
+      return MappedFile{addr, map_size, offset - map_offset, size, p};
+    }
+  };
+}
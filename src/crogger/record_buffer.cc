@@ -0,0 +1,169 @@
+module;
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <format>
+#include <iterator>
+#include <string_view>
+export module jowi.crogger:record_buffer;
+
+namespace jowi::crogger {
+  /*
+    RecordIterator
+    an output iterator over a fixed range of characters. Writes past the end of the range are
+    counted but discarded, this makes formatting into a bounded buffer never allocate. Given a
+    spill function, a full range is handed to it and reused instead, such that output of any length
+    can be consumed chunk by chunk.
+  */
+  export struct RecordIterator {
+    using iterator_category = std::output_iterator_tag;
+    using value_type = void;
+    using difference_type = std::ptrdiff_t;
+    using pointer = void;
+    using reference = void;
+
+    using SpillFunction = void (*)(void *, std::string_view) noexcept;
+
+  private:
+    char *__beg;
+    char *__cur;
+    char *__end;
+    uint64_t __dropped;
+    SpillFunction __spill;
+    void *__spill_arg;
+
+  public:
+    RecordIterator() noexcept :
+      __beg{nullptr}, __cur{nullptr}, __end{nullptr}, __dropped{0}, __spill{nullptr},
+      __spill_arg{nullptr} {}
+    RecordIterator(char *beg, char *end) noexcept :
+      __beg{beg}, __cur{beg}, __end{end}, __dropped{0}, __spill{nullptr}, __spill_arg{nullptr} {}
+    /*
+      RecordIterator
+      calls spill(arg, chunk) every time [beg, end) fills up, then writes from beg again. The bytes
+      written since the last spill stay in [begin(), position()). end must be past beg.
+    */
+    RecordIterator(char *beg, char *end, SpillFunction spill, void *arg) noexcept :
+      __beg{beg}, __cur{beg}, __end{end}, __dropped{0}, __spill{spill}, __spill_arg{arg} {}
+
+    // Iterator Satisfaction
+    RecordIterator &operator=(char c) noexcept {
+      if (__cur == __end && __spill != nullptr) {
+        __spill(__spill_arg, std::string_view{__beg, size()});
+        __cur = __beg;
+      }
+      if (__cur != __end) {
+        *__cur = c;
+        __cur += 1;
+      } else {
+        __dropped += 1;
+      }
+      return *this;
+    }
+    RecordIterator &operator*() noexcept {
+      return *this;
+    }
+    RecordIterator &operator++() noexcept {
+      return *this;
+    }
+    RecordIterator &operator++(int) noexcept {
+      return *this;
+    }
+
+    /*
+      Position Access
+    */
+    char *begin() const noexcept {
+      return __beg;
+    }
+    char *position() const noexcept {
+      return __cur;
+    }
+    char *end() const noexcept {
+      return __end;
+    }
+    uint64_t size() const noexcept {
+      return static_cast<uint64_t>(__cur - __beg);
+    }
+    uint64_t capacity() const noexcept {
+      return static_cast<uint64_t>(__end - __beg);
+    }
+    uint64_t dropped() const noexcept {
+      return __dropped;
+    }
+    bool truncated() const noexcept {
+      return __dropped != 0;
+    }
+  };
+
+  /*
+    RecordBuffer
+    inline storage for a single formatted record. The buffer lives wherever the object lives (the
+    stack in Logger::log), so rendering a record into it never touches the heap.
+  */
+  export template <uint64_t N> struct RecordBuffer {
+  private:
+    std::array<char, N> __buf;
+    uint64_t __size;
+
+  public:
+    RecordBuffer() noexcept : __size{0} {}
+
+    /*
+      writer
+      returns an iterator writing at most limit bytes into the buffer.
+    */
+    RecordIterator writer(uint64_t limit = N) noexcept {
+      __size = 0;
+      return RecordIterator{__buf.data(), __buf.data() + std::min(limit, N)};
+    }
+
+    /*
+      finish
+      commits the bytes written through it. When the record overflowed, the tail of the record is
+      replaced with a marker stating how many bytes were removed in total, the ones dropped by the
+      writer and the ones the marker covers. The record is then terminated with a newline so that
+      the output stays line oriented.
+    */
+    std::string_view finish(const RecordIterator &it) noexcept {
+      __size = it.size();
+      if (!it.truncated()) {
+        return view();
+      }
+      std::array<char, 48> marker;
+      char *marker_end = marker.begin();
+      uint64_t marker_size = 0;
+      uint64_t kept = __size;
+      // the marker covers more of the record as its count gains digits, until the count settles
+      for (uint64_t removed = it.dropped();;) {
+        marker_end =
+          std::format_to_n(marker.begin(), marker.size() - 1, "...[{} bytes truncated]", removed)
+            .out;
+        *marker_end = '\n';
+        marker_size =
+          std::min(static_cast<uint64_t>(marker_end - marker.begin()) + 1, it.capacity());
+        kept = std::min(it.size(), it.capacity() - marker_size);
+        uint64_t total = it.dropped() + (it.size() - kept);
+        if (total == removed) {
+          break;
+        }
+        removed = total;
+      }
+      __size = kept;
+      std::copy_n(marker_end + 1 - marker_size, marker_size, __buf.data() + __size);
+      __size += marker_size;
+      return view();
+    }
+
+    std::string_view view() const noexcept {
+      return std::string_view{__buf.data(), __size};
+    }
+    uint64_t size() const noexcept {
+      return __size;
+    }
+    static constexpr uint64_t capacity() noexcept {
+      return N;
+    }
+  };
+}
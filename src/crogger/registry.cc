@@ -0,0 +1,264 @@
+module;
+#include <atomic>
+#include <cstdint>
+#include <expected>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+export module jowi.crogger:registry;
+import :control;
+import :error;
+import :log_context;
+import :logger;
+
+namespace jowi::crogger {
+  /*
+    LoggerNode
+    one named logger. level and sink are the explicit configuration, guarded by the registry
+    mutex. control_level points into the attached ControlBlock, where croggerctl may override the
+    level. The cached_* fields hold the resolved configuration for cached_generation and are read
+    without the lock.
+  */
+  struct LoggerNode {
+    std::string name;
+    LoggerNode *parent;
+    std::optional<unsigned int> level;
+    std::shared_ptr<Logger> sink;
+    uint32_t *control_level;
+    std::atomic<uint64_t> cached_generation;
+    std::atomic<unsigned int> cached_level;
+    std::atomic<const Logger *> cached_sink;
+
+    LoggerNode(std::string n, LoggerNode *p) :
+      name{std::move(n)}, parent{p}, level{std::nullopt}, sink{nullptr}, control_level{nullptr},
+      cached_generation{0}, cached_level{0}, cached_sink{nullptr} {}
+
+    std::optional<unsigned int> effective_level() const noexcept {
+      if (control_level != nullptr) {
+        uint32_t v = std::atomic_ref<uint32_t>{*control_level}.load(std::memory_order_relaxed);
+        if (v != ControlBlock::no_level) {
+          return v;
+        }
+      }
+      return level;
+    }
+  };
+
+  struct NameHash {
+    using is_transparent = void;
+    size_t operator()(std::string_view v) const noexcept {
+      return std::hash<std::string_view>{}(v);
+    }
+  };
+
+  struct RegistryState {
+    std::mutex mut;
+    std::atomic<uint64_t> generation;
+    std::unordered_map<std::string, std::unique_ptr<LoggerNode>, NameHash, std::equal_to<>> nodes;
+    // every sink ever set, such that a sink replaced while a record is being written stays alive.
+    std::vector<std::shared_ptr<Logger>> sinks;
+    LoggerNode root;
+    const Logger *root_sink;
+    std::unique_ptr<ControlBlock> control_block;
+    std::atomic<const ControlBlock *> control;
+
+    RegistryState(const Logger &sink) : generation{1}, root{"", nullptr}, root_sink{&sink},
+      control_block{nullptr}, control{nullptr} {
+      root.level = 0;
+    }
+
+    // requires mut
+    LoggerNode &node(std::string_view name) {
+      if (name.empty()) {
+        return root;
+      }
+      auto it = nodes.find(name);
+      if (it != nodes.end()) {
+        return *it->second;
+      }
+      auto dot = name.rfind('.');
+      auto &parent = node(dot == std::string_view::npos ? std::string_view{} : name.substr(0, dot));
+      auto child = std::make_unique<LoggerNode>(std::string{name}, &parent);
+      if (control_block) {
+        child->control_level = control_block->logger_level(name).value_or(nullptr);
+      }
+      auto &ref = *child;
+      nodes.emplace(std::string{name}, std::move(child));
+      return ref;
+    }
+
+    void invalidate() noexcept {
+      generation.fetch_add(1, std::memory_order_release);
+    }
+
+    /*
+      current_generation
+      the local generation plus the generation of the control file, both only grow.
+    */
+    uint64_t current_generation() const noexcept {
+      auto *c = control.load(std::memory_order_acquire);
+      return generation.load(std::memory_order_acquire) + (c == nullptr ? 0 : c->generation());
+    }
+
+    void resolve(LoggerNode &n) {
+      std::lock_guard lock{mut};
+      uint64_t gen = current_generation();
+      if (n.cached_generation.load(std::memory_order_relaxed) == gen) {
+        return;
+      }
+      std::optional<unsigned int> level;
+      const Logger *sink = nullptr;
+      for (auto *p = &n; p != nullptr && (!level || sink == nullptr); p = p->parent) {
+        if (!level) level = p->effective_level();
+        if (sink == nullptr) sink = p->sink.get();
+      }
+      n.cached_level.store(level.value_or(0), std::memory_order_relaxed);
+      n.cached_sink.store(sink == nullptr ? root_sink : sink, std::memory_order_relaxed);
+      n.cached_generation.store(gen, std::memory_order_release);
+    }
+  };
+
+  /*
+    NamedLogger
+    a handle to a logger of a LoggerRegistry, cheap to copy and valid as long as the registry.
+    The effective level and sink are those of the closest ancestor (split on '.') that sets them.
+    They are cached per logger, the per record check is two atomic loads and a compare unless the
+    configuration changed since the last record.
+  */
+  export struct NamedLogger {
+  private:
+    RegistryState *__state;
+    LoggerNode *__node;
+
+    void __refresh() const {
+      if (__node->cached_generation.load(std::memory_order_acquire) !=
+          __state->current_generation()) {
+        __state->resolve(*__node);
+      }
+    }
+
+  public:
+    NamedLogger(RegistryState *state, LoggerNode *node) noexcept : __state{state}, __node{node} {}
+
+    std::string_view name() const noexcept {
+      return __node->name;
+    }
+    unsigned int effective_level() const {
+      __refresh();
+      return __node->cached_level.load(std::memory_order_relaxed);
+    }
+    bool enabled(unsigned int level) const {
+      return level >= effective_level();
+    }
+    const Logger &sink() const {
+      __refresh();
+      return *__node->cached_sink.load(std::memory_order_relaxed);
+    }
+
+    void log(const LogContext &ctx) const {
+      if (enabled(ctx.status.level)) {
+        sink().log(ctx);
+      }
+    }
+  };
+
+  /*
+    LoggerRegistry
+    creates named loggers on demand and holds their configuration. Every change bumps a generation
+    counter which lazily invalidates the cached configuration of every logger.
+  */
+  export struct LoggerRegistry {
+  private:
+    std::unique_ptr<RegistryState> __state;
+
+  public:
+    LoggerRegistry(const Logger &root_sink) :
+      __state{std::make_unique<RegistryState>(root_sink)} {}
+
+    NamedLogger get(std::string_view name) {
+      std::lock_guard lock{__state->mut};
+      return NamedLogger{__state.get(), &__state->node(name)};
+    }
+
+    LoggerRegistry &set_level(std::string_view name, unsigned int level) {
+      std::lock_guard lock{__state->mut};
+      __state->node(name).level = level;
+      __state->invalidate();
+      return *this;
+    }
+    /*
+      unset_level
+      makes name inherit the level of its parent again. The root logger always keeps a level.
+    */
+    LoggerRegistry &unset_level(std::string_view name) {
+      std::lock_guard lock{__state->mut};
+      if (!name.empty()) {
+        __state->node(name).level.reset();
+        __state->invalidate();
+      }
+      return *this;
+    }
+
+    LoggerRegistry &set_sink(std::string_view name, Logger &&sink) {
+      auto ptr = std::make_shared<Logger>(std::move(sink));
+      std::lock_guard lock{__state->mut};
+      __state->sinks.emplace_back(ptr);
+      __state->node(name).sink = std::move(ptr);
+      __state->invalidate();
+      return *this;
+    }
+    /*
+      unset_sink
+      makes name write to the sink of its parent again, or to the root sink for the root logger.
+    */
+    LoggerRegistry &unset_sink(std::string_view name) {
+      std::lock_guard lock{__state->mut};
+      __state->node(name).sink.reset();
+      __state->invalidate();
+      return *this;
+    }
+
+    /*
+      attach_control
+      lets croggerctl override the level of the loggers of this registry through block. Claims a
+      slot for every logger, the root logger is called "".
+    */
+    std::expected<void, LogError> attach_control(ControlBlock &&block) {
+      std::lock_guard lock{__state->mut};
+      if (__state->control_block) {
+        return std::unexpected{LogError::io_error("a control block is already attached")};
+      }
+      auto ctl = std::make_unique<ControlBlock>(std::move(block));
+      auto root_level = ctl->logger_level("");
+      if (!root_level) {
+        return std::unexpected{root_level.error()};
+      }
+      __state->root.control_level = root_level.value();
+      for (auto &[name, node] : __state->nodes) {
+        node->control_level = ctl->logger_level(name).value_or(nullptr);
+      }
+      __state->control_block = std::move(ctl);
+      __state->control.store(__state->control_block.get(), std::memory_order_release);
+      __state->invalidate();
+      return {};
+    }
+    ControlBlock *control() noexcept {
+      return __state->control_block.get();
+    }
+
+    std::vector<std::string> names() const {
+      std::lock_guard lock{__state->mut};
+      std::vector<std::string> names;
+      names.reserve(__state->nodes.size());
+      for (const auto &[name, node] : __state->nodes) {
+        names.emplace_back(name);
+      }
+      return names;
+    }
+  };
+}
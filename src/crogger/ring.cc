@@ -0,0 +1,220 @@
+module;
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <expected>
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unistd.h>
+#include <utility>
+export module jowi.crogger:ring;
+import :emitter;
+import :error;
+import :shared_file;
+
+namespace jowi::crogger {
+  namespace fs = std::filesystem;
+
+  constexpr uint32_t ring_magic = 0x52475243; // CRGR
+  constexpr uint32_t ring_version = 1;
+
+  struct RingHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t slot_count;
+    uint32_t slot_size;
+    uint64_t head;
+    uint64_t pid;
+    char padding[32];
+  };
+  static_assert(sizeof(RingHeader) == 64);
+
+  /*
+    RingSlot
+    the head of every slot, the record bytes follow. seq is 2 * ticket + 1 while the record of
+    ticket is written and 2 * ticket + 2 once it is complete.
+  */
+  struct RingSlot {
+    uint64_t seq;
+    uint32_t size;
+    uint32_t reserved;
+  };
+
+  struct RingLayout {
+    SharedFile file;
+
+    RingHeader &header() const noexcept {
+      return *reinterpret_cast<RingHeader *>(file.data());
+    }
+    RingSlot &slot(uint64_t ticket) const noexcept {
+      auto &h = header();
+      uint64_t index = ticket & (h.slot_count - 1);
+      auto *p = file.data() + sizeof(RingHeader) + index * h.slot_size;
+      return *reinterpret_cast<RingSlot *>(p);
+    }
+    char *payload(RingSlot &s) const noexcept {
+      return reinterpret_cast<char *>(&s) + sizeof(RingSlot);
+    }
+    uint64_t head() const noexcept {
+      return std::atomic_ref<uint64_t>{header().head}.load(std::memory_order_acquire);
+    }
+  };
+
+  /*
+    RingEmitter
+    writes records into a ring of fixed size slots in a shared memory file, read by another
+    process with RingReader or crogger_ring. A producer claims a slot with a single fetch_add and
+    then owns it, as long as producers do not lap each other while writing one record. Producers
+    never wait for the reader, a reader falling behind loses the oldest records instead. Records
+    longer than a slot are truncated. The file is kept when the emitter is destroyed, such that
+    the last records survive the process.
+  */
+  export struct RingEmitter {
+  private:
+    std::unique_ptr<RingLayout> __ring;
+
+    RingEmitter(std::unique_ptr<RingLayout> ring) : __ring{std::move(ring)} {}
+
+  public:
+    std::expected<void, LogError> emit(std::string_view d) const noexcept {
+      auto &h = __ring->header();
+      uint64_t ticket = std::atomic_ref<uint64_t>{h.head}.fetch_add(1, std::memory_order_relaxed);
+      auto &slot = __ring->slot(ticket);
+      std::atomic_ref<uint64_t> seq{slot.seq};
+      seq.store(2 * ticket + 1, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_release);
+      uint64_t size = std::min<uint64_t>(d.size(), h.slot_size - sizeof(RingSlot));
+      std::memcpy(__ring->payload(slot), d.data(), size);
+      std::atomic_ref<uint32_t>{slot.size}.store(
+        static_cast<uint32_t>(size), std::memory_order_relaxed
+      );
+      seq.store(2 * ticket + 2, std::memory_order_release);
+      return {};
+    }
+
+    const fs::path &path() const noexcept {
+      return __ring->file.path();
+    }
+
+    /*
+      create
+      creates the ring at p with slot_count (rounded up to a power of two) slots of slot_size
+      bytes, the slot head included.
+    */
+    static std::expected<RingEmitter, LogError> create(
+      const fs::path &p, uint32_t slot_count = 4096, uint32_t slot_size = 512
+    ) {
+      slot_count = std::bit_ceil(std::max<uint32_t>(slot_count, 2));
+      slot_size = std::max<uint32_t>((slot_size + 7) / 8 * 8, sizeof(RingSlot) + 8);
+      uint64_t size = sizeof(RingHeader) + uint64_t{slot_count} * slot_size;
+      return SharedFile::create(p, size, false).transform([&](SharedFile &&file) {
+        auto ring = std::make_unique<RingLayout>(std::move(file));
+        auto &h = ring->header();
+        h.version = ring_version;
+        h.slot_count = slot_count;
+        h.slot_size = slot_size;
+        h.head = 0;
+        h.pid = static_cast<uint64_t>(getpid());
+        std::atomic_ref<uint32_t>{h.magic}.store(ring_magic, std::memory_order_release);
+        return RingEmitter{std::move(ring)};
+      });
+    }
+  };
+
+  /*
+    RingReader
+    consumes the records of a ring from another process. Starts at the oldest record still in the
+    ring and counts the records overwritten before they could be read.
+  */
+  export struct RingReader {
+  private:
+    std::unique_ptr<RingLayout> __ring;
+    uint64_t __next;
+    uint64_t __lost;
+    std::string __buf;
+
+    RingReader(std::unique_ptr<RingLayout> ring, uint64_t next) :
+      __ring{std::move(ring)}, __next{next}, __lost{0}, __buf{} {}
+
+  public:
+    uint64_t lost() const noexcept {
+      return __lost;
+    }
+    uint64_t producer_pid() const noexcept {
+      return __ring->header().pid;
+    }
+
+    /*
+      next
+      copies the next record out of the ring, std::nullopt when the producers have not written it
+      yet. The view is valid until the next call.
+    */
+    std::optional<std::string_view> next() {
+      auto &h = __ring->header();
+      while (true) {
+        uint64_t head = __ring->head();
+        if (__next >= head) {
+          return std::nullopt;
+        }
+        if (head - __next > h.slot_count) {
+          __lost += head - __next - h.slot_count;
+          __next = head - h.slot_count;
+        }
+        auto &slot = __ring->slot(__next);
+        std::atomic_ref<uint64_t> seq{slot.seq};
+        uint64_t expected = 2 * __next + 2;
+        uint64_t before = seq.load(std::memory_order_acquire);
+        if (before < expected) {
+          // claimed but still being written, skipped once the producer is half a lap behind, as
+          // it most likely died while writing
+          if (head - __next < h.slot_count / 2) {
+            return std::nullopt;
+          }
+          __lost += 1;
+          __next += 1;
+          continue;
+        }
+        if (before == expected) {
+          uint32_t size = std::atomic_ref<uint32_t>{slot.size}.load(std::memory_order_relaxed);
+          __buf.assign(__ring->payload(slot), size);
+          std::atomic_thread_fence(std::memory_order_acquire);
+          if (seq.load(std::memory_order_relaxed) == expected) {
+            __next += 1;
+            return std::string_view{__buf};
+          }
+        }
+        // overwritten by a producer one lap ahead
+        __lost += 1;
+        __next += 1;
+      }
+    }
+
+    static std::expected<RingReader, LogError> open(const fs::path &p) {
+      return SharedFile::open(p).and_then(
+        [&](SharedFile &&file) -> std::expected<RingReader, LogError> {
+          uint64_t size = file.size();
+          auto ring = std::make_unique<RingLayout>(std::move(file));
+          if (size < sizeof(RingHeader)) {
+            return std::unexpected{LogError::io_error("{} is not a ring", p.c_str())};
+          }
+          auto &h = ring->header();
+          if (std::atomic_ref<uint32_t>{h.magic}.load(std::memory_order_acquire) != ring_magic ||
+              h.version != ring_version || !std::has_single_bit(h.slot_count) ||
+              sizeof(RingHeader) + uint64_t{h.slot_count} * h.slot_size > size) {
+            return std::unexpected{LogError::io_error("{} is not a ring", p.c_str())};
+          }
+          uint64_t head = ring->head();
+          uint64_t first = head > h.slot_count ? head - h.slot_count : 0;
+          return RingReader{std::move(ring), first};
+        }
+      );
+    }
+  };
+
+  template struct Emitter<RingEmitter>;
+}
@@ -0,0 +1,239 @@
+module;
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+#if defined(__x86_64__) || defined(__i386__)
+  #include <immintrin.h>
+#endif
+export module jowi.crogger:scan;
+
+namespace jowi::crogger {
+  uint64_t find_scalar(std::string_view data, std::string_view needle, uint64_t from) noexcept {
+    auto pos = data.find(needle, from);
+    return pos == std::string_view::npos ? data.size() : pos;
+  }
+
+#if defined(__x86_64__) || defined(__i386__)
+  /*
+    The vector kernels compare the first and the last byte of the needle against a whole register
+    of candidate positions, only positions where both match are verified with memcmp. The needle
+    is at least two bytes long.
+  */
+  __attribute__((target("sse2"))) uint64_t find_sse2(
+    std::string_view data, std::string_view needle, uint64_t from
+  ) noexcept {
+    const char *p = data.data();
+    uint64_t size = data.size();
+    uint64_t k = needle.size();
+    const __m128i first = _mm_set1_epi8(needle[0]);
+    const __m128i last = _mm_set1_epi8(needle[k - 1]);
+    uint64_t i = from;
+    for (; i + k - 1 + 16 <= size; i += 16) {
+      __m128i block_first = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + i));
+      __m128i block_last = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + i + k - 1));
+      uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(
+        _mm_and_si128(_mm_cmpeq_epi8(block_first, first), _mm_cmpeq_epi8(block_last, last))
+      ));
+      while (mask != 0) {
+        uint64_t bit = static_cast<uint64_t>(__builtin_ctz(mask));
+        if (std::memcmp(p + i + bit + 1, needle.data() + 1, k - 2) == 0) {
+          return i + bit;
+        }
+        mask &= mask - 1;
+      }
+    }
+    return find_scalar(data, needle, i);
+  }
+
+  __attribute__((target("avx2"))) uint64_t find_avx2(
+    std::string_view data, std::string_view needle, uint64_t from
+  ) noexcept {
+    const char *p = data.data();
+    uint64_t size = data.size();
+    uint64_t k = needle.size();
+    const __m256i first = _mm256_set1_epi8(needle[0]);
+    const __m256i last = _mm256_set1_epi8(needle[k - 1]);
+    uint64_t i = from;
+    for (; i + k - 1 + 32 <= size; i += 32) {
+      __m256i block_first = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p + i));
+      __m256i block_last = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p + i + k - 1));
+      uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(
+        _mm256_and_si256(
+          _mm256_cmpeq_epi8(block_first, first), _mm256_cmpeq_epi8(block_last, last)
+        )
+      ));
+      while (mask != 0) {
+        uint64_t bit = static_cast<uint64_t>(__builtin_ctz(mask));
+        if (std::memcmp(p + i + bit + 1, needle.data() + 1, k - 2) == 0) {
+          return i + bit;
+        }
+        mask &= mask - 1;
+      }
+    }
+    return find_sse2(data, needle, i);
+  }
+#endif
+
+  /*
+    find_in
+    returns the position of the first needle in data at or after from, data.size() when there is
+    none. Uses AVX2 or SSE2 when the CPU has them and falls back to a scalar search otherwise.
+  */
+  export uint64_t find_in(
+    std::string_view data, std::string_view needle, uint64_t from = 0
+  ) noexcept {
+    if (from > data.size() || needle.size() > data.size() - from) {
+      return data.size();
+    }
+    if (needle.empty()) {
+      return from;
+    }
+    if (needle.size() == 1) {
+      auto p = std::memchr(data.data() + from, needle[0], data.size() - from);
+      if (p == nullptr) return data.size();
+      return static_cast<uint64_t>(static_cast<const char *>(p) - data.data());
+    }
+#if defined(__x86_64__) || defined(__i386__)
+    static const bool has_avx2 = __builtin_cpu_supports("avx2");
+    static const bool has_sse2 = __builtin_cpu_supports("sse2");
+    if (has_avx2) return find_avx2(data, needle, from);
+    if (has_sse2) return find_sse2(data, needle, from);
+#endif
+    return find_scalar(data, needle, from);
+  }
+
+  uint64_t line_start_scalar(std::string_view data, uint64_t pos) noexcept {
+    while (pos != 0 && data[pos - 1] != '\n') {
+      pos -= 1;
+    }
+    return pos;
+  }
+
+  /*
+    The tag is looked for in a single register: a level name or number is far shorter than
+    level_tag_width, anything longer is not a level tag.
+  */
+  constexpr uint64_t level_tag_width = 16;
+
+  uint64_t tag_close_scalar(std::string_view data, uint64_t beg) noexcept {
+    auto field = data.substr(beg, level_tag_width);
+    auto close = field.find_first_of("]\n");
+    if (close == std::string_view::npos || field[close] != ']') {
+      return data.size();
+    }
+    return beg + close;
+  }
+
+#if defined(__x86_64__) || defined(__i386__)
+  /*
+    The backward kernels look at the register ending right before pos, the last newline in it
+    being the highest bit of the mask.
+  */
+  __attribute__((target("sse2"))) uint64_t line_start_sse2(
+    std::string_view data, uint64_t pos
+  ) noexcept {
+    const __m128i nl = _mm_set1_epi8('\n');
+    for (; pos >= 16; pos -= 16) {
+      __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data.data() + pos - 16));
+      uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(block, nl)));
+      if (mask != 0) {
+        return pos - 16 + static_cast<uint64_t>(32 - __builtin_clz(mask));
+      }
+    }
+    return line_start_scalar(data, pos);
+  }
+
+  __attribute__((target("avx2"))) uint64_t line_start_avx2(
+    std::string_view data, uint64_t pos
+  ) noexcept {
+    const __m256i nl = _mm256_set1_epi8('\n');
+    for (; pos >= 32; pos -= 32) {
+      __m256i block =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data.data() + pos - 32));
+      uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(block, nl)));
+      if (mask != 0) {
+        return pos - 32 + static_cast<uint64_t>(32 - __builtin_clz(mask));
+      }
+    }
+    return line_start_sse2(data, pos);
+  }
+
+  // the first ']' of the field is the end of the tag, unless a newline comes first
+  __attribute__((target("sse2"))) uint64_t tag_close_sse2(
+    std::string_view data, uint64_t beg
+  ) noexcept {
+    if (data.size() - beg < level_tag_width) {
+      return tag_close_scalar(data, beg);
+    }
+    __m128i field = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data.data() + beg));
+    uint32_t close = static_cast<uint32_t>(
+      _mm_movemask_epi8(_mm_cmpeq_epi8(field, _mm_set1_epi8(']')))
+    );
+    uint32_t nl = static_cast<uint32_t>(
+      _mm_movemask_epi8(_mm_cmpeq_epi8(field, _mm_set1_epi8('\n')))
+    );
+    if (close == 0 || (nl != 0 && __builtin_ctz(nl) < __builtin_ctz(close))) {
+      return data.size();
+    }
+    return beg + static_cast<uint64_t>(__builtin_ctz(close));
+  }
+#endif
+
+  /*
+    line_start
+    returns the position right after the last newline before pos, 0 when there is none.
+  */
+  export uint64_t line_start(std::string_view data, uint64_t pos) noexcept {
+    if (pos > data.size()) {
+      pos = data.size();
+    }
+#if defined(__x86_64__) || defined(__i386__)
+    static const bool has_avx2 = __builtin_cpu_supports("avx2");
+    static const bool has_sse2 = __builtin_cpu_supports("sse2");
+    if (has_avx2) return line_start_avx2(data, pos);
+    if (has_sse2) return line_start_sse2(data, pos);
+#endif
+    return line_start_scalar(data, pos);
+  }
+
+  /*
+    level_tag_at
+    returns the level of the record starting at beg: the text of its leading [LEVEL] tag, once
+    the escape codes of ColorfulFormatter are skipped. Empty when the line has no such tag. Only
+    the tag is looked at, the rest of the head (e.g. the time) is left unparsed.
+  */
+  export std::string_view level_tag_at(std::string_view data, uint64_t beg) noexcept {
+    while (data.substr(beg).starts_with("\x1b[")) {
+      auto end = data.find('m', beg);
+      if (end == std::string_view::npos) return {};
+      beg = end + 1;
+    }
+    if (beg >= data.size() || data[beg] != '[') {
+      return {};
+    }
+    beg += 1;
+    uint64_t close;
+#if defined(__x86_64__) || defined(__i386__)
+    static const bool has_sse2 = __builtin_cpu_supports("sse2");
+    close = has_sse2 ? tag_close_sse2(data, beg) : tag_close_scalar(data, beg);
+#else
+    close = tag_close_scalar(data, beg);
+#endif
+    if (close == data.size()) {
+      return {};
+    }
+    return data.substr(beg, close - beg);
+  }
+
+  /*
+    line_at
+    returns the line (including its newline) containing position pos.
+  */
+  export std::string_view line_at(std::string_view data, uint64_t pos) noexcept {
+    uint64_t beg = line_start(data, pos);
+    auto end = data.find('\n', pos);
+    end = end == std::string_view::npos ? data.size() : end + 1;
+    return data.substr(beg, end - beg);
+  }
+
+}
@@ -0,0 +1,309 @@
+module;
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <expected>
+#include <filesystem>
+#include <format>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <queue>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <unistd.h>
+#include <vector>
+export module jowi.crogger:shard;
+import :emitter;
+import :error;
+import :log_context;
+import :mapped_file;
+
+namespace jowi::crogger {
+  namespace fs = std::filesystem;
+
+  /*
+    ShardHeader
+    prefix of every record in a shard file. The formatted bytes are framed with the record time and
+    a sequence number that is monotonic within the shard, such that shards can be merged by time.
+  */
+  export struct ShardHeader {
+    uint32_t magic;
+    uint32_t size;
+    int64_t time;
+    uint64_t seq;
+    uint32_t level;
+    uint32_t reserved;
+
+    static constexpr uint32_t shard_magic = 0x53475243;
+  };
+
+  export struct ShardRecord {
+    std::chrono::sys_time<std::chrono::nanoseconds> time;
+    uint64_t seq;
+    unsigned int level;
+    std::string_view data;
+  };
+
+  /*
+    ShardFile
+    the shard of one thread. It is closed by whichever comes first: the thread exiting or the
+    emitter that opened it being destroyed. Only the owning thread writes to it.
+  */
+  struct ShardFile {
+    std::mutex m;
+    std::unique_ptr<FILE, FileCloser> f;
+    std::atomic<bool> closed;
+    uint64_t seq;
+
+    ShardFile(FILE *f) : m{}, f{f, FileCloser{}}, closed{false}, seq{0} {}
+
+    void close() {
+      std::scoped_lock lock{m};
+      if (!closed.exchange(true, std::memory_order_release)) {
+        f.reset();
+      }
+    }
+  };
+
+  /*
+    ShardSet
+    the state shared by the copies of a ShardedFileEmitter, files registering every shard opened
+    through it such that the last copy going away flushes and closes them.
+  */
+  struct ShardSet {
+    fs::path dir;
+    std::string stem;
+    uint64_t id;
+    std::atomic<uint32_t> next_shard;
+    std::mutex m;
+    std::vector<std::shared_ptr<ShardFile>> files;
+
+    ShardSet(fs::path dir, std::string stem, uint64_t id) :
+      dir{std::move(dir)}, stem{std::move(stem)}, id{id}, next_shard{0}, m{}, files{} {}
+    ShardSet(const ShardSet &) = delete;
+    ShardSet &operator=(const ShardSet &) = delete;
+    ~ShardSet() {
+      for (auto &file : files) {
+        file->close();
+      }
+    }
+
+    void add(std::shared_ptr<ShardFile> file) {
+      std::scoped_lock lock{m};
+      std::erase_if(files, [](const auto &f) {
+        return f->closed.load(std::memory_order_acquire);
+      });
+      files.emplace_back(std::move(file));
+    }
+  };
+
+  struct ThreadShard {
+    uint64_t set_id;
+    std::shared_ptr<ShardFile> file;
+
+    ThreadShard(uint64_t set_id, std::shared_ptr<ShardFile> file) :
+      set_id{set_id}, file{std::move(file)} {}
+    ThreadShard(ThreadShard &&) = default;
+    ThreadShard &operator=(ThreadShard &&) = default;
+    ~ThreadShard() {
+      if (file) {
+        file->close();
+      }
+    }
+  };
+
+  std::atomic<uint64_t> shard_set_counter{0};
+  thread_local std::vector<ThreadShard> thread_shards{};
+
+  /*
+    ShardedFileEmitter
+    every thread writing through this emitter lazily opens its own shard file
+    ({dir}/{stem}.{pid}.{shard}.shard) and writes to it without any shared lock. Shared state is
+    only touched when a thread writes for the first time, registering its shard with the emitter.
+    A shard is flushed and closed when its thread exits or when the last copy of the emitter is
+    destroyed, whichever comes first; flush() flushes the shard of the calling thread.
+  */
+  export struct ShardedFileEmitter {
+  private:
+    std::shared_ptr<ShardSet> __set;
+
+    ShardedFileEmitter(std::shared_ptr<ShardSet> set) : __set{std::move(set)} {}
+
+    std::expected<std::reference_wrapper<ShardFile>, LogError> __thread_shard() const {
+      // the shards of emitters destroyed meanwhile are closed already
+      std::erase_if(thread_shards, [](const ThreadShard &shard) {
+        return shard.file->closed.load(std::memory_order_acquire);
+      });
+      for (auto &shard : thread_shards) {
+        if (shard.set_id == __set->id) {
+          return std::ref(*shard.file);
+        }
+      }
+      auto shard_id = __set->next_shard.fetch_add(1, std::memory_order_relaxed);
+      auto p = __set->dir / std::format("{}.{}.{}.shard", __set->stem, getpid(), shard_id);
+      FILE *f = fopen(p.c_str(), "w");
+      if (f == nullptr) {
+        return std::unexpected{LogError::io_error("cannot open shard {}", p.c_str())};
+      }
+      auto file = std::make_shared<ShardFile>(f);
+      __set->add(file);
+      return std::ref(*thread_shards.emplace_back(__set->id, std::move(file)).file);
+    }
+
+    std::expected<void, LogError> __write(
+      std::chrono::system_clock::time_point t, unsigned int level, std::string_view d
+    ) const {
+      auto shard_res = __thread_shard();
+      if (!shard_res) {
+        return std::unexpected{std::move(shard_res.error())};
+      }
+      auto &shard = shard_res.value().get();
+      shard.seq += 1;
+      ShardHeader header{
+        ShardHeader::shard_magic,
+        static_cast<uint32_t>(d.length()),
+        std::chrono::duration_cast<std::chrono::nanoseconds>(t.time_since_epoch()).count(),
+        shard.seq,
+        level,
+        0
+      };
+      if (fwrite(&header, sizeof(ShardHeader), 1, shard.f.get()) != 1 ||
+          fwrite(d.data(), sizeof(char), d.length(), shard.f.get()) != d.length()) {
+        return std::unexpected{LogError::io_error("cannot write shard of {}", __set->stem)};
+      }
+      return {};
+    }
+
+  public:
+    std::expected<void, LogError> emit(std::string_view d) const {
+      return __write(std::chrono::system_clock::now(), 0, d);
+    }
+    std::expected<void, LogError> emit(const LogContext &ctx, std::string_view d) const {
+      return __write(ctx.time, ctx.status.level, d);
+    }
+
+    /*
+      flush
+      flushes the shard of the calling thread.
+    */
+    std::expected<void, LogError> flush() const {
+      return __thread_shard().and_then([&](ShardFile &shard) -> std::expected<void, LogError> {
+        if (fflush(shard.f.get()) != 0) {
+          return std::unexpected{LogError::io_error("cannot flush shard of {}", __set->stem)};
+        }
+        return {};
+      });
+    }
+
+    const fs::path &dir() const noexcept {
+      return __set->dir;
+    }
+
+    static std::expected<ShardedFileEmitter, LogError> open(const fs::path &dir, std::string stem) {
+      std::error_code ec;
+      fs::create_directories(dir, ec);
+      if (ec) {
+        return std::unexpected{LogError::io_error("cannot create directory {}", dir.c_str())};
+      }
+      auto set = std::make_shared<ShardSet>(
+        dir, std::move(stem), shard_set_counter.fetch_add(1, std::memory_order_relaxed)
+      );
+      return ShardedFileEmitter{std::move(set)};
+    }
+  };
+
+  /*
+    ShardReader
+    iterates the records of a mapped shard file. A partially written record at the end of the file
+    (e.g. the process crashed mid write) ends the iteration.
+  */
+  export struct ShardReader {
+  private:
+    MappedFile __file;
+    uint64_t __offset;
+
+    ShardReader(MappedFile file) : __file{std::move(file)}, __offset{0} {}
+
+  public:
+    std::optional<ShardRecord> next() noexcept {
+      auto data = __file.view();
+      if (data.size() - __offset < sizeof(ShardHeader)) {
+        return std::nullopt;
+      }
+      ShardHeader header;
+      std::memcpy(&header, data.data() + __offset, sizeof(ShardHeader));
+      if (header.magic != ShardHeader::shard_magic ||
+          data.size() - __offset - sizeof(ShardHeader) < header.size) {
+        return std::nullopt;
+      }
+      auto record = ShardRecord{
+        std::chrono::sys_time<std::chrono::nanoseconds>{std::chrono::nanoseconds{header.time}},
+        header.seq,
+        header.level,
+        data.substr(__offset + sizeof(ShardHeader), header.size)
+      };
+      __offset += sizeof(ShardHeader) + header.size;
+      return record;
+    }
+
+    const fs::path &path() const noexcept {
+      return __file.path();
+    }
+
+    static std::expected<ShardReader, LogError> open(const fs::path &p) {
+      return MappedFile::open(p).transform([](MappedFile &&f) {
+        return ShardReader{std::move(f)};
+      });
+    }
+  };
+
+  /*
+    ShardMerge
+    the records of several shards in time order. Records of the same time come in the order of
+    the shards given, then by sequence number.
+  */
+  export struct ShardMerge {
+  private:
+    struct Cursor {
+      ShardRecord record;
+      uint64_t shard_id;
+
+      friend bool operator>(const Cursor &l, const Cursor &r) {
+        if (l.record.time != r.record.time) return l.record.time > r.record.time;
+        if (l.shard_id != r.shard_id) return l.shard_id > r.shard_id;
+        return l.record.seq > r.record.seq;
+      }
+    };
+
+    std::vector<ShardReader> __readers;
+    std::priority_queue<Cursor, std::vector<Cursor>, std::greater<Cursor>> __heap;
+
+  public:
+    ShardMerge(std::vector<ShardReader> readers) : __readers{std::move(readers)}, __heap{} {
+      for (uint64_t i = 0; i != __readers.size(); i += 1) {
+        if (auto record = __readers[i].next()) {
+          __heap.push(Cursor{record.value(), i});
+        }
+      }
+    }
+
+    std::optional<ShardRecord> next() {
+      if (__heap.empty()) {
+        return std::nullopt;
+      }
+      auto cur = __heap.top();
+      __heap.pop();
+      if (auto record = __readers[cur.shard_id].next()) {
+        __heap.push(Cursor{record.value(), cur.shard_id});
+      }
+      return cur.record;
+    }
+  };
+
+  template struct Emitter<ShardedFileEmitter>;
+}
@@ -0,0 +1,108 @@
+module;
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <cstdint>
+#include <expected>
+#include <fcntl.h>
+#include <filesystem>
+#include <unistd.h>
+#include <utility>
+export module jowi.crogger:shared_file;
+import :error;
+
+namespace jowi::crogger {
+  namespace fs = std::filesystem;
+
+  /*
+    SharedFile
+    a read write MAP_SHARED mapping of a whole file, the backing of the structures crogger shares
+    with other processes (ControlBlock, the record ring). A created file can be removed again when
+    the mapping is destroyed.
+  */
+  export struct SharedFile {
+  private:
+    void *__addr;
+    uint64_t __size;
+    fs::path __path;
+    bool __unlink;
+
+    SharedFile(void *addr, uint64_t size, fs::path p, bool unlink) noexcept :
+      __addr{addr}, __size{size}, __path{std::move(p)}, __unlink{unlink} {}
+
+    static std::expected<SharedFile, LogError> __map(
+      int fd, const fs::path &p, uint64_t size, bool unlink
+    ) {
+      void *addr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+      ::close(fd);
+      if (addr == MAP_FAILED) {
+        if (unlink) ::unlink(p.c_str());
+        return std::unexpected{LogError::io_error("cannot map file {}", p.c_str())};
+      }
+      return SharedFile{addr, size, p, unlink};
+    }
+
+  public:
+    SharedFile(SharedFile &&o) noexcept :
+      __addr{std::exchange(o.__addr, nullptr)}, __size{std::exchange(o.__size, 0)},
+      __path{std::move(o.__path)}, __unlink{std::exchange(o.__unlink, false)} {}
+    SharedFile &operator=(SharedFile &&o) noexcept {
+      std::swap(__addr, o.__addr);
+      std::swap(__size, o.__size);
+      std::swap(__path, o.__path);
+      std::swap(__unlink, o.__unlink);
+      return *this;
+    }
+    SharedFile(const SharedFile &) = delete;
+    SharedFile &operator=(const SharedFile &) = delete;
+    ~SharedFile() {
+      if (__addr != nullptr) {
+        munmap(__addr, __size);
+        if (__unlink) {
+          ::unlink(__path.c_str());
+        }
+      }
+    }
+
+    char *data() const noexcept {
+      return static_cast<char *>(__addr);
+    }
+    uint64_t size() const noexcept {
+      return __size;
+    }
+    const fs::path &path() const noexcept {
+      return __path;
+    }
+
+    /*
+      create
+      creates (or truncates) the file at p with size zeroed bytes.
+    */
+    static std::expected<SharedFile, LogError> create(
+      const fs::path &p, uint64_t size, bool unlink_on_close
+    ) {
+      int fd = ::open(p.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+      if (fd == -1) {
+        return std::unexpected{LogError::io_error("cannot create file {}", p.c_str())};
+      }
+      if (ftruncate(fd, static_cast<off_t>(size)) != 0) {
+        ::close(fd);
+        ::unlink(p.c_str());
+        return std::unexpected{LogError::io_error("cannot resize file {}", p.c_str())};
+      }
+      return __map(fd, p, size, unlink_on_close);
+    }
+
+    static std::expected<SharedFile, LogError> open(const fs::path &p) {
+      int fd = ::open(p.c_str(), O_RDWR | O_CLOEXEC);
+      if (fd == -1) {
+        return std::unexpected{LogError::io_error("cannot open file {}", p.c_str())};
+      }
+      struct stat st;
+      if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        ::close(fd);
+        return std::unexpected{LogError::io_error("cannot map empty file {}", p.c_str())};
+      }
+      return __map(fd, p, static_cast<uint64_t>(st.st_size), false);
+    }
+  };
+}
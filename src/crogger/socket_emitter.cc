@@ -0,0 +1,272 @@
+module;
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <expected>
+#include <filesystem>
+#include <format>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+export module jowi.crogger:socket_emitter;
+import :emitter;
+import :error;
+
+namespace jowi::crogger {
+  namespace fs = std::filesystem;
+
+  /*
+    The stream carries one frame per record: a native endian uint32_t length followed by the
+    record bytes.
+  */
+  export constexpr uint32_t max_socket_frame_size = 16 * 1024 * 1024;
+
+  /*
+    SocketFrameBuffer
+    reassembles frames from the bytes read off a socket.
+  */
+  export struct SocketFrameBuffer {
+  private:
+    std::string __buf;
+    uint64_t __read;
+
+  public:
+    SocketFrameBuffer() : __buf{}, __read{0} {}
+
+    void append(std::string_view data) {
+      if (__read != 0) {
+        __buf.erase(0, __read);
+        __read = 0;
+      }
+      __buf.append(data);
+    }
+
+    /*
+      next
+      the next complete record, std::nullopt when more bytes are needed. The view stays valid
+      until the next call to append.
+    */
+    std::expected<std::optional<std::string_view>, LogError> next() {
+      std::string_view rest = std::string_view{__buf}.substr(__read);
+      uint32_t size;
+      if (rest.size() < sizeof(size)) {
+        return std::nullopt;
+      }
+      std::memcpy(&size, rest.data(), sizeof(size));
+      if (size > max_socket_frame_size) {
+        return std::unexpected{LogError::format_error("frame of {} bytes is too large", size)};
+      }
+      if (rest.size() - sizeof(size) < size) {
+        return std::nullopt;
+      }
+      __read += sizeof(size) + size;
+      return rest.substr(sizeof(size), size);
+    }
+  };
+
+  int connect_unix(const fs::path &p) {
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd == -1) {
+      return -1;
+    }
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    std::memcpy(addr.sun_path, p.c_str(), p.native().size() + 1);
+    if (connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0) {
+      ::close(fd);
+      return -1;
+    }
+    return fd;
+  }
+
+  bool send_all(int fd, std::string_view data) noexcept {
+    while (!data.empty()) {
+      auto n = send(fd, data.data(), data.size(), MSG_NOSIGNAL);
+      if (n <= 0) {
+        return false;
+      }
+      data.remove_prefix(static_cast<uint64_t>(n));
+    }
+    return true;
+  }
+
+  struct SocketState {
+    std::mutex mut;
+    std::condition_variable cv;
+    std::string filling;
+    std::deque<std::string> pending;
+    uint64_t spooled;
+    uint64_t dropped;
+    uint64_t reported_dropped;
+    bool stopped;
+    uint64_t batch_size;
+    uint64_t max_spool;
+    fs::path path;
+    int fd;
+    std::thread worker;
+
+    static constexpr std::chrono::milliseconds flush_interval{100};
+    static constexpr std::chrono::milliseconds max_backoff{1000};
+
+    SocketState(fs::path p, uint64_t batch_size, uint64_t max_spool) :
+      spooled{0}, dropped{0}, reported_dropped{0}, stopped{false}, batch_size{batch_size},
+      max_spool{max_spool}, path{std::move(p)}, fd{-1} {}
+    ~SocketState() {
+      if (fd != -1) {
+        ::close(fd);
+      }
+    }
+
+    // requires mut
+    void seal() {
+      if (!filling.empty()) {
+        spooled += filling.size();
+        pending.emplace_back(std::exchange(filling, std::string{}));
+      }
+      while (spooled > max_spool && pending.size() > 1) {
+        spooled -= pending.front().size();
+        dropped += 1;
+        pending.pop_front();
+      }
+    }
+
+    // requires mut, tells the collector about the batches lost since the last report
+    void report_dropped() {
+      if (dropped == reported_dropped) {
+        return;
+      }
+      auto note = std::format(
+        "[WARN] crogger: {} batches dropped while the collector was unavailable\n",
+        dropped - reported_dropped
+      );
+      uint32_t size = static_cast<uint32_t>(note.size());
+      std::string frame{reinterpret_cast<const char *>(&size), sizeof(size)};
+      frame.append(note);
+      spooled += frame.size();
+      pending.emplace_front(std::move(frame));
+      reported_dropped = dropped;
+    }
+
+    void run() {
+      auto backoff = std::chrono::milliseconds{10};
+      std::unique_lock lck{mut};
+      while (true) {
+        cv.wait_for(lck, flush_interval, [&]() { return stopped || !pending.empty(); });
+        seal();
+        if (pending.empty()) {
+          if (stopped) break;
+          continue;
+        }
+        if (fd == -1) {
+          lck.unlock();
+          int new_fd = connect_unix(path);
+          lck.lock();
+          if (new_fd == -1) {
+            if (stopped) break;
+            cv.wait_for(lck, backoff, [&]() { return stopped; });
+            backoff = std::min(backoff * 2, max_backoff);
+            continue;
+          }
+          fd = new_fd;
+          backoff = std::chrono::milliseconds{10};
+          report_dropped();
+        }
+        auto batch = std::move(pending.front());
+        pending.pop_front();
+        lck.unlock();
+        bool sent = send_all(fd, batch);
+        lck.lock();
+        if (sent) {
+          spooled -= batch.size();
+          continue;
+        }
+        // the collector went away, the whole batch is sent again on the next connection
+        ::close(fd);
+        fd = -1;
+        pending.emplace_front(std::move(batch));
+        if (stopped) break;
+      }
+    }
+  };
+
+  /*
+    SocketEmitter
+    streams records to a local collector listening on a Unix domain socket. Records are framed
+    and batched, a background thread sends batches of about batch_size bytes, reconnecting with
+    backoff when the collector is away. Producers never wait for the collector: up to max_spool
+    bytes are kept in memory, beyond that the oldest batches are dropped and the collector is
+    told how many once it is back.
+  */
+  export struct SocketEmitter {
+  private:
+    struct Stopper {
+      void operator()(SocketState *state) {
+        {
+          std::unique_lock lck{state->mut};
+          state->stopped = true;
+        }
+        state->cv.notify_all();
+        state->worker.join();
+        delete state;
+      }
+    };
+    std::unique_ptr<SocketState, Stopper> __state;
+
+    SocketEmitter(std::unique_ptr<SocketState, Stopper> state) : __state{std::move(state)} {}
+
+  public:
+    std::expected<void, LogError> emit(std::string_view d) const {
+      if (d.size() > max_socket_frame_size) {
+        return std::unexpected{LogError::format_error("record of {} bytes is too large", d.size())};
+      }
+      auto &state = *__state;
+      uint32_t size = static_cast<uint32_t>(d.size());
+      std::unique_lock lck{state.mut};
+      state.filling.append(reinterpret_cast<const char *>(&size), sizeof(size));
+      state.filling.append(d);
+      if (state.filling.size() >= state.batch_size) {
+        state.seal();
+        state.cv.notify_all();
+      }
+      return {};
+    }
+
+    /*
+      dropped
+      the number of batches dropped because the spool was full.
+    */
+    uint64_t dropped() const {
+      std::unique_lock lck{__state->mut};
+      return __state->dropped;
+    }
+    const fs::path &path() const noexcept {
+      return __state->path;
+    }
+
+    static std::expected<SocketEmitter, LogError> open(
+      const fs::path &p, uint64_t batch_size = 16 * 1024, uint64_t max_spool = 8 * 1024 * 1024
+    ) {
+      if (p.native().size() >= sizeof(sockaddr_un{}.sun_path)) {
+        return std::unexpected{LogError::io_error("socket path {} is too long", p.c_str())};
+      }
+      auto state = std::unique_ptr<SocketState, Stopper>{
+        new SocketState{p, std::max<uint64_t>(batch_size, 1), std::max(max_spool, batch_size)}
+      };
+      state->worker = std::thread{[s = state.get()]() { s->run(); }};
+      return SocketEmitter{std::move(state)};
+    }
+  };
+
+  template struct Emitter<SocketEmitter>;
+}
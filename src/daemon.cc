@@ -0,0 +1,486 @@
+module;
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <cerrno>
+#include <chrono>
+#include <concepts>
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <expected>
+#include <fcntl.h>
+#include <filesystem>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+export module jowi.cli:daemon;
+import :parse_error;
+
+namespace jowi::cli {
+  namespace fs = std::filesystem;
+
+  /*
+    DaemonHeader
+    starts a request, sent together with the client's stdin, stdout and stderr. size bytes of NUL
+    terminated strings follow: the argc arguments, the envc environment entries, then the working
+    directory. The daemon answers with the exit code as an int32_t.
+  */
+  struct DaemonHeader {
+    uint32_t argc;
+    uint32_t envc;
+    uint32_t size;
+  };
+
+  struct DaemonRequest {
+    DaemonHeader header;
+    int fds[3];
+    std::string payload;
+  };
+
+  bool daemon_send(int fd, const void *d, uint64_t n) noexcept {
+    auto p = static_cast<const char *>(d);
+    while (n != 0) {
+      auto w = ::send(fd, p, n, MSG_NOSIGNAL);
+      if (w < 0 && errno == EINTR) {
+        continue;
+      }
+      if (w <= 0) {
+        return false;
+      }
+      p += w;
+      n -= static_cast<uint64_t>(w);
+    }
+    return true;
+  }
+  bool daemon_recv(int fd, void *d, uint64_t n) noexcept {
+    auto p = static_cast<char *>(d);
+    while (n != 0) {
+      auto r = ::recv(fd, p, n, 0);
+      if (r < 0 && errno == EINTR) {
+        continue;
+      }
+      if (r <= 0) {
+        return false;
+      }
+      p += r;
+      n -= static_cast<uint64_t>(r);
+    }
+    return true;
+  }
+
+  std::expected<sockaddr_un, ParseError> daemon_address(const fs::path &p) {
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    if (p.native().size() >= sizeof(addr.sun_path)) {
+      return std::unexpected{ParseError::invalid_value("socket path too long {}", p.c_str())};
+    }
+    std::memcpy(addr.sun_path, p.c_str(), p.native().size());
+    return addr;
+  }
+
+  // a connected socket, -1 when nobody answers at addr
+  int daemon_connect(const sockaddr_un &addr) noexcept {
+    int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd == -1) {
+      return -1;
+    }
+    if (::connect(fd, reinterpret_cast<const sockaddr *>(&addr), sizeof(addr)) != 0) {
+      ::close(fd);
+      return -1;
+    }
+    return fd;
+  }
+
+  /*
+    Daemon
+    keeps a warm server for a command line program. The first invocation spawns a daemon which
+    does the expensive initialization (configuration, large option sets, caches) once, then every
+    later invocation only forwards its arguments, environment, working directory and standard
+    file descriptors over a Unix socket. The daemon forks a child per request, which takes over
+    the client's descriptors and runs the invocation with everything initialized already; the
+    client exits with the child's exit code. Signals sent to the client are not forwarded.
+  */
+  export struct Daemon {
+  private:
+    struct Running {
+      pid_t pid;
+      int conn;
+    };
+
+    // written to from the SIGCHLD handler, such that poll wakes up to reap
+    static inline int __wake_fd = -1;
+
+    static void __on_child(int) {
+      int saved = errno;
+      char c = 0;
+      static_cast<void>(::write(__wake_fd, &c, 1));
+      errno = saved;
+    }
+
+    static std::expected<int, ParseError> __listen(const fs::path &socket) {
+      auto addr = daemon_address(socket);
+      if (!addr) {
+        return std::unexpected{std::move(addr.error())};
+      }
+      // a socket file nobody answers on was left by a daemon which is gone
+      if (int probe = daemon_connect(addr.value()); probe != -1) {
+        ::close(probe);
+        return std::unexpected{
+          ParseError::invalid_value("a daemon already listens on {}", socket.c_str())
+        };
+      }
+      std::error_code ec;
+      if (fs::is_socket(socket, ec)) {
+        fs::remove(socket, ec);
+      }
+      int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+      auto *sa = reinterpret_cast<sockaddr *>(&addr.value());
+      // the socket file is created 0700, connecting to it needs write permission. umask leaves
+      // errno alone
+      mode_t mask = ::umask(0077);
+      int bound = fd == -1 ? -1 : ::bind(fd, sa, sizeof(sockaddr_un));
+      ::umask(mask);
+      if (bound != 0 || ::listen(fd, 64) != 0) {
+        int err = errno;
+        if (fd != -1) {
+          ::close(fd);
+        }
+        return std::unexpected{
+          ParseError::invalid_value("cannot listen on {}: {}", socket.c_str(), std::strerror(err))
+        };
+      }
+      return fd;
+    }
+
+    // a client stalling mid-request holds up the accept loop for at most this long
+    static constexpr timeval __receive_timeout{1, 0};
+
+    // only the user running the daemon may have it run an invocation with its privileges
+    static bool __same_user(int conn) noexcept {
+      ucred cred{};
+      socklen_t len = sizeof(cred);
+      return ::getsockopt(conn, SOL_SOCKET, SO_PEERCRED, &cred, &len) == 0 &&
+        cred.uid == ::geteuid();
+    }
+
+    static bool __receive(int conn, DaemonRequest &req) {
+      iovec iov{&req.header, sizeof(DaemonHeader)};
+      alignas(cmsghdr) char control[CMSG_SPACE(3 * sizeof(int))]{};
+      msghdr msg{};
+      msg.msg_iov = &iov;
+      msg.msg_iovlen = 1;
+      msg.msg_control = control;
+      msg.msg_controllen = sizeof(control);
+      ssize_t n;
+      do {
+        n = ::recvmsg(conn, &msg, MSG_CMSG_CLOEXEC);
+      } while (n < 0 && errno == EINTR);
+      cmsghdr *c = CMSG_FIRSTHDR(&msg);
+      if (c == nullptr || c->cmsg_level != SOL_SOCKET || c->cmsg_type != SCM_RIGHTS ||
+          c->cmsg_len != CMSG_LEN(3 * sizeof(int))) {
+        return false;
+      }
+      std::memcpy(req.fds, CMSG_DATA(c), sizeof(req.fds));
+      bool ok = n == sizeof(DaemonHeader) && req.header.size <= (64u << 20);
+      if (ok) {
+        req.payload.resize(req.header.size);
+        ok = daemon_recv(conn, req.payload.data(), req.payload.size());
+      }
+      if (!ok) {
+        for (int fd : req.fds) {
+          ::close(fd);
+        }
+      }
+      return ok;
+    }
+
+    // sends the exit code of every finished child to its client
+    static void __reap(std::vector<Running> &running) {
+      int status;
+      pid_t pid;
+      while ((pid = ::waitpid(-1, &status, WNOHANG)) > 0) {
+        std::erase_if(running, [&](const Running &r) {
+          if (r.pid != pid) {
+            return false;
+          }
+          int32_t code = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+          daemon_send(r.conn, &code, sizeof(code));
+          ::close(r.conn);
+          return true;
+        });
+      }
+    }
+
+    template <class F>
+    [[noreturn]] static void __run_child(DaemonRequest &req, int listen_fd, F &handler) {
+      struct sigaction dfl{};
+      dfl.sa_handler = SIG_DFL;
+      ::sigaction(SIGCHLD, &dfl, nullptr);
+      ::close(listen_fd);
+      for (int i = 0; i != 3; i += 1) {
+        ::dup2(req.fds[i], i);
+      }
+      for (int fd : req.fds) {
+        if (fd > 2) {
+          ::close(fd);
+        }
+      }
+      std::vector<const char *> argv;
+      std::vector<char *> env;
+      char *p = req.payload.data();
+      char *end = p + req.payload.size();
+      auto next = [&]() {
+        char *s = p;
+        p = static_cast<char *>(std::memchr(p, '\0', end - p));
+        p = p == nullptr ? end : p + 1;
+        return s;
+      };
+      for (uint32_t i = 0; i != req.header.argc && p != end; i += 1) {
+        argv.emplace_back(next());
+      }
+      argv.emplace_back(nullptr);
+      for (uint32_t i = 0; i != req.header.envc && p != end; i += 1) {
+        env.emplace_back(next());
+      }
+      env.emplace_back(nullptr);
+      if (p == end || ::chdir(p) != 0) {
+        std::fprintf(stderr, "daemon: cannot enter the working directory\n");
+        std::_Exit(1);
+      }
+      environ = env.data();
+      int code = std::invoke(handler, static_cast<int>(argv.size() - 1), argv.data());
+      // the daemon's static destructors and atexit hooks are not the request's to run
+      std::fflush(nullptr);
+      std::_Exit(code);
+    }
+
+  public:
+    static constexpr std::chrono::milliseconds default_idle = std::chrono::minutes{10};
+
+    /*
+      forward
+      runs the invocation in the daemon listening on socket, returning its exit code. An error
+      means no daemon took the request, it did not run.
+    */
+    static std::expected<int, ParseError> forward(
+      const fs::path &socket, int argc, const char **argv, const char **envp = nullptr
+    ) {
+      auto addr = daemon_address(socket);
+      if (!addr) {
+        return std::unexpected{std::move(addr.error())};
+      }
+      int fd = daemon_connect(addr.value());
+      if (fd == -1) {
+        return std::unexpected{
+          ParseError::invalid_value("no daemon listens on {}", socket.c_str())
+        };
+      }
+      std::string payload;
+      for (int i = 0; i != argc; i += 1) {
+        payload.append(argv[i]);
+        payload.push_back('\0');
+      }
+      uint32_t envc = 0;
+      for (auto e = envp != nullptr ? envp : const_cast<const char **>(environ); *e != nullptr;
+           ++e) {
+        payload.append(*e);
+        payload.push_back('\0');
+        envc += 1;
+      }
+      std::error_code ec;
+      payload.append(fs::current_path(ec).native());
+      payload.push_back('\0');
+
+      DaemonHeader header{
+        static_cast<uint32_t>(argc), envc, static_cast<uint32_t>(payload.size())
+      };
+      int fds[3] = {STDIN_FILENO, STDOUT_FILENO, STDERR_FILENO};
+      iovec iov{&header, sizeof(header)};
+      alignas(cmsghdr) char control[CMSG_SPACE(sizeof(fds))]{};
+      msghdr msg{};
+      msg.msg_iov = &iov;
+      msg.msg_iovlen = 1;
+      msg.msg_control = control;
+      msg.msg_controllen = sizeof(control);
+      cmsghdr *c = CMSG_FIRSTHDR(&msg);
+      c->cmsg_level = SOL_SOCKET;
+      c->cmsg_type = SCM_RIGHTS;
+      c->cmsg_len = CMSG_LEN(sizeof(fds));
+      std::memcpy(CMSG_DATA(c), fds, sizeof(fds));
+      ssize_t sent;
+      do {
+        sent = ::sendmsg(fd, &msg, MSG_NOSIGNAL);
+      } while (sent < 0 && errno == EINTR);
+      if (sent != sizeof(header) || !daemon_send(fd, payload.data(), payload.size())) {
+        ::close(fd);
+        return std::unexpected{
+          ParseError::invalid_value("cannot send the request to {}", socket.c_str())
+        };
+      }
+      int32_t code;
+      if (!daemon_recv(fd, &code, sizeof(code))) {
+        // the request was taken, the daemon went away while it ran
+        code = 1;
+      }
+      ::close(fd);
+      return code;
+    }
+
+    /*
+      serve
+      answers the requests sent to socket until no request came for idle. handler(argc, argv) runs
+      each of them in a child process, its result being the exit code. The socket is only
+      accessible to its owner, and a connection from another user is closed unanswered. The child
+      flushes stdio after handler and leaves with _Exit, without running static destructors or
+      atexit hooks: any other buffered output (e.g. a Logger's emitter) is for handler to flush.
+    */
+    template <std::invocable<int, const char **> F>
+    static std::expected<void, ParseError> serve(
+      const fs::path &socket, F &&handler, std::chrono::milliseconds idle = default_idle
+    ) {
+      auto listen_fd = __listen(socket);
+      if (!listen_fd) {
+        return std::unexpected{std::move(listen_fd.error())};
+      }
+      int wake[2];
+      if (::pipe2(wake, O_NONBLOCK | O_CLOEXEC) != 0) {
+        ::close(listen_fd.value());
+        return std::unexpected{ParseError::invalid_value("cannot create pipe")};
+      }
+      __wake_fd = wake[1];
+      struct sigaction on_child{};
+      struct sigaction saved{};
+      on_child.sa_handler = __on_child;
+      on_child.sa_flags = SA_RESTART | SA_NOCLDSTOP;
+      ::sigaction(SIGCHLD, &on_child, &saved);
+
+      std::vector<Running> running;
+      DaemonRequest req;
+      while (true) {
+        pollfd fds[2] = {{listen_fd.value(), POLLIN, 0}, {wake[0], POLLIN, 0}};
+        int n = ::poll(fds, 2, running.empty() ? static_cast<int>(idle.count()) : -1);
+        if (n < 0 && errno == EINTR) {
+          continue;
+        }
+        if (n <= 0) {
+          break;
+        }
+        if (fds[1].revents != 0) {
+          char drain[64];
+          while (::read(wake[0], drain, sizeof(drain)) > 0) {}
+          __reap(running);
+        }
+        if ((fds[0].revents & POLLIN) == 0) {
+          continue;
+        }
+        int conn = ::accept4(listen_fd.value(), nullptr, nullptr, SOCK_CLOEXEC);
+        if (conn == -1) {
+          continue;
+        }
+        if (!__same_user(conn)) {
+          ::close(conn);
+          continue;
+        }
+        if (::setsockopt(
+              conn, SOL_SOCKET, SO_RCVTIMEO, &__receive_timeout, sizeof(__receive_timeout)
+            ) != 0 ||
+            !__receive(conn, req)) {
+          ::close(conn);
+          continue;
+        }
+        // the child must not write what the daemon itself left buffered
+        std::fflush(nullptr);
+        pid_t pid = ::fork();
+        if (pid == 0) {
+          ::close(conn);
+          ::close(wake[0]);
+          ::close(wake[1]);
+          __run_child(req, listen_fd.value(), handler);
+        }
+        for (int fd : req.fds) {
+          ::close(fd);
+        }
+        if (pid == -1) {
+          int32_t code = 127;
+          daemon_send(conn, &code, sizeof(code));
+          ::close(conn);
+          continue;
+        }
+        running.emplace_back(Running{pid, conn});
+      }
+
+      ::sigaction(SIGCHLD, &saved, nullptr);
+      ::close(wake[0]);
+      ::close(wake[1]);
+      __wake_fd = -1;
+      ::close(listen_fd.value());
+      std::error_code ec;
+      fs::remove(socket, ec);
+      return {};
+    }
+
+    /*
+      spawn
+      starts serve in a detached background process, with make_handler called there once.
+    */
+    template <class MakeHandler>
+    static void spawn(
+      const fs::path &socket, MakeHandler &&make_handler,
+      std::chrono::milliseconds idle = default_idle
+    ) {
+      std::fflush(nullptr);
+      pid_t pid = ::fork();
+      if (pid != 0) {
+        if (pid > 0) {
+          ::waitpid(pid, nullptr, 0);
+        }
+        return;
+      }
+      // the intermediate process exits right away, the daemon is then nobody's zombie
+      if (::setsid() == -1 || ::fork() != 0) {
+        std::_Exit(0);
+      }
+      int null = ::open("/dev/null", O_RDWR);
+      for (int i = 0; i != 3; i += 1) {
+        ::dup2(null, i);
+      }
+      if (null > 2) {
+        ::close(null);
+      }
+      auto res = serve(socket, make_handler(), idle);
+      std::_Exit(res ? 0 : 1);
+    }
+
+    /*
+      run
+      the main of a program kept warm by a daemon. The invocation is forwarded to the daemon
+      listening on socket. Without one, a daemon is spawned for the next invocations and this one
+      runs in process. make_handler does the expensive initialization and returns the handler of
+      an invocation, int(int argc, const char **argv), which typically calls App::reset_args on an
+      App built during the initialization.
+    */
+    template <class MakeHandler>
+      requires(std::invocable<std::invoke_result_t<MakeHandler &>, int, const char **>)
+    static int run(
+      const fs::path &socket, int argc, const char **argv, const char **envp,
+      MakeHandler &&make_handler, std::chrono::milliseconds idle = default_idle
+    ) {
+      if (auto code = forward(socket, argc, argv, envp)) {
+        return code.value();
+      }
+      spawn(socket, make_handler, idle);
+      auto handler = make_handler();
+      return std::invoke(handler, argc, argv);
+    }
+  };
+}
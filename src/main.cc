@@ -8,4 +8,11 @@ export import :app;
 export import :app_identity;
 export import :action_builder;
 export import :arg_shortcut;
-export import :parse_error;
\ No newline at end of file
+export import :arg_spec;
+export import :parse_error;
+export import :profiler;
+export import :raw_args;
+export import :shell_lexer;
+export import :command_source;
+export import :daemon;
+export import :work_pool;
\ No newline at end of file
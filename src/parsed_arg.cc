@@ -1,7 +1,8 @@
 module;
-#include <algorithm>
+#include <memory>
 #include <optional>
-#include <ranges>
+#include <span>
+#include <string>
 #include <string_view>
 #include <vector>
 export module jowi.cli:parsed_arg;
@@ -11,79 +12,222 @@ import :arg_key;
 
 namespace jowi::cli {
 
-  using ParamPair = std::pair<ArgKey, std::string_view>;
+  /*
+    ParsedParam
+    a keyword argument given on the command line: the interned id of its key and its value, a view
+    straight into the raw arguments.
+  */
+  struct ParsedParam {
+    ArgSymbols::Id key;
+    std::string_view value;
+  };
+
+  /*
+    KeyStats
+    where a key first appears among the params of a positional and how often, kept up to date
+    while parsing such that count validation does not rescan the params. offset is where the
+    values of the key start in the grouped index.
+  */
+  struct KeyStats {
+    uint64_t first;
+    uint64_t count;
+    mutable uint64_t offset;
+  };
+
+  /*
+    PositionalParsedArg
+    a positional and its params. keys is indexed by key id, a key never given having a count of 0.
+    grouped holds the param values ordered by key, each key's values being one contiguous slice.
+    It is rebuilt after parsing, or on the first filter after a param was added.
+  */
   struct PositionalParsedArg {
     std::string_view value;
-    std::vector<ParamPair> params;
+    std::vector<ParsedParam> params;
+    std::vector<KeyStats> keys;
+    mutable std::vector<std::string_view> grouped;
+    mutable bool indexed;
+
+    const KeyStats *stats(ArgSymbols::Id key) const noexcept {
+      return key < keys.size() && keys[key].count != 0 ? &keys[key] : nullptr;
+    }
+
+    void add(ArgSymbols::Id key, std::string_view v) {
+      if (key >= keys.size()) {
+        keys.resize(key + 1, KeyStats{0, 0, 0});
+      }
+      auto &st = keys[key];
+      if (st.count == 0) {
+        st.first = params.size();
+      }
+      st.count += 1;
+      params.emplace_back(ParsedParam{key, v});
+      indexed = false;
+    }
+
+    void build_index() const {
+      if (indexed) {
+        return;
+      }
+      uint64_t offset = 0;
+      for (const auto &st : keys) {
+        st.offset = offset;
+        offset += st.count;
+      }
+      // offset is used as the fill cursor of every key, then moved back to the slice start
+      grouped.resize(params.size());
+      for (const auto &[k, v] : params) {
+        grouped[keys[k].offset++] = v;
+      }
+      for (const auto &st : keys) {
+        st.offset -= st.count;
+      }
+      indexed = true;
+    }
+
+    // empties the positional for value, keeping the capacity of its vectors
+    void reuse(std::string_view v) noexcept {
+      value = v;
+      params.clear();
+      keys.clear();
+      grouped.clear();
+      indexed = false;
+    }
   };
+
+  /*
+    ParsedArg
+    the result of a parse. __values is only grown: positionals beyond __size are kept, storage
+    included, for the parses after a reset.
+  */
   export class ParsedArg {
     std::vector<PositionalParsedArg> __values;
+    uint64_t __size;
+    std::shared_ptr<ArgSymbols> __symbols;
     RawArgsIterator __beg;
     RawArgsIterator __end;
 
-    ParsedArg(RawArgsIterator beg, RawArgsIterator end) : __values{}, __beg{beg}, __end{end} {}
+    const PositionalParsedArg &__back() const noexcept {
+      return __values[__size - 1];
+    }
+    const KeyStats *__stats(std::string_view key) const noexcept {
+      if (__size == 0) {
+        return nullptr;
+      }
+      auto id = __symbols->find(key);
+      return id ? __back().stats(*id) : nullptr;
+    }
 
   public:
     // Parameter Control
-    ParsedArg(RawArgs args) : __values{}, __beg{args.begin()}, __end{args.end()} {}
-    ParsedArg &add_argument(ArgKey key, std::string_view value) {
-      __values.back().params.emplace_back(ParamPair{key, value});
+    ParsedArg(RawArgs args) :
+      __values{}, __size{0}, __symbols{std::make_shared<ArgSymbols>()}, __beg{args.begin()},
+      __end{args.end()} {}
+
+    /*
+      reset
+      forgets the previous parse and starts over on args. The storage of the previous parse is
+      reused, such that parsing command lines of a similar shape stops allocating.
+    */
+    void reset(RawArgs args) noexcept {
+      __size = 0;
+      __beg = args.begin();
+      __end = args.end();
+    }
+    void reset(std::span<const std::string_view> tokens) noexcept {
+      reset(RawArgs{tokens});
+    }
+
+    /*
+      bind
+      makes the key ids of symbols the ones params are stored with, done by the parser before
+      anything is parsed.
+    */
+    void bind(std::shared_ptr<ArgSymbols> symbols) {
+      if (__size == 0) {
+        __symbols = std::move(symbols);
+      }
+    }
+    ParsedArg &add_argument(ArgSymbols::Id key, std::string_view value) {
+      __values[__size - 1].add(key, value);
       return *this;
     }
+    ParsedArg &add_argument(const ArgKey &key, std::string_view value) {
+      return add_argument(__symbols->intern(key.value()), value);
+    }
+    std::string_view key_name(ArgSymbols::Id key) const noexcept {
+      return __symbols->name(key);
+    }
     PositionalParsedArg &add_argument(std::string_view argument) {
-      return __values.emplace_back(PositionalParsedArg{argument});
+      if (__size == __values.size()) {
+        __values.emplace_back(PositionalParsedArg{argument, {}, {}, {}, false});
+      } else {
+        __values[__size].reuse(argument);
+      }
+      return __values[__size++];
+    }
+
+    /*
+      index
+      groups the values of every positional by key, called once parsing is done such that
+      filter only reads afterwards.
+    */
+    void index() const {
+      for (const auto &pos : *this) {
+        pos.build_index();
+      }
     }
     std::string_view arg() const noexcept {
-      return __values.back().value;
+      return __back().value;
     }
     auto param_beg() const noexcept {
-      return __values.back().params.begin();
+      return __back().params.begin();
     }
     auto param_end() const noexcept {
-      return __values.back().params.end();
+      return __back().params.end();
     }
     auto begin() const noexcept {
       return __values.begin();
     }
     auto end() const noexcept {
-      return __values.end();
+      return __values.begin() + __size;
     }
     auto param_size() const noexcept {
-      return __values.size();
+      return __size;
     }
     uint64_t size() const noexcept {
-      return __values.size();
+      return __size;
     }
     bool empty() const noexcept {
-      return __values.empty();
+      return __size == 0;
     }
 
     // Query Functions
     constexpr std::optional<std::string_view> first_of(
       const generic::IsComparable<ArgKey> auto &key
     ) const noexcept {
-      auto it = std::ranges::find_if(param_beg(), param_end(), [&](const auto &p) {
-        return p.first == key;
-      });
-      if (it == param_end()) return std::nullopt;
-      return it->second;
+      auto stats = __stats(key_view(key));
+      if (stats == nullptr) return std::nullopt;
+      return __back().params[stats->first].value;
     }
     constexpr bool contains(const generic::IsComparable<ArgKey> auto &key) const noexcept {
-      return first_of(key).has_value();
-    }
-    constexpr auto filter(generic::IsComparable<ArgKey> auto key) const noexcept {
-      return std::ranges::transform_view{
-        std::ranges::filter_view{
-          std::ranges::subrange{param_beg(), param_end()},
-          [key = std::move(key)](const ParamPair &p) { return p.first == key; }
-        },
-        &ParamPair::second
-      };
+      return __stats(key_view(key)) != nullptr;
+    }
+    /*
+      filter
+      the values given to key, in the order they were given.
+    */
+    std::span<const std::string_view> filter(const generic::IsComparable<ArgKey> auto &key) const {
+      auto stats = __stats(key_view(key));
+      if (stats == nullptr) {
+        return {};
+      }
+      const auto &pos = __back();
+      pos.build_index();
+      return std::span{pos.grouped}.subspan(stats->offset, stats->count);
     }
     constexpr uint64_t count(const generic::IsComparable<ArgKey> auto &key) const noexcept {
-      return std::ranges::count_if(param_beg(), param_end(), [&](const auto &p) {
-        return p.first == key;
-      });
+      auto stats = __stats(key_view(key));
+      return stats == nullptr ? 0 : stats->count;
     }
 
     // Raw Argument Iterations
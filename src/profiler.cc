@@ -0,0 +1,271 @@
+module;
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <format>
+#include <iterator>
+#include <memory>
+#include <print>
+#include <string>
+#include <string_view>
+#include <vector>
+export module jowi.cli:profiler;
+import jowi.tui;
+import :raw_args;
+namespace tui = jowi::tui;
+
+namespace jowi::cli {
+  /*
+    StartupProfiler
+    times the phases of an App run as a tree. Phases opened again under the same parent, e.g. the
+    validation of a repeated key, are merged into one node counting the calls. At most one profiler
+    is active per thread, the one created by App for --profile-startup; the report is printed to
+    stderr when the App is destroyed or the program exits, whichever comes first.
+    Phases opened by step and by begin are told apart: step only ever replaces the previous step,
+    such that an App parsing again inside an action nests its steps under the action.
+  */
+  export struct StartupProfiler {
+  private:
+    using Clock = std::chrono::steady_clock;
+    struct Phase {
+      std::string label;
+      std::vector<uint64_t> children;
+      Clock::duration total;
+      uint64_t calls;
+      Clock::time_point started;
+    };
+    struct OpenPhase {
+      uint64_t id;
+      bool step;
+    };
+    std::vector<Phase> __phases;
+    std::vector<OpenPhase> __open;
+    bool __json;
+    bool __reported;
+
+    static inline thread_local StartupProfiler *__active = nullptr;
+
+    static void __report_at_exit() {
+      if (__active != nullptr) {
+        __active->report();
+      }
+    }
+
+    tui::DomNode __dom(uint64_t id) const {
+      const auto &p = __phases[id];
+      auto ms = std::chrono::duration<double, std::milli>{p.total}.count();
+      auto layout = tui::Layout{};
+      if (p.calls > 1) {
+        layout.append_child(tui::Paragraph("{} {:.3f} ms ({} calls)", p.label, ms, p.calls));
+      } else {
+        layout.append_child(tui::Paragraph("{} {:.3f} ms", p.label, ms));
+      }
+      if (!p.children.empty()) {
+        auto children = tui::Layout{}.style(tui::DomStyle{}.indent(2));
+        for (auto child : p.children) {
+          children.append_child(__dom(child));
+        }
+        layout.append_child(tui::DomNode::vstack(std::move(children)));
+      }
+      return tui::DomNode::vstack(std::move(layout));
+    }
+
+    void __json_to(uint64_t id, std::string &out) const {
+      const auto &p = __phases[id];
+      out.append("{\"name\":\"");
+      for (char c : p.label) {
+        if (c == '"' || c == '\\') {
+          out.push_back('\\');
+          out.push_back(c);
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+          std::format_to(std::back_inserter(out), "\\u{:04x}", static_cast<unsigned int>(c));
+        } else {
+          out.push_back(c);
+        }
+      }
+      std::format_to(
+        std::back_inserter(out),
+        "\",\"ns\":{},\"calls\":{},\"children\":[",
+        std::chrono::duration_cast<std::chrono::nanoseconds>(p.total).count(),
+        p.calls
+      );
+      for (uint64_t i = 0; i != p.children.size(); i += 1) {
+        if (i != 0) out.push_back(',');
+        __json_to(p.children[i], out);
+      }
+      out.append("]}");
+    }
+
+  public:
+    StartupProfiler(bool json) : __phases{}, __open{}, __json{json}, __reported{false} {
+      __phases.emplace_back(Phase{"startup", {}, Clock::duration{0}, 1, Clock::now()});
+      __open.emplace_back(OpenPhase{0, false});
+    }
+    StartupProfiler(const StartupProfiler &) = delete;
+    StartupProfiler &operator=(const StartupProfiler &) = delete;
+    ~StartupProfiler() {
+      if (__active == this) {
+        __active = nullptr;
+      }
+    }
+
+  private:
+    void __begin(std::string_view name, std::string_view detail, bool step) {
+      if (__open.empty()) {
+        return;
+      }
+      auto label = detail.empty() ? std::string{name} : std::format("{} {}", name, detail);
+      auto &parent = __phases[__open.back().id];
+      uint64_t id = __phases.size();
+      for (auto child : parent.children) {
+        if (__phases[child].label == label) {
+          id = child;
+          break;
+        }
+      }
+      if (id == __phases.size()) {
+        __phases[__open.back().id].children.emplace_back(id);
+        __phases.emplace_back(Phase{std::move(label), {}, Clock::duration{0}, 0, {}});
+      }
+      auto &p = __phases[id];
+      p.calls += 1;
+      p.started = Clock::now();
+      __open.emplace_back(OpenPhase{id, step});
+    }
+
+  public:
+    /*
+      begin
+      opens the phase "name detail" under the innermost open phase.
+    */
+    void begin(std::string_view name, std::string_view detail = {}) {
+      __begin(name, detail, false);
+    }
+    void end() {
+      if (__open.size() > 1) {
+        auto &p = __phases[__open.back().id];
+        p.total += Clock::now() - p.started;
+        __open.pop_back();
+      }
+    }
+
+    /*
+      depth
+      the number of open phases, end_to(depth()) taken before a begin closes what it opened.
+    */
+    uint64_t depth() const noexcept {
+      return __open.size();
+    }
+    void end_to(uint64_t depth) {
+      while (__open.size() > std::max<uint64_t>(depth, 1)) {
+        end();
+      }
+    }
+
+    /*
+      step
+      closes the phase opened by the previous step and opens name, for the sequential stages of a
+      run. A phase opened by begin since then is left open, the step is opened under it instead.
+    */
+    void step(std::string_view name) {
+      if (__open.size() > 1 && __open.back().step) {
+        end();
+      }
+      __begin(name, {}, true);
+    }
+
+    /*
+      finish
+      closes every open phase, the root included.
+    */
+    void finish() {
+      while (__open.size() > 1) {
+        end();
+      }
+      if (!__open.empty()) {
+        __phases[0].total = Clock::now() - __phases[0].started;
+        __open.clear();
+      }
+    }
+
+    tui::DomNode dom() const {
+      return __dom(0);
+    }
+    std::string json() const {
+      std::string out;
+      __json_to(0, out);
+      return out;
+    }
+
+    /*
+      report
+      finishes the profile and prints it to stderr, once.
+    */
+    void report() {
+      if (__reported) {
+        return;
+      }
+      __reported = true;
+      finish();
+      if (__json) {
+        std::println(stderr, "{}", json());
+      } else {
+        std::print(stderr, "{}", dom());
+      }
+    }
+
+    /*
+      from_args
+      a profiler when the raw arguments hold --profile-startup or --profile-startup=json.
+    */
+    static std::unique_ptr<StartupProfiler> from_args(RawArgs args) {
+      for (auto arg : args) {
+        if (arg == "--profile-startup") {
+          return std::make_unique<StartupProfiler>(false);
+        }
+        if (arg.starts_with("--profile-startup=")) {
+          return std::make_unique<StartupProfiler>(arg.substr(18) == "json");
+        }
+      }
+      return nullptr;
+    }
+
+    static StartupProfiler *active() noexcept {
+      return __active;
+    }
+    static void activate(StartupProfiler *profiler) {
+      static bool registered = std::atexit(__report_at_exit) == 0;
+      static_cast<void>(registered);
+      __active = profiler;
+    }
+  };
+
+  /*
+    ProfilePhase
+    times its scope as a phase of the active profiler, a thread local load when there is none.
+  */
+  export struct ProfilePhase {
+  private:
+    StartupProfiler *__p;
+    uint64_t __depth;
+
+  public:
+    ProfilePhase(std::string_view name, std::string_view detail = {}) :
+      __p{StartupProfiler::active()}, __depth{0} {
+      if (__p != nullptr) {
+        __depth = __p->depth();
+        __p->begin(name, detail);
+      }
+    }
+    ProfilePhase(const ProfilePhase &) = delete;
+    ProfilePhase &operator=(const ProfilePhase &) = delete;
+    // closes the phase along with the steps opened inside it
+    ~ProfilePhase() {
+      if (__p != nullptr) {
+        __p->end_to(__depth);
+      }
+    }
+  };
+}
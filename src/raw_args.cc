@@ -1,5 +1,6 @@
 module;
 #include <optional>
+#include <span>
 #include <string_view>
 export module jowi.cli:raw_args;
 
@@ -9,10 +10,13 @@ namespace jowi::cli {
     int __cur;
     int __argc;
     const char **__argv;
+    const std::string_view *__views;
 
   public:
     RawArgsIterator(const char **argv, int cur, int argc) noexcept :
-      __argv{argv}, __cur{cur}, __argc{argc} {}
+      __cur{cur}, __argc{argc}, __argv{argv}, __views{nullptr} {}
+    RawArgsIterator(const std::string_view *views, int cur, int argc) noexcept :
+      __cur{cur}, __argc{argc}, __argv{nullptr}, __views{views} {}
 
     // Iterator Satisfaction
     RawArgsIterator &operator++() noexcept {
@@ -23,30 +27,49 @@ namespace jowi::cli {
       __cur += 1;
     }
     std::string_view operator*() const noexcept {
-      return __argv[__cur];
+      return __views != nullptr ? __views[__cur] : std::string_view{__argv[__cur]};
     }
     friend bool operator==(const RawArgsIterator &l, const RawArgsIterator &r) {
-      return l.__cur == r.__cur && l.__argv == r.__argv;
+      return l.__cur == r.__cur && l.__argv == r.__argv && l.__views == r.__views;
     }
   };
 
-  struct RawArgs {
+  /*
+    RawArgs
+    the arguments to parse, either the argv of the process or tokens held by the caller, e.g. the
+    views ShellLexer splits a command line into. The first one names the program or command, as
+    argv[0] does.
+  */
+  export struct RawArgs {
   private:
     int __argc;
     const char **__argv;
+    const std::string_view *__views;
 
   public:
-    RawArgs(int argc, const char **argv) noexcept : __argc{argc}, __argv{argv} {}
+    RawArgs(int argc, const char **argv) noexcept :
+      __argc{argc}, __argv{argv}, __views{nullptr} {}
+    RawArgs(std::span<const std::string_view> tokens) noexcept :
+      __argc{static_cast<int>(tokens.size())}, __argv{nullptr}, __views{tokens.data()} {}
 
     std::optional<std::string_view> operator[](int id) const noexcept {
       if (id >= __argc) return std::nullopt;
-      return std::string_view{__argv[id]};
+      return __views != nullptr ? __views[id] : std::string_view{__argv[id]};
+    }
+    int size() const noexcept {
+      return __argc;
     }
     RawArgsIterator begin() const noexcept {
+      if (__views != nullptr) {
+        return RawArgsIterator{__views, 0, __argc};
+      }
       return RawArgsIterator{__argv, 0, __argc};
     }
     RawArgsIterator end() const noexcept {
+      if (__views != nullptr) {
+        return RawArgsIterator{__views, __argc, __argc};
+      }
       return RawArgsIterator{__argv, __argc, __argc};
     }
   };
-}
\ No newline at end of file
+}
@@ -0,0 +1,106 @@
+module;
+#include <cstdint>
+#include <expected>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+export module jowi.cli:shell_lexer;
+import :parse_error;
+
+namespace jowi::cli {
+  /*
+    ShellLexer
+    splits a command line into tokens the way a POSIX shell does for words: blanks separate
+    tokens, single quotes keep everything literally, double quotes keep everything but \" and \\,
+    a backslash outside quotes escapes the next character and # starts a comment at the start of a
+    token. Quotes and escapes are removed by moving the characters left inside the line itself,
+    so the tokens are views into the caller's buffer and nothing is copied. The token vector is
+    kept across calls, splitting lines no longer allocates once it is large enough.
+  */
+  export struct ShellLexer {
+  private:
+    std::vector<std::string_view> __tokens;
+
+    static bool __is_blank(char c) noexcept {
+      return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+    }
+
+  public:
+    ShellLexer() : __tokens{} {}
+
+    /*
+      split
+      the tokens of line, which is rewritten in place and must outlive them. An error is returned
+      for an unterminated quote or a trailing backslash.
+    */
+    std::expected<std::span<const std::string_view>, ParseError> split(std::span<char> line) {
+      __tokens.clear();
+      char *data = line.data();
+      uint64_t size = line.size();
+      uint64_t r = 0;
+      while (r != size) {
+        if (__is_blank(data[r])) {
+          r += 1;
+          continue;
+        }
+        if (data[r] == '#') {
+          break;
+        }
+        // w never passes r, unquoting only ever drops characters
+        uint64_t beg = r;
+        uint64_t w = r;
+        while (r != size && !__is_blank(data[r])) {
+          char c = data[r];
+          if (c == '\'') {
+            uint64_t close = r + 1;
+            while (close != size && data[close] != '\'') {
+              close += 1;
+            }
+            if (close == size) {
+              return std::unexpected{
+                ParseError{ParseErrorType::INVALID_VALUE, "unterminated ' at {}", r}
+              };
+            }
+            for (r += 1; r != close; r += 1) {
+              data[w++] = data[r];
+            }
+            r += 1;
+          } else if (c == '"') {
+            uint64_t open = r;
+            r += 1;
+            while (r != size && data[r] != '"') {
+              if (data[r] == '\\' && r + 1 != size && (data[r + 1] == '"' || data[r + 1] == '\\')) {
+                r += 1;
+              }
+              data[w++] = data[r++];
+            }
+            if (r == size) {
+              return std::unexpected{
+                ParseError{ParseErrorType::INVALID_VALUE, "unterminated \" at {}", open}
+              };
+            }
+            r += 1;
+          } else if (c == '\\') {
+            if (r + 1 == size) {
+              return std::unexpected{ParseError{ParseErrorType::INVALID_VALUE, "trailing \\"}};
+            }
+            data[w++] = data[r + 1];
+            r += 2;
+          } else {
+            data[w++] = data[r++];
+          }
+        }
+        __tokens.emplace_back(data + beg, w - beg);
+      }
+      return std::span<const std::string_view>{__tokens};
+    }
+    std::expected<std::span<const std::string_view>, ParseError> split(std::string &line) {
+      return split(std::span<char>{line.data(), line.size()});
+    }
+
+    std::span<const std::string_view> tokens() const noexcept {
+      return __tokens;
+    }
+  };
+}
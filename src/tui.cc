@@ -5,6 +5,7 @@ module;
 #include <cstdint>
 #include <format>
 #include <functional>
+#include <iterator>
 #include <optional>
 #include <ranges>
 #include <string>
@@ -319,15 +320,21 @@ namespace jowi::tui {
       {TextEffect::DOUBLE_UNDERLINE, 9},
     }};
 
+    /*
+      render_style
+      the escape sequence selecting style, nullopt for a plain style. The codes are gathered on the
+      stack, such that only a sequence too long for the small string buffer allocates.
+    */
     inline std::optional<std::string> render_style(const DomStyle &style) {
-      std::vector<unsigned int> codes;
+      std::array<unsigned int, ANSI_EFFECT_MAP.size() + 2> codes;
+      std::size_t n = 0;
       if (const auto &effects = style.effects()) {
         for (const auto &effect : *effects) {
           if (const auto it = std::ranges::find_if(
                 ANSI_EFFECT_MAP, [&](const auto &entry) { return entry.first == effect; }
               );
               it != ANSI_EFFECT_MAP.end()) {
-            codes.push_back(it->second);
+            codes[n++] = it->second;
           }
         }
       }
@@ -336,7 +343,7 @@ namespace jowi::tui {
               ANSI_BG_MAP, [&](const auto &entry) { return entry.first == *bg; }
             );
             it != ANSI_BG_MAP.end()) {
-          codes.push_back(it->second);
+          codes[n++] = it->second;
         }
       }
       if (const auto &fg = style.fg_color()) {
@@ -344,20 +351,20 @@ namespace jowi::tui {
               ANSI_FG_MAP, [&](const auto &entry) { return entry.first == *fg; }
             );
             it != ANSI_FG_MAP.end()) {
-          codes.push_back(it->second);
+          codes[n++] = it->second;
         }
       }
 
-      if (codes.empty()) {
+      if (n == 0) {
         return std::nullopt;
       }
 
       std::string code_str{"\x1b["};
-      for (std::size_t i = 0; i < codes.size(); ++i) {
+      for (std::size_t i = 0; i < n; ++i) {
         if (i != 0) {
           code_str.push_back(';');
         }
-        code_str.append(std::to_string(codes[i]));
+        std::format_to(std::back_inserter(code_str), "{}", codes[i]);
       }
       code_str.push_back('m');
       return code_str;
@@ -0,0 +1,121 @@
+module;
+#include <algorithm>
+#include <concepts>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <utility>
+#include <vector>
+export module jowi.cli:work_pool;
+
+namespace jowi::cli {
+  /*
+    WorkStealingPool
+    runs the independent tasks 0 to n - 1 on a fixed set of threads, f(worker, task) being called
+    once per task. Every worker starts with a contiguous share of the tasks and takes them from
+    its front; a worker running out steals the back half of the largest share left, such that a
+    few long tasks do not keep the other threads idle. f must not throw. The destructor waits for
+    every task.
+  */
+  export struct WorkStealingPool {
+  private:
+    struct alignas(64) Share {
+      std::mutex m;
+      uint64_t beg;
+      uint64_t end;
+    };
+
+    std::function<void(uint64_t, uint64_t)> __f;
+    std::unique_ptr<Share[]> __shares;
+    uint64_t __workers;
+    std::vector<std::jthread> __threads;
+
+    std::optional<uint64_t> __pop(uint64_t w) {
+      std::scoped_lock lock{__shares[w].m};
+      auto &share = __shares[w];
+      if (share.beg == share.end) {
+        return std::nullopt;
+      }
+      return share.beg++;
+    }
+
+    // moves the back half of the largest share to w, false once every share is empty
+    bool __steal(uint64_t w) {
+      while (true) {
+        uint64_t victim = w;
+        uint64_t most = 0;
+        for (uint64_t i = 0; i != __workers; i += 1) {
+          std::scoped_lock lock{__shares[i].m};
+          if (__shares[i].end - __shares[i].beg > most) {
+            most = __shares[i].end - __shares[i].beg;
+            victim = i;
+          }
+        }
+        if (most == 0) {
+          return false;
+        }
+        std::scoped_lock lock{__shares[victim].m, __shares[w].m};
+        auto &from = __shares[victim];
+        uint64_t left = from.end - from.beg;
+        // the victim may have drained its share meanwhile, look again
+        if (left == 0) {
+          continue;
+        }
+        uint64_t mid = from.end - (left + 1) / 2;
+        __shares[w].beg = mid;
+        __shares[w].end = from.end;
+        from.end = mid;
+        return true;
+      }
+    }
+
+    void __work(uint64_t w) {
+      while (true) {
+        if (auto task = __pop(w)) {
+          __f(w, *task);
+        } else if (!__steal(w)) {
+          return;
+        }
+      }
+    }
+
+  public:
+    /*
+      WorkStealingPool
+      starts workers threads (at least one, at most one per task) running the n tasks.
+    */
+    template <std::invocable<uint64_t, uint64_t> F>
+    WorkStealingPool(uint64_t n, uint64_t workers, F &&f) :
+      __f{std::forward<F>(f)}, __shares{},
+      __workers{std::clamp<uint64_t>(workers, 1, std::max<uint64_t>(n, 1))}, __threads{} {
+      __shares = std::make_unique<Share[]>(__workers);
+      for (uint64_t w = 0; w != __workers; w += 1) {
+        __shares[w].beg = n * w / __workers;
+        __shares[w].end = n * (w + 1) / __workers;
+      }
+      __threads.reserve(__workers);
+      for (uint64_t w = 0; w != __workers; w += 1) {
+        __threads.emplace_back([this, w]() { __work(w); });
+      }
+    }
+    WorkStealingPool(const WorkStealingPool &) = delete;
+    WorkStealingPool &operator=(const WorkStealingPool &) = delete;
+    ~WorkStealingPool() {
+      join();
+    }
+
+    uint64_t workers() const noexcept {
+      return __workers;
+    }
+    void join() {
+      for (auto &t : __threads) {
+        if (t.joinable()) {
+          t.join();
+        }
+      }
+    }
+  };
+}
@@ -0,0 +1,162 @@
+import jowi.test_lib;
+import jowi.crogger;
+import jowi.cli;
+import jowi.tui;
+import jowi.alloc_tracker;
+
+namespace crogger = jowi::crogger;
+namespace cli = jowi::cli;
+namespace tui = jowi::tui;
+namespace test_lib = jowi::test_lib;
+namespace alloc_tracker = jowi::alloc_tracker;
+
+#include <jowi/test_lib.hpp>
+#include <cstdint>
+#include <format>
+#include <iterator>
+#include <span>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+JOWI_ADD_TEST(test_scope_counts_allocations) {
+  auto size = static_cast<size_t>(test_lib::random_integer(100, 1000));
+  alloc_tracker::AllocScope scope;
+  {
+    std::string s(size, 'a');
+    test_lib::assert_equal(scope.stats().allocations, uint64_t{1});
+    test_lib::assert_equal(scope.stats().deallocations, uint64_t{0});
+  }
+  auto stats = scope.stats();
+  test_lib::assert_equal(stats.allocations, uint64_t{1});
+  test_lib::assert_equal(stats.deallocations, uint64_t{1});
+  test_lib::assert_true(stats.bytes > size);
+  test_lib::assert_equal(stats.peak, stats.bytes);
+}
+
+JOWI_ADD_TEST(test_nested_scope_peak) {
+  alloc_tracker::AllocScope outer;
+  { std::vector<char> v(4096); }
+  {
+    alloc_tracker::AllocScope inner;
+    std::vector<char> v(64);
+    test_lib::assert_true(inner.stats().peak < 4096);
+  }
+  test_lib::assert_true(outer.stats().peak >= 4096);
+  test_lib::assert_equal(outer.stats().allocations, uint64_t{2});
+}
+
+JOWI_ADD_TEST(test_other_threads_are_not_counted) {
+  alloc_tracker::AllocScope scope;
+  uint64_t worker_allocations = 0;
+  std::jthread worker{[&]() {
+    alloc_tracker::AllocScope worker_scope;
+    std::vector<std::string> v(16, std::string(100, 'a'));
+    worker_allocations = worker_scope.stats().allocations;
+  }};
+  worker.join();
+  test_lib::assert_true(worker_allocations > 16);
+  test_lib::assert_true(scope.stats().allocations < worker_allocations);
+}
+
+JOWI_ADD_TEST(test_bounded_record_is_allocation_free) {
+  crogger::Logger logger;
+  logger.set_formatter(crogger::PlainFormatter{});
+  logger.set_emitter(crogger::EmptyEmitter{});
+  logger.set_record_limit(256);
+  auto msg = test_lib::random_string(80);
+  crogger::info(logger, crogger::Message{"{} - {}", 0, msg});
+
+  alloc_tracker::AllocScope scope;
+  for (int i = 0; i != 1000; i += 1) {
+    crogger::info(logger, crogger::Message{"{} - {}", i, msg});
+  }
+  test_lib::assert_true(scope.stats().allocation_free());
+}
+
+JOWI_ADD_TEST(test_bounded_colorful_record_is_allocation_free) {
+  crogger::Logger logger;
+  logger.set_formatter(crogger::ColorfulFormatter{});
+  logger.set_emitter(crogger::EmptyEmitter{});
+  logger.set_record_limit(256);
+  auto msg = test_lib::random_string(80);
+  crogger::info(logger, crogger::Message{"{} - {}", 0, msg});
+
+  alloc_tracker::AllocScope scope;
+  for (int i = 0; i != 1000; i += 1) {
+    crogger::info(logger, crogger::Message{"{} - {}", i, msg});
+  }
+  test_lib::assert_true(scope.stats().allocation_free());
+}
+
+JOWI_ADD_TEST(test_unbounded_record_allocates) {
+  crogger::Logger logger;
+  logger.set_formatter(crogger::PlainFormatter{});
+  logger.set_emitter(crogger::EmptyEmitter{});
+  auto msg = test_lib::random_string(80);
+
+  alloc_tracker::AllocScope scope;
+  for (int i = 0; i != 1000; i += 1) {
+    crogger::info(logger, crogger::Message{"{} - {}", i, msg});
+  }
+  test_lib::assert_true(scope.stats().allocations >= 1000);
+}
+
+JOWI_ADD_TEST(test_arg_declaration_is_allocation_free) {
+  alloc_tracker::AllocScope scope;
+  auto arg = cli::Arg::positional();
+  arg.require_value().n_at_most(4).optional();
+  test_lib::assert_equal(arg.size(), 2);
+  test_lib::assert_true(scope.stats().allocation_free());
+}
+
+JOWI_ADD_TEST(test_reset_parse_is_allocation_free) {
+  cli::ArgParser parser;
+  parser.add_argument("--name").require_value();
+  parser.add_argument("-n").require_value().n_at_most(4);
+  cli::ShellLexer lexer;
+  std::string line;
+  line.reserve(64);
+  cli::ParsedArg args{std::span<const std::string_view>{}};
+  auto parse_line = [&](std::string_view command) {
+    line.assign(command);
+    auto tokens = lexer.split(line);
+    test_lib::assert_expected(tokens);
+    args.reset(tokens.value());
+    test_lib::assert_expected(parser.parse(args));
+  };
+  parse_line("set --name 'a b' -n 1 -n 2 -n 3");
+
+  alloc_tracker::AllocScope scope;
+  for (int i = 0; i != 100; i += 1) {
+    parse_line(i % 2 == 0 ? "get -n 1" : "set --name \"c d\" -n 1 -n 2");
+  }
+  test_lib::assert_true(scope.stats().allocation_free());
+}
+
+JOWI_ADD_TEST(test_render_dom_is_allocation_free) {
+  auto entries = tui::Layout{}.style(
+    tui::DomStyle{}.indent(2).effect(tui::TextEffect::BOLD).fg(tui::RgbColor::green())
+  );
+  for (int i = 0; i != 16; i += 1) {
+    auto help = test_lib::random_string(40);
+    entries.append_child(tui::DomNode::paragraph("- option {}: {}", i, help));
+  }
+  auto layout = tui::Layout{}.style(tui::DomStyle{}.fg(tui::RgbColor::bright_white()));
+  layout.append_child(tui::DomNode::paragraph("Options:"));
+  layout.append_child(tui::DomNode::vstack(std::move(entries)));
+  auto dom = tui::DomNode::vstack(std::move(layout));
+  std::string out;
+  std::format_to(std::back_inserter(out), "{}", dom);
+  auto size = out.size();
+
+  // styled layouts included, only growing the output would allocate
+  alloc_tracker::AllocScope scope;
+  for (int i = 0; i != 10; i += 1) {
+    out.clear();
+    std::format_to(std::back_inserter(out), "{}", dom);
+  }
+  test_lib::assert_equal(out.size(), size);
+  test_lib::assert_true(scope.stats().allocation_free());
+}
@@ -0,0 +1,75 @@
+import jowi.test_lib;
+import jowi.cli;
+
+namespace cli = jowi::cli;
+namespace test_lib = jowi::test_lib;
+
+#include <jowi/test_lib.hpp>
+#include <array>
+#include <optional>
+#include <string_view>
+
+struct Config {
+  std::string_view name = "none";
+  int level = 3;
+  bool verbose = false;
+  std::optional<double> ratio;
+  cli::ArgValues<std::string_view, 4> tags;
+  std::string_view mode = "fast";
+  std::string_view input;
+  std::optional<std::string_view> output;
+};
+
+using ConfigSpec = cli::ArgSpec<
+  Config,
+  cli::Param<"--name", &Config::name, cli::ParamRules::required()>,
+  cli::Param<"--level", &Config::level>,
+  cli::Param<"-v", &Config::verbose>,
+  cli::Param<"--ratio", &Config::ratio>,
+  cli::Param<"--tag", &Config::tags>,
+  cli::Param<"--mode", &Config::mode, cli::ParamRules{}, "fast", "slow">,
+  cli::Positional<&Config::input>,
+  cli::Positional<&Config::output>>;
+
+JOWI_ADD_TEST(test_spec_fills_typed_struct) {
+  std::array argv = {"some_exec", "in.txt", "--name=x", "--level", "7", "-v",
+                     "--tag",     "a",      "--tag=b",  "--mode",  "slow"};
+  auto res = ConfigSpec::parse(argv.size(), argv.data());
+  test_lib::assert_expected(res);
+  auto config = res.value();
+  test_lib::assert_true(config.name == "x");
+  test_lib::assert_true(config.name.data() == argv[2] + 7);
+  test_lib::assert_equal(config.level, 7);
+  test_lib::assert_true(config.verbose);
+  test_lib::assert_false(config.ratio.has_value());
+  test_lib::assert_equal(config.tags.size(), 2);
+  test_lib::assert_true(config.tags[0] == "a" && config.tags[1] == "b");
+  test_lib::assert_true(config.mode == "slow");
+  test_lib::assert_true(config.input == "in.txt");
+  test_lib::assert_false(config.output.has_value());
+}
+
+JOWI_ADD_TEST(test_spec_keeps_defaults) {
+  std::array argv = {"some_exec", "in.txt", "out.txt", "--name", "x"};
+  auto res = ConfigSpec::parse(argv.size(), argv.data());
+  test_lib::assert_expected(res);
+  test_lib::assert_equal(res->level, 3);
+  test_lib::assert_true(res->mode == "fast");
+  test_lib::assert_true(res->output == "out.txt");
+}
+
+JOWI_ADD_TEST(test_spec_rejects_invalid_arguments) {
+  std::array missing = {"some_exec", "in.txt"};
+  test_lib::assert_false(ConfigSpec::parse(missing.size(), missing.data()).has_value());
+  std::array option = {"some_exec", "in.txt", "--name=x", "--mode=medium"};
+  test_lib::assert_false(ConfigSpec::parse(option.size(), option.data()).has_value());
+  std::array number = {"some_exec", "in.txt", "--name=x", "--level=high"};
+  test_lib::assert_false(ConfigSpec::parse(number.size(), number.data()).has_value());
+  std::array unknown = {"some_exec", "in.txt", "--name=x", "--bogus"};
+  test_lib::assert_false(ConfigSpec::parse(unknown.size(), unknown.data()).has_value());
+  std::array full = {"some_exec", "in.txt", "--name=x", "--tag=1", "--tag=2", "--tag=3", "--tag=4",
+                     "--tag=5"};
+  auto res = ConfigSpec::parse(full.size(), full.data());
+  test_lib::assert_false(res.has_value());
+  test_lib::assert_true(res.error().err_type() == cli::ParseErrorType::TOO_MANY_VALUE_GIVEN);
+}
@@ -5,7 +5,22 @@ namespace cli = jowi::cli;
 namespace test_lib = jowi::test_lib;
 
 #include <jowi/test_lib.hpp>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
 #include <array>
+#include <cstdint>
+#include <cstring>
+#include <expected>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <optional>
+#include <print>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
 
 static auto app_id = cli::AppIdentity{.name = "Random App", .version = cli::AppVersion{0, 0, 0}};
 
@@ -88,4 +103,375 @@ JOWI_ADD_TEST(test_required_imply_single_arg) {
   app.add_argument("-v").required();
   auto res = app.parse_args(false, false);
   test_lib::assert_false(res.has_value());
-}
\ No newline at end of file
+}
+JOWI_ADD_TEST(test_profile_startup_is_hidden) {
+  std::array argv = {"some_exec", "--profile-startup=json", "-v", "1"};
+  auto app = cli::App{app_id, argv.size(), argv.data()};
+  test_lib::assert_true(cli::StartupProfiler::active() != nullptr);
+  app.add_argument("-v").required();
+  auto res = app.parse_args(false, false);
+  test_lib::assert_expected(res);
+  test_lib::assert_true(app.args().contains("--profile-startup"));
+  auto help = std::format("{}", app.help_dom());
+  test_lib::assert_true(help.find("--profile-startup") == std::string::npos);
+}
+
+JOWI_ADD_TEST(test_profiler_merges_repeated_phases) {
+  cli::StartupProfiler profiler{true};
+  profiler.step("parse");
+  for (int i = 0; i != 3; i += 1) {
+    profiler.begin("validate", "-v");
+    profiler.end();
+  }
+  profiler.step("run");
+  profiler.finish();
+  auto json = profiler.json();
+  test_lib::assert_true(json.starts_with("{\"name\":\"startup\""));
+  test_lib::assert_true(json.find("{\"name\":\"validate -v\"") != std::string::npos);
+  test_lib::assert_true(json.find("\"calls\":3") != std::string::npos);
+  test_lib::assert_true(json.find("{\"name\":\"run\"") != std::string::npos);
+}
+
+// the nesting depth of every phase named label in a profile as given by StartupProfiler::json
+static std::vector<uint64_t> phase_depths(std::string_view json, std::string_view label) {
+  std::vector<uint64_t> depths;
+  auto needle = std::string{"{\"name\":\""}.append(label).append("\"");
+  uint64_t depth = 0;
+  for (uint64_t i = 0; i != json.size(); i += 1) {
+    if (json[i] == '[') {
+      depth += 1;
+    } else if (json[i] == ']') {
+      depth -= 1;
+    } else if (json.substr(i).starts_with(needle)) {
+      depths.emplace_back(depth);
+    }
+  }
+  return depths;
+}
+
+JOWI_ADD_TEST(test_steps_replace_each_other) {
+  cli::StartupProfiler profiler{true};
+  profiler.step("declare");
+  profiler.begin("add_argument");
+  profiler.end();
+  profiler.step("parse");
+  profiler.step("run");
+  profiler.finish();
+  auto json = profiler.json();
+  test_lib::assert_true(phase_depths(json, "declare") == std::vector<uint64_t>{1});
+  test_lib::assert_true(phase_depths(json, "add_argument") == std::vector<uint64_t>{2});
+  test_lib::assert_true(phase_depths(json, "parse") == std::vector<uint64_t>{1});
+  test_lib::assert_true(phase_depths(json, "run") == std::vector<uint64_t>{1});
+}
+
+JOWI_ADD_TEST(test_nested_builder_steps_stay_inside_the_action) {
+  std::array argv = {"some_exec", "--profile-startup", "remote", "add", "--url", "x"};
+  auto app = cli::App{app_id, argv.size(), argv.data()};
+  auto *profiler = cli::StartupProfiler::active();
+  test_lib::assert_true(profiler != nullptr);
+  std::string added;
+  cli::ActionBuilder builder{app, "command"};
+  builder.add_group("remote", "manages remotes", [&](cli::ActionBuilder &remote) {
+    remote.add_action("add", "adds a remote", [&](cli::App &app) {
+      app.add_argument("--url").required();
+      app.parse_args();
+      added = app.args().first_of("--url").value();
+    });
+  });
+  builder.run();
+  test_lib::assert_true(added == "x");
+
+  // startup > run > action remote > run > action add > run, each parse beside its run
+  auto json = profiler->json();
+  test_lib::assert_true(phase_depths(json, "action remote") == std::vector<uint64_t>{2});
+  test_lib::assert_true(phase_depths(json, "action add") == std::vector<uint64_t>{4});
+  test_lib::assert_true(phase_depths(json, "parse") == std::vector<uint64_t>{1, 3, 5});
+  test_lib::assert_true(phase_depths(json, "run") == std::vector<uint64_t>{1, 3, 5});
+
+  // the actions are closed, the outer run step is the innermost open phase again
+  test_lib::assert_equal(profiler->depth(), uint64_t{2});
+}
+
+JOWI_ADD_TEST(test_many_keyword_arguments) {
+  std::vector<std::string> tokens{"some_exec"};
+  for (int i = 0; i != 500; i += 1) {
+    tokens.emplace_back(std::format("--key{}={}", i, i));
+    tokens.emplace_back(std::format("--key{}={}", i, i + 1));
+  }
+  std::vector<const char *> argv;
+  for (const auto &token : tokens) {
+    argv.emplace_back(token.c_str());
+  }
+  auto app = cli::App{app_id, static_cast<int>(argv.size()), argv.data()};
+  for (int i = 0; i != 500; i += 1) {
+    app.add_argument(std::format("--key{}", i)).require_value().n_equal_to(2);
+  }
+  auto res = app.parse_args(false, false);
+  test_lib::assert_expected(res);
+  test_lib::assert_equal(app.args().count("--key42"), 2);
+  test_lib::assert_true(app.args().first_of("--key42") == "42");
+  test_lib::assert_false(app.args().contains("--key500"));
+}
+
+JOWI_ADD_TEST(test_redeclared_key_replaces_arg) {
+  std::array argv = {"some_exec", "-v", "1", "-v", "2"};
+  auto app = cli::App{app_id, argv.size(), argv.data()};
+  app.add_argument("-v").required();
+  app.add_argument("-v").require_value().n_equal_to(2);
+  auto res = app.parse_args(false, false);
+  test_lib::assert_expected(res);
+  test_lib::assert_equal(app.args().count("-v"), 2);
+}
+
+// rejects one value, declares no id such that every instance is kept
+struct RejectValue {
+  std::string_view rejected;
+
+  std::expected<void, cli::ParseError> validate(std::optional<std::string_view> value) const {
+    if (value == rejected) {
+      return std::unexpected{cli::ParseError::invalid_value("{} is rejected", rejected)};
+    }
+    return {};
+  }
+};
+
+struct RejectValueOnce : RejectValue {
+  static constexpr std::string_view id = "RejectValueOnce";
+};
+
+JOWI_ADD_TEST(test_validators_replace_only_by_id) {
+  auto parse = [](std::string_view value, auto... validators) {
+    std::array argv = {"some_exec", "-v", value.data()};
+    auto app = cli::App{app_id, argv.size(), argv.data()};
+    app.add_argument("-v").require_value().add_validators(validators...);
+    return app.parse_args(false, false).has_value();
+  };
+  test_lib::assert_false(parse("a", RejectValue{"a"}, RejectValue{"b"}));
+  test_lib::assert_false(parse("b", RejectValue{"a"}, RejectValue{"b"}));
+  test_lib::assert_true(parse("a", RejectValueOnce{{"a"}}, RejectValueOnce{{"b"}}));
+  test_lib::assert_false(parse("b", RejectValueOnce{{"a"}}, RejectValueOnce{{"b"}}));
+}
+
+JOWI_ADD_TEST(test_default_outlives_later_declarations) {
+  std::array argv = {"some_exec"};
+  auto app = cli::App{app_id, argv.size(), argv.data()};
+  app.add_argument("--a").require_value().with_default("short");
+  auto res = app.parse_args(false, false);
+  test_lib::assert_expected(res);
+  // the declarations grow and move, the parsed default points at none of them
+  for (int i = 0; i != 200; i += 1) {
+    app.add_argument(std::format("--key{}", i)).with_default(i);
+  }
+  test_lib::assert_true(app.args().first_of("--a") == "short");
+}
+
+JOWI_ADD_TEST(test_filter_returns_values_in_order) {
+  std::array argv = {"some_exec", "-a", "1", "-b", "x", "-a", "2", "-b", "y", "-a", "3"};
+  auto app = cli::App{app_id, argv.size(), argv.data()};
+  app.add_argument("-a").require_value();
+  app.add_argument("-b").require_value();
+  app.add_argument("-c").require_value();
+  auto res = app.parse_args(false, false);
+  test_lib::assert_expected(res);
+  auto a = app.args().filter("-a");
+  test_lib::assert_equal(a.size(), 3);
+  test_lib::assert_true(a[0] == "1" && a[1] == "2" && a[2] == "3");
+  auto b = app.args().filter("-b");
+  test_lib::assert_equal(b.size(), 2);
+  test_lib::assert_true(b[0] == "x" && b[1] == "y");
+  test_lib::assert_true(app.args().filter("-c").empty());
+}
+
+JOWI_ADD_TEST(test_values_point_into_argv) {
+  std::array argv = {"some_exec", "--name=crogger", "--level", "10"};
+  auto app = cli::App{app_id, argv.size(), argv.data()};
+  app.add_argument("--name").require_value();
+  app.add_argument("--level").require_value();
+  auto res = app.parse_args(false, false);
+  test_lib::assert_expected(res);
+  test_lib::assert_true(app.args().first_of("--name")->data() == argv[1] + 7);
+  test_lib::assert_true(app.args().first_of("--level")->data() == argv[3]);
+  test_lib::assert_false(app.args().contains("--undeclared"));
+}
+
+JOWI_ADD_TEST(test_parse_command_lines) {
+  cli::ArgParser parser;
+  parser.add_argument("--name").require_value();
+  parser.add_argument("-n").require_value().n_at_most(2);
+  cli::ShellLexer lexer;
+  std::string line = "set --name 'hello world' -n 1 -n \"2\"";
+  auto tokens = lexer.split(line);
+  test_lib::assert_expected(tokens);
+  test_lib::assert_equal(tokens->size(), 7);
+  cli::ParsedArg args{tokens.value()};
+  test_lib::assert_expected(parser.parse(args));
+  test_lib::assert_true(args.first_of("--name") == "hello world");
+  test_lib::assert_equal(args.filter("-n").size(), 2);
+
+  line = "get -n 3";
+  tokens = lexer.split(line);
+  test_lib::assert_expected(tokens);
+  args.reset(tokens.value());
+  test_lib::assert_expected(parser.parse(args));
+  test_lib::assert_true(args.arg() == "get");
+  test_lib::assert_false(args.contains("--name"));
+  test_lib::assert_true(args.first_of("-n") == "3");
+
+  line = "set --name 'unterminated";
+  test_lib::assert_false(lexer.split(line).has_value());
+}
+
+JOWI_ADD_TEST(test_rollback_restores_redeclared_keys) {
+  cli::ArgParser parser;
+  parser.add_argument("--x").require_value();
+  auto cp = parser.checkpoint();
+  for (int i = 0; i != 2; i += 1) {
+    parser.add_argument("--x");
+    parser.add_argument("--x").require_value().n_at_most(1);
+    parser.add_argument("--y");
+    parser.rollback(cp);
+  }
+  test_lib::assert_equal(parser.param_size(), 1);
+  std::array<std::string_view, 3> with_value = {"some_exec", "--x", "1"};
+  auto args = parser.parse(std::span<const std::string_view>{with_value});
+  test_lib::assert_expected(args);
+  test_lib::assert_true(args->first_of("--x") == "1");
+  // --x requires a value again, the flag declared after the checkpoint is gone
+  std::array<std::string_view, 2> as_flag = {"some_exec", "--x"};
+  test_lib::assert_false(parser.parse(std::span<const std::string_view>{as_flag}).has_value());
+}
+
+JOWI_ADD_TEST(test_listen_keeps_a_live_socket) {
+  auto path = std::filesystem::temp_directory_path() /
+    std::format("cli_listen_test.{}", test_lib::random_string(8));
+  {
+    auto first = cli::CommandSource::listen(path);
+    test_lib::assert_expected(first);
+    // a second server fails instead of unlinking the socket the first one listens on
+    test_lib::assert_false(cli::CommandSource::listen(path).has_value());
+    test_lib::assert_true(std::filesystem::is_socket(path));
+  }
+  // a socket file left by a server which is gone is replaced
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  sockaddr_un addr{};
+  addr.sun_family = AF_UNIX;
+  std::memcpy(addr.sun_path, path.c_str(), path.native().size());
+  test_lib::assert_equal(bind(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)), 0);
+  close(fd);
+  test_lib::assert_true(std::filesystem::is_socket(path));
+  test_lib::assert_expected(cli::CommandSource::listen(path));
+  test_lib::assert_false(std::filesystem::exists(path));
+}
+
+JOWI_ADD_TEST(test_serve_runs_each_command) {
+  auto path = std::filesystem::temp_directory_path() /
+    std::format("cli_serve_test.{}", test_lib::random_string(8));
+  {
+    std::ofstream f{path};
+    f << "add --x 1\n\nlist --x 5\nbogus\nadd --x 'not a number'\nadd --x 2\n";
+  }
+  std::array argv = {"some_exec"};
+  auto app = cli::App{app_id, argv.size(), argv.data()};
+  std::vector<int> added;
+  uint64_t listed_with_x = 0;
+  cli::ActionBuilder builder{app, "command"};
+  builder.add_action("add", "adds x", [&](cli::App &app) {
+    app.add_argument("--x").required();
+    app.parse_args();
+    added.emplace_back(cli::App::expect(cli::parse_arg<int>(app.args().first_of("--x").value())));
+  });
+  builder.add_action("list", "lists", [&](cli::App &app) {
+    app.parse_args();
+    // --x was declared by the add command only
+    listed_with_x += app.args().contains("--x");
+  });
+  auto source = cli::CommandSource::open(path);
+  test_lib::assert_expected(source);
+  auto code = builder.serve(source.value());
+  test_lib::assert_equal(code, 0);
+  test_lib::assert_equal(added.size(), 2);
+  test_lib::assert_true(added[0] == 1 && added[1] == 2);
+  test_lib::assert_equal(listed_with_x, 0);
+  std::filesystem::remove(path);
+}
+
+JOWI_ADD_TEST(test_batch_collates_output_in_order) {
+  auto path = std::filesystem::temp_directory_path() /
+    std::format("cli_batch_test.{}", test_lib::random_string(8));
+  std::string expected;
+  {
+    std::ofstream f{path};
+    for (int i = 0; i != 40; i += 1) {
+      f << std::format("echo --x {}\n", i);
+      expected += std::format("{}\n", i);
+    }
+    f << "fail --x 3\nfail --x 4\n";
+  }
+  std::array argv = {"some_exec"};
+  auto app = cli::App{app_id, argv.size(), argv.data()};
+  cli::ActionBuilder builder{app, "command"};
+  builder.add_action("echo", "prints x", [](cli::App &app) {
+    app.add_argument("--x").required();
+    app.parse_args();
+    std::print(cli::App::out(), "{}\n", app.args().first_of("--x").value());
+  });
+  builder.add_action("fail", "exits with x", [](cli::App &app) {
+    app.add_argument("--x").required();
+    app.parse_args();
+    cli::App::exit(cli::App::expect(cli::parse_arg<int>(app.args().first_of("--x").value())));
+  });
+  std::string out;
+  int code;
+  {
+    auto source = cli::CommandSource::open(path);
+    test_lib::assert_expected(source);
+    cli::AppCapture capture;
+    code = builder.batch(source.value(), 4);
+    out = capture.out();
+  }
+  test_lib::assert_equal(code, 3);
+  test_lib::assert_true(out == expected);
+
+  // a line naming no action stops the batch before any command runs
+  {
+    std::ofstream f{path};
+    f << "echo --x 1\nbogus\n";
+  }
+  {
+    auto source = cli::CommandSource::open(path);
+    test_lib::assert_expected(source);
+    cli::AppSession session{app};
+    cli::AppCapture capture;
+    code = session.run([&](cli::App &) { builder.batch(source.value(), 4); });
+    out = capture.out();
+  }
+  test_lib::assert_equal(code, 1);
+  test_lib::assert_true(out.empty());
+  std::filesystem::remove(path);
+}
+
+JOWI_ADD_TEST(test_nested_groups_declare_lazily) {
+  std::array argv = {"some_exec", "remote", "add", "--url", "x"};
+  auto app = cli::App{app_id, argv.size(), argv.data()};
+  uint64_t remote_declared = 0;
+  uint64_t branch_declared = 0;
+  std::string added;
+  cli::ActionBuilder builder{app, "command"};
+  builder.add_action("status", "shows status", [](cli::App &) {});
+  builder.add_group("remote", "manages remotes", [&](cli::ActionBuilder &remote) {
+    remote_declared += 1;
+    remote.add_action("add", "adds a remote", [&](cli::App &app) {
+      app.add_argument("--url").required();
+      app.parse_args();
+      added = app.args().first_of("--url").value();
+    });
+    remote.add_action("remove", "removes a remote", [](cli::App &) {});
+  });
+  builder.add_group("branch", "manages branches", [&](cli::ActionBuilder &) {
+    branch_declared += 1;
+  });
+  builder.run();
+  test_lib::assert_equal(remote_declared, 1);
+  test_lib::assert_equal(branch_declared, 0);
+  test_lib::assert_true(added == "x");
+}
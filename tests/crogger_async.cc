@@ -0,0 +1,97 @@
+import jowi.test_lib;
+import jowi.crogger;
+
+namespace crogger = jowi::crogger;
+namespace test_lib = jowi::test_lib;
+
+#include <jowi/test_lib.hpp>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+
+static std::filesystem::path test_log_path() {
+  return std::filesystem::temp_directory_path() /
+    std::format("crogger_async_test.{}", test_lib::random_string(8));
+}
+
+static size_t count_lines(const std::filesystem::path &path) {
+  std::ifstream f{path};
+  size_t count = 0;
+  for (std::string line; std::getline(f, line);) {
+    count += 1;
+  }
+  return count;
+}
+
+crogger::Task<int> add(int a, int b) {
+  co_return a + b;
+}
+
+JOWI_ADD_TEST(test_executor_runs_tasks) {
+  crogger::Executor ex;
+  int sum = 0;
+  ex.spawn([](crogger::Executor &ex, int &sum) -> crogger::Task<void> {
+    sum = co_await add(1, 2);
+    co_await ex.yield();
+    sum += co_await add(3, 4);
+  }(ex, sum));
+  ex.run();
+  test_lib::assert_equal(sum, 10);
+
+  ex.spawn([]() -> crogger::Task<void> {
+    throw std::runtime_error{"task failed"};
+    co_return;
+  }());
+  bool thrown = false;
+  try {
+    ex.run();
+  } catch (const std::runtime_error &) {
+    thrown = true;
+  }
+  test_lib::assert_true(thrown);
+}
+
+JOWI_ADD_TEST(test_flush_waits_for_async_file) {
+  auto path = test_log_path();
+  auto emitter = crogger::AsyncFileEmitter::open(path, false);
+  test_lib::assert_expected(emitter);
+  crogger::Logger logger;
+  logger.set_formatter(crogger::PlainFormatter{});
+  logger.set_emitter(std::move(emitter.value()));
+
+  crogger::Executor ex;
+  for (int t = 0; t != 4; t += 1) {
+    ex.spawn([](crogger::Executor &ex, const crogger::Logger &logger, int t,
+                const std::filesystem::path &path) -> crogger::Task<void> {
+      for (int i = 0; i != 250; i += 1) {
+        crogger::info(logger, crogger::Message{"task {} record {}", t, i});
+        if (i % 50 == 0) {
+          co_await ex.yield();
+        }
+      }
+      auto res = co_await logger.flush();
+      test_lib::assert_expected(res);
+      test_lib::assert_true(crogger::Executor::current() == &ex);
+      // at least the records of this task are in the file once the flush resumed
+      test_lib::assert_true(count_lines(path) >= 250);
+    }(ex, logger, t, path));
+  }
+  ex.run();
+  test_lib::assert_equal(count_lines(path), size_t{1000});
+  std::filesystem::remove(path);
+}
+
+JOWI_ADD_TEST(test_flush_without_buffer_completes) {
+  crogger::Logger logger;
+  logger.set_emitter(crogger::EmptyEmitter{});
+  crogger::Executor ex;
+  bool flushed = false;
+  ex.spawn([](const crogger::Logger &logger, bool &flushed) -> crogger::Task<void> {
+    auto res = co_await logger.flush();
+    flushed = res.has_value();
+  }(logger, flushed));
+  ex.run();
+  test_lib::assert_true(flushed);
+}
@@ -0,0 +1,29 @@
+import jowi.test_lib;
+import jowi.crogger;
+
+namespace crogger = jowi::crogger;
+namespace test_lib = jowi::test_lib;
+
+#include <jowi/test_lib.hpp>
+#include <chrono>
+#include <thread>
+
+JOWI_ADD_TEST(test_tsc_clock_follows_system_clock) {
+  crogger::TscClock clock{std::chrono::milliseconds{20}};
+  std::this_thread::sleep_for(std::chrono::milliseconds{100});
+  for (int i = 0; i != 1000; i += 1) {
+    auto before = std::chrono::system_clock::now();
+    auto t = clock.now();
+    auto after = std::chrono::system_clock::now();
+    test_lib::assert_true(t > before - std::chrono::milliseconds{5});
+    test_lib::assert_true(t < after + std::chrono::milliseconds{5});
+  }
+}
+
+JOWI_ADD_TEST(test_logger_uses_clock) {
+  crogger::Logger logger;
+  logger.set_clock(crogger::TscClock{});
+  auto before = std::chrono::system_clock::now();
+  auto t = logger.now();
+  test_lib::assert_true(t > before - std::chrono::milliseconds{5});
+}
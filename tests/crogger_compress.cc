@@ -0,0 +1,117 @@
+import jowi.test_lib;
+import jowi.crogger;
+
+namespace crogger = jowi::crogger;
+namespace test_lib = jowi::test_lib;
+
+#include <jowi/test_lib.hpp>
+#include <cstdint>
+#include <filesystem>
+#include <format>
+#include <string>
+#include <string_view>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+static std::string log_lines(unsigned count) {
+  std::string lines;
+  for (unsigned i = 0; i != count; i += 1) {
+    lines.append(std::format("[INFO] 2025-01-01T00:00:{:02}Z request {} handled\n", i % 60, i));
+  }
+  return lines;
+}
+
+JOWI_ADD_TEST(test_compress_round_trip) {
+  auto raw = log_lines(2000);
+  crogger::BlockCompressor compressor;
+  std::string packed;
+  compressor.compress(raw, packed);
+  test_lib::assert_true(packed.size() < raw.size() / 3);
+  std::string unpacked;
+  test_lib::assert_expected(crogger::decompress_block(packed, raw.size(), unpacked));
+  test_lib::assert_true(unpacked == raw);
+}
+
+JOWI_ADD_TEST(test_compress_random_round_trip) {
+  auto raw = test_lib::random_string(10000);
+  crogger::BlockCompressor compressor;
+  std::string packed;
+  compressor.compress(raw, packed);
+  test_lib::assert_true(packed.size() <= crogger::BlockCompressor::max_compressed_size(raw.size()));
+  std::string unpacked;
+  test_lib::assert_expected(crogger::decompress_block(packed, raw.size(), unpacked));
+  test_lib::assert_true(unpacked == raw);
+}
+
+JOWI_ADD_TEST(test_decompress_truncated_block) {
+  auto raw = log_lines(100);
+  crogger::BlockCompressor compressor;
+  std::string packed;
+  compressor.compress(raw, packed);
+  std::string unpacked;
+  auto res = crogger::decompress_block(
+    std::string_view{packed}.substr(0, packed.size() / 2), raw.size(), unpacked
+  );
+  test_lib::assert_false(res.has_value());
+}
+
+static fs::path compressed_path(std::string_view name) {
+  return fs::temp_directory_path() / std::format("jowi_crogger_{}_{}.lz", name, ::getpid());
+}
+
+// writes raw one line per record through a CompressedFileEmitter of 4 KiB blocks
+static void write_compressed(const fs::path &path, std::string_view raw) {
+  auto emitter = crogger::CompressedFileEmitter::open(path, false, 4096);
+  test_lib::assert_expected(emitter);
+  while (!raw.empty()) {
+    auto line = raw.substr(0, raw.find('\n') + 1);
+    test_lib::assert_expected(emitter->emit(line));
+    raw.remove_prefix(line.size());
+  }
+}
+
+// every block the reader yields, concatenated
+static std::string read_compressed(const fs::path &path) {
+  auto reader = crogger::BlockReader::open(path);
+  test_lib::assert_expected(reader);
+  std::string raw;
+  while (true) {
+    auto block = reader->next();
+    test_lib::assert_expected(block);
+    if (!block->has_value()) break;
+    raw.append(block->value());
+  }
+  return raw;
+}
+
+JOWI_ADD_TEST(test_compressed_emitter_round_trip) {
+  auto path = compressed_path("round_trip");
+  auto raw = log_lines(2000);
+  write_compressed(path, raw);
+  test_lib::assert_true(fs::file_size(path) < raw.size() / 3);
+  test_lib::assert_true(read_compressed(path) == raw);
+  fs::remove(path);
+}
+
+JOWI_ADD_TEST(test_file_cut_mid_frame_keeps_earlier_blocks) {
+  auto path = compressed_path("cut");
+  auto raw = log_lines(2000);
+  write_compressed(path, raw);
+  // the writer stopped halfway through its last frame
+  auto full = fs::file_size(path);
+  fs::resize_file(path, full - 10);
+  auto kept = read_compressed(path);
+  test_lib::assert_false(kept.empty());
+  test_lib::assert_true(kept.size() < raw.size());
+  test_lib::assert_true(raw.starts_with(kept));
+  test_lib::assert_true(kept.ends_with('\n'));
+  fs::remove(path);
+}
+
+JOWI_ADD_TEST(test_compressed_emitter_rejects_4gib_blocks) {
+  auto path = compressed_path("huge");
+  auto emitter = crogger::CompressedFileEmitter::open(path, false, uint64_t{1} << 32);
+  test_lib::assert_false(emitter.has_value());
+  test_lib::assert_false(fs::exists(path));
+}
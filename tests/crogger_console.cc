@@ -0,0 +1,103 @@
+import jowi.test_lib;
+import jowi.crogger;
+
+namespace crogger = jowi::crogger;
+namespace test_lib = jowi::test_lib;
+
+#include <jowi/test_lib.hpp>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <termios.h>
+#include <unistd.h>
+#include <array>
+#include <chrono>
+#include <string>
+#include <thread>
+
+// whatever can be read from fd within timeout_ms, empty when nothing arrives
+static std::string read_available(int fd, int timeout_ms = 100) {
+  std::string out;
+  std::array<char, 4096> buf;
+  pollfd p{fd, POLLIN, 0};
+  while (poll(&p, 1, out.empty() ? timeout_ms : 0) == 1 && (p.revents & POLLIN) != 0) {
+    auto n = read(fd, buf.data(), buf.size());
+    if (n <= 0) {
+      break;
+    }
+    out.append(buf.data(), static_cast<size_t>(n));
+  }
+  return out;
+}
+
+JOWI_ADD_TEST(test_redirected_sink_batches_records) {
+  int fds[2];
+  test_lib::assert_equal(pipe(fds), 0);
+  {
+    crogger::ConsoleSink sink{fds[1], "pipe"};
+    test_lib::assert_false(sink.tty);
+    test_lib::assert_expected(sink.emit("first\n"));
+    test_lib::assert_expected(sink.emit("second\n"));
+    test_lib::assert_true(read_available(fds[0], 0).empty());
+    test_lib::assert_expected(sink.flush());
+    test_lib::assert_true(read_available(fds[0]) == "first\nsecond\n");
+
+    // a record arriving flush_interval after the last write flushes the batch
+    test_lib::assert_expected(sink.emit("third\n"));
+    std::this_thread::sleep_for(crogger::ConsoleSink::flush_interval);
+    test_lib::assert_true(read_available(fds[0], 0).empty());
+    test_lib::assert_expected(sink.emit("fourth\n"));
+    test_lib::assert_true(read_available(fds[0]) == "third\nfourth\n");
+
+    test_lib::assert_expected(sink.emit(std::string(crogger::ConsoleSink::capacity, 'x')));
+    test_lib::assert_equal(
+      read_available(fds[0]).size(), static_cast<size_t>(crogger::ConsoleSink::capacity)
+    );
+    test_lib::assert_expected(sink.emit("at exit\n"));
+  }
+  test_lib::assert_true(read_available(fds[0]) == "at exit\n");
+  close(fds[0]);
+  close(fds[1]);
+}
+
+JOWI_ADD_TEST(test_unbuffered_sink_writes_right_away) {
+  int fds[2];
+  test_lib::assert_equal(pipe(fds), 0);
+  {
+    crogger::ConsoleSink sink{fds[1], "pipe", false};
+    test_lib::assert_expected(sink.emit("no newline"));
+    test_lib::assert_true(read_available(fds[0]) == "no newline");
+    test_lib::assert_expected(sink.emit("record\n"));
+    test_lib::assert_true(read_available(fds[0]) == "record\n");
+  }
+  close(fds[0]);
+  close(fds[1]);
+}
+
+JOWI_ADD_TEST(test_terminal_sink_writes_complete_records) {
+  int master = posix_openpt(O_RDWR | O_NOCTTY);
+  // no pseudo terminal in this environment, nothing to test
+  if (master < 0) {
+    return;
+  }
+  test_lib::assert_equal(grantpt(master), 0);
+  test_lib::assert_equal(unlockpt(master), 0);
+  int slave = open(ptsname(master), O_RDWR | O_NOCTTY);
+  test_lib::assert_true(slave >= 0);
+  termios raw;
+  test_lib::assert_equal(tcgetattr(slave, &raw), 0);
+  cfmakeraw(&raw);
+  test_lib::assert_equal(tcsetattr(slave, TCSANOW, &raw), 0);
+  {
+    crogger::ConsoleSink sink{slave, "pty"};
+    test_lib::assert_true(sink.tty);
+    test_lib::assert_expected(sink.emit("record\n"));
+    test_lib::assert_true(read_available(master) == "record\n");
+    test_lib::assert_expected(sink.emit("par"));
+    test_lib::assert_true(read_available(master, 50).empty());
+    test_lib::assert_expected(sink.emit("tial\n"));
+    test_lib::assert_true(read_available(master) == "partial\n");
+  }
+  close(slave);
+  close(master);
+}
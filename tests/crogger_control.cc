@@ -0,0 +1,50 @@
+import jowi.test_lib;
+import jowi.crogger;
+
+namespace crogger = jowi::crogger;
+namespace test_lib = jowi::test_lib;
+
+#include <jowi/test_lib.hpp>
+#include <filesystem>
+#include <format>
+#include <optional>
+
+static std::filesystem::path test_control_path() {
+  return std::filesystem::temp_directory_path() /
+    std::format("crogger_control_test.{}", test_lib::random_string(8));
+}
+
+JOWI_ADD_TEST(test_control_overrides_level) {
+  crogger::Logger root;
+  crogger::LoggerRegistry reg{root};
+  reg.set_level("net", crogger::LogLevel::warn().level);
+  auto client = reg.get("net.http.client");
+  auto path = test_control_path();
+  auto block = crogger::ControlBlock::create(path);
+  test_lib::assert_expected(block);
+  test_lib::assert_expected(reg.attach_control(std::move(block.value())));
+  test_lib::assert_equal(client.effective_level(), crogger::LogLevel::warn().level);
+
+  auto ctl = crogger::ControlBlock::open(path);
+  test_lib::assert_expected(ctl);
+  test_lib::assert_expected(ctl->set_logger_level("net.http", crogger::LogLevel::debug().level));
+  test_lib::assert_equal(client.effective_level(), crogger::LogLevel::debug().level);
+  test_lib::assert_expected(ctl->set_logger_level("net.http", std::nullopt));
+  test_lib::assert_equal(client.effective_level(), crogger::LogLevel::warn().level);
+  test_lib::assert_expected(ctl->set_logger_level("", crogger::LogLevel::error().level));
+  test_lib::assert_equal(reg.get("db").effective_level(), crogger::LogLevel::error().level);
+}
+
+JOWI_ADD_TEST(test_control_feature_toggle) {
+  auto path = test_control_path();
+  auto block = crogger::ControlBlock::create(path);
+  test_lib::assert_expected(block);
+  auto toggle = block->feature("verbose_cache");
+  test_lib::assert_expected(toggle);
+  test_lib::assert_false(toggle->enabled());
+  auto ctl = crogger::ControlBlock::open(path);
+  test_lib::assert_expected(ctl);
+  test_lib::assert_expected(ctl->set_feature("verbose_cache", true));
+  test_lib::assert_true(toggle->enabled());
+  test_lib::assert_false(ctl->set_feature("unknown", true).has_value());
+}
@@ -0,0 +1,87 @@
+import jowi.test_lib;
+import jowi.crogger;
+
+namespace crogger = jowi::crogger;
+namespace test_lib = jowi::test_lib;
+
+#include <jowi/test_lib.hpp>
+#include <chrono>
+#include <expected>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+struct CaptureEmitter {
+  std::shared_ptr<std::vector<std::string>> lines;
+
+  std::expected<void, crogger::LogError> emit(std::string_view data) const {
+    lines->emplace_back(data);
+    return {};
+  }
+};
+
+JOWI_ADD_TEST(test_dedup_collapses_repeated_records) {
+  auto lines = std::make_shared<std::vector<std::string>>();
+  {
+    crogger::Logger logger;
+    logger.set_formatter(crogger::PlainFormatter{});
+    logger.set_emitter(CaptureEmitter{lines});
+    logger.set_dedup(std::chrono::minutes{1});
+    for (int i = 0; i != 100; i += 1) {
+      crogger::warn(logger, crogger::Message{"connection refused"});
+    }
+    crogger::warn(logger, crogger::Message{"giving up after {} tries", 100});
+    for (int i = 0; i != 3; i += 1) {
+      crogger::warn(logger, crogger::Message{"connection refused"});
+    }
+  }
+  test_lib::assert_equal(lines->size(), size_t{5});
+  test_lib::assert_true(lines->at(0) == "connection refused\n");
+  test_lib::assert_true(lines->at(1) == "repeated 99 times\n");
+  test_lib::assert_true(lines->at(2) == "giving up after 100 tries\n");
+  test_lib::assert_true(lines->at(3) == "connection refused\n");
+  test_lib::assert_true(lines->at(4) == "repeated 2 times\n");
+}
+
+JOWI_ADD_TEST(test_dedup_tells_long_records_apart_by_their_tail) {
+  auto lines = std::make_shared<std::vector<std::string>>();
+  auto head = std::string(3000, 'x');
+  {
+    crogger::Logger logger;
+    logger.set_formatter(crogger::PlainFormatter{});
+    logger.set_emitter(CaptureEmitter{lines});
+    logger.set_dedup(std::chrono::minutes{1});
+    // one call site, the records only differ past the first few kilobytes
+    auto log_tail = [&](std::string_view tail) {
+      crogger::warn(logger, crogger::Message{"{} - {}", std::string_view{head}, tail});
+    };
+    for (int i = 0; i != 2; i += 1) {
+      log_tail("first");
+      log_tail("second");
+    }
+    log_tail("second");
+  }
+  test_lib::assert_equal(lines->size(), size_t{6});
+  for (int i = 0; i != 4; i += 1) {
+    test_lib::assert_true(lines->at(i).ends_with(i % 2 == 0 ? " - first\n" : " - second\n"));
+  }
+  test_lib::assert_true(lines->at(4).ends_with(" - second\n"));
+  test_lib::assert_true(lines->at(5) == "repeated 1 times\n");
+}
+
+JOWI_ADD_TEST(test_flush_closes_the_dedup_run) {
+  auto lines = std::make_shared<std::vector<std::string>>();
+  crogger::Logger logger;
+  logger.set_formatter(crogger::PlainFormatter{});
+  logger.set_emitter(CaptureEmitter{lines});
+  logger.set_dedup(std::chrono::minutes{1});
+  for (int i = 0; i != 3; i += 1) {
+    crogger::warn(logger, crogger::Message{"connection refused"});
+  }
+  test_lib::assert_equal(lines->size(), size_t{1});
+  // the run is closed as the awaitable is made, before the emitter flushes
+  static_cast<void>(logger.flush());
+  test_lib::assert_equal(lines->size(), size_t{2});
+  test_lib::assert_true(lines->at(1) == "repeated 2 times\n");
+}
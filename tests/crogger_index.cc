@@ -0,0 +1,157 @@
+import jowi.test_lib;
+import jowi.crogger;
+
+namespace crogger = jowi::crogger;
+namespace test_lib = jowi::test_lib;
+
+#include <jowi/test_lib.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <format>
+#include <source_location>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace fs = std::filesystem;
+using LogTime = std::chrono::sys_time<std::chrono::nanoseconds>;
+
+static const auto base = std::chrono::sys_days{std::chrono::year{2025} / 1 / 1};
+
+static LogTime at(int64_t second) {
+  return LogTime{base + std::chrono::seconds{second}};
+}
+
+static std::string record_line(int64_t second, std::string_view level) {
+  return std::format(
+    "[{}] 2025-01-01T{:02}:{:02}:{:02}.000Z record {}\n",
+    level,
+    second / 3600,
+    second / 60 % 60,
+    second % 60,
+    second
+  );
+}
+
+static void emit_record(const crogger::FileEmitter &emitter, int64_t second) {
+  auto message = crogger::Message{""};
+  auto level = second % 10 == 0 ? crogger::LogLevel::error() : crogger::LogLevel::info();
+  auto line = record_line(second, std::string_view{level.name.c_str()});
+  auto ctx = crogger::LogContext{
+    level, std::source_location::current(), std::chrono::system_clock::time_point{at(second)},
+    message
+  };
+  test_lib::assert_expected(emitter.emit(ctx, line));
+}
+
+// the seconds of the records an index selection reads, following the ranges into the log
+static std::vector<int64_t> selected_seconds(
+  const fs::path &log, const std::vector<crogger::IndexRange> &ranges, LogTime from, LogTime to
+) {
+  std::vector<int64_t> seconds;
+  for (const auto &range : ranges) {
+    auto file = crogger::MappedFile::open(log, range.offset, range.size);
+    test_lib::assert_expected(file);
+    auto data = file->view();
+    while (!data.empty()) {
+      auto line = data.substr(0, data.find('\n') + 1);
+      auto head = crogger::parse_log_line(line);
+      test_lib::assert_true(head.has_value());
+      if (head->time >= from && head->time <= to) {
+        seconds.emplace_back((head->time - at(0)) / std::chrono::seconds{1});
+      }
+      data.remove_prefix(line.size());
+    }
+  }
+  return seconds;
+}
+
+JOWI_ADD_TEST(test_parse_log_time) {
+  test_lib::assert_true(crogger::parse_log_time("2025-01-01T00:00:05Z") == at(5));
+  test_lib::assert_true(
+    crogger::parse_log_time("2025-01-01T00:00:05.25Z") == at(5) + std::chrono::milliseconds{250}
+  );
+  test_lib::assert_true(
+    crogger::parse_log_time("2025-01-01T00:00:05.000000001Z") == at(5) + std::chrono::nanoseconds{1}
+  );
+  test_lib::assert_false(crogger::parse_log_time("2025-01-01 00:00:05Z").has_value());
+  test_lib::assert_false(crogger::parse_log_time("2025-02-30T00:00:05Z").has_value());
+  test_lib::assert_false(crogger::parse_log_time("2025-01-01T00:00:05").has_value());
+  test_lib::assert_false(crogger::parse_log_time("2025-01-01T00:00:05,5Z").has_value());
+}
+
+JOWI_ADD_TEST(test_parse_level) {
+  test_lib::assert_true(crogger::parse_level("WARN") == crogger::LogLevel::warn().level);
+  test_lib::assert_true(crogger::parse_level("CRITICAL") == crogger::LogLevel::critical().level);
+  test_lib::assert_true(crogger::parse_level("35") == 35u);
+  test_lib::assert_false(crogger::parse_level("warn").has_value());
+  test_lib::assert_false(crogger::parse_level("3x").has_value());
+}
+
+JOWI_ADD_TEST(test_parse_log_line) {
+  auto line = crogger::parse_log_line("[INFO] 2025-01-01T00:00:07.500Z request done\n");
+  test_lib::assert_true(line.has_value());
+  test_lib::assert_true(line->level == "INFO");
+  test_lib::assert_true(line->time == at(7) + std::chrono::milliseconds{500});
+  test_lib::assert_true(line->message == "request done\n");
+
+  auto colored = crogger::parse_log_line("\x1b[33m[WARN]\x1b[0m 2025-01-01T00:00:07Z slow");
+  test_lib::assert_true(colored.has_value());
+  test_lib::assert_true(colored->level == "WARN");
+  test_lib::assert_true(colored->message == "slow");
+
+  test_lib::assert_false(crogger::parse_log_line("  continued message\n").has_value());
+  test_lib::assert_false(crogger::parse_log_line("[INFO] yesterday hello\n").has_value());
+}
+
+JOWI_ADD_TEST(test_index_selects_time_ranges) {
+  auto log = fs::temp_directory_path() /
+    std::format("crogger_index_test.{}.log", test_lib::random_string(8));
+  constexpr int64_t count = 600;
+  {
+    auto emitter = crogger::FileEmitter::open_indexed(log, false, 512);
+    test_lib::assert_expected(emitter);
+    for (int64_t s = 0; s != count; s += 1) {
+      emit_record(emitter.value(), s);
+    }
+    // the blocks indexed so far were flushed to the log before their entries
+    auto index = crogger::IndexReader::open(log);
+    test_lib::assert_expected(index);
+    test_lib::assert_false(index->entries().empty());
+    test_lib::assert_true(index->covered_until() <= fs::file_size(log));
+  }
+  auto index = crogger::IndexReader::open(log);
+  test_lib::assert_expected(index);
+  test_lib::assert_equal(index->covered_until(), static_cast<uint64_t>(fs::file_size(log)));
+
+  auto expect_window = [&](int64_t from, int64_t to, unsigned int level) {
+    auto ranges = index->select(at(from), at(to), level);
+    auto seconds = selected_seconds(log, ranges, at(from), at(to));
+    std::vector<int64_t> expected;
+    for (int64_t s = std::max<int64_t>(from, 0); s <= std::min(to, count - 1); s += 1) {
+      expected.emplace_back(s);
+    }
+    test_lib::assert_true(seconds == expected);
+  };
+  expect_window(0, count - 1, 0);
+  expect_window(0, 0, 0);
+  expect_window(count - 1, count - 1, 0);
+  expect_window(100, 250, 0);
+  expect_window(-50, 10, 0);
+  expect_window(590, 700, 0);
+
+  // windows holding no record select nothing
+  test_lib::assert_true(index->select(at(-100), at(-1), 0).empty());
+  test_lib::assert_true(index->select(at(count), at(count + 100), 0).empty());
+  test_lib::assert_true(index->select(at(200), at(100), 0).empty());
+  // every block holds an ERROR record, none holds anything above
+  test_lib::assert_false(index->select(at(0), at(count), crogger::LogLevel::error().level).empty());
+  test_lib::assert_true(
+    index->select(at(0), at(count), crogger::LogLevel::critical().level).empty()
+  );
+
+  fs::remove(log);
+  fs::remove(crogger::index_path(log));
+}
@@ -0,0 +1,94 @@
+import jowi.test_lib;
+import jowi.crogger;
+import jowi.tui;
+
+namespace crogger = jowi::crogger;
+namespace test_lib = jowi::test_lib;
+namespace tui = jowi::tui;
+
+#include <jowi/test_lib.hpp>
+#include <charconv>
+#include <chrono>
+#include <cstdint>
+#include <format>
+#include <source_location>
+#include <string>
+#include <string_view>
+
+// the number a truncation marker reports, 0 when record carries no marker
+static uint64_t marker_count(std::string_view record) {
+  auto at = record.rfind("...[");
+  if (at == std::string_view::npos) {
+    return 0;
+  }
+  uint64_t count = 0;
+  std::from_chars(record.data() + at + 4, record.data() + record.size(), count);
+  return count;
+}
+
+JOWI_ADD_TEST(test_record_within_limit_is_untouched) {
+  crogger::RecordBuffer<256> buf;
+  auto it = buf.writer(100);
+  it = std::format_to(it, "{}", std::string(100, 'a'));
+  auto record = buf.finish(it);
+  test_lib::assert_false(it.truncated());
+  test_lib::assert_equal(record.size(), uint64_t{100});
+  test_lib::assert_true(record == std::string(100, 'a'));
+}
+
+JOWI_ADD_TEST(test_truncated_record_reports_every_removed_byte) {
+  crogger::RecordBuffer<256> buf;
+  auto it = buf.writer(100);
+  for (int i = 0; i != 150; i += 1) {
+    *it++ = 'a';
+  }
+  test_lib::assert_true(it.truncated());
+  test_lib::assert_equal(it.dropped(), uint64_t{50});
+  auto record = buf.finish(it);
+  test_lib::assert_equal(record.size(), uint64_t{100});
+  test_lib::assert_true(record.ends_with(" bytes truncated]\n"));
+  auto kept = record.find("...[");
+  test_lib::assert_true(record.substr(0, kept) == std::string(kept, 'a'));
+  test_lib::assert_equal(kept + marker_count(record), uint64_t{150});
+}
+
+JOWI_ADD_TEST(test_marker_count_gaining_a_digit_stays_exact) {
+  // the count crosses from 2 to 3 digits, widening the marker over one more kept byte
+  for (uint64_t extra = 1; extra != 200; extra += 1) {
+    crogger::RecordBuffer<128> buf;
+    auto it = buf.writer(128);
+    for (uint64_t i = 0; i != 128 + extra; i += 1) {
+      *it++ = 'b';
+    }
+    auto record = buf.finish(it);
+    test_lib::assert_equal(record.size(), uint64_t{128});
+    test_lib::assert_equal(record.find("...[") + marker_count(record), 128 + extra);
+  }
+}
+
+JOWI_ADD_TEST(test_colorful_format_to_matches_format) {
+  auto message = crogger::Message{"{} - {}", 42, "done"};
+  auto ctx = crogger::LogContext{
+    crogger::LogLevel::warn(), std::source_location::current(), std::chrono::system_clock::now(),
+    message
+  };
+  crogger::ColorfulFormatter fmt;
+  auto full = fmt.format(ctx);
+  test_lib::assert_expected(full);
+  // the tag is the one tui renders for a Layout coloured after the level
+  auto tag = std::format(
+    "{}",
+    tui::DomNode::vstack(
+      tui::Layout{}
+        .style(tui::DomStyle{}.fg(fmt.get_level_color(ctx.status.level)))
+        .append_child(tui::Paragraph("[{}]", ctx.status.name).no_newline())
+    )
+  );
+  test_lib::assert_true(full->starts_with(tag + " "));
+  test_lib::assert_true(full->ends_with(" 42 - done\n"));
+
+  crogger::RecordBuffer<256> buf;
+  auto it = buf.writer();
+  test_lib::assert_expected(fmt.format_to(ctx, it));
+  test_lib::assert_true(buf.finish(it) == full.value());
+}
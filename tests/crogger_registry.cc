@@ -0,0 +1,62 @@
+import jowi.test_lib;
+import jowi.crogger;
+
+namespace crogger = jowi::crogger;
+namespace test_lib = jowi::test_lib;
+
+#include <jowi/test_lib.hpp>
+#include <expected>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+struct CaptureEmitter {
+  std::shared_ptr<std::vector<std::string>> lines;
+
+  std::expected<void, crogger::LogError> emit(std::string_view data) const {
+    lines->emplace_back(data);
+    return {};
+  }
+};
+
+static crogger::Logger capture_logger(std::shared_ptr<std::vector<std::string>> lines) {
+  crogger::Logger logger;
+  logger.set_formatter(crogger::PlainFormatter{});
+  logger.set_emitter(CaptureEmitter{std::move(lines)});
+  return logger;
+}
+
+JOWI_ADD_TEST(test_registry_level_inheritance) {
+  auto root_lines = std::make_shared<std::vector<std::string>>();
+  auto root = capture_logger(root_lines);
+  crogger::LoggerRegistry reg{root};
+  auto client = reg.get("net.http.client");
+  test_lib::assert_equal(client.effective_level(), 0u);
+  reg.set_level("net", crogger::LogLevel::warn().level);
+  test_lib::assert_equal(client.effective_level(), crogger::LogLevel::warn().level);
+  reg.set_level("net.http", crogger::LogLevel::debug().level);
+  test_lib::assert_equal(client.effective_level(), crogger::LogLevel::debug().level);
+  test_lib::assert_equal(reg.get("net.tcp").effective_level(), crogger::LogLevel::warn().level);
+  reg.unset_level("net.http");
+  test_lib::assert_equal(client.effective_level(), crogger::LogLevel::warn().level);
+  crogger::info(client, crogger::Message{"dropped"});
+  crogger::error(client, crogger::Message{"kept"});
+  test_lib::assert_equal(root_lines->size(), size_t{1});
+}
+
+JOWI_ADD_TEST(test_registry_sink_inheritance) {
+  auto root_lines = std::make_shared<std::vector<std::string>>();
+  auto net_lines = std::make_shared<std::vector<std::string>>();
+  auto root = capture_logger(root_lines);
+  crogger::LoggerRegistry reg{root};
+  auto client = reg.get("net.http.client");
+  reg.set_sink("net", capture_logger(net_lines));
+  crogger::info(client, crogger::Message{"to net"});
+  crogger::info(reg.get("db"), crogger::Message{"to root"});
+  test_lib::assert_equal(net_lines->size(), size_t{1});
+  test_lib::assert_equal(root_lines->size(), size_t{1});
+  reg.unset_sink("net");
+  crogger::info(client, crogger::Message{"to root"});
+  test_lib::assert_equal(root_lines->size(), size_t{2});
+}
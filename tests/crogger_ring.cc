@@ -0,0 +1,54 @@
+import jowi.test_lib;
+import jowi.crogger;
+
+namespace crogger = jowi::crogger;
+namespace test_lib = jowi::test_lib;
+
+#include <jowi/test_lib.hpp>
+#include <cstdint>
+#include <filesystem>
+#include <format>
+#include <string>
+
+static std::filesystem::path test_ring_path() {
+  return std::filesystem::temp_directory_path() /
+    std::format("crogger_ring_test.{}", test_lib::random_string(8));
+}
+
+JOWI_ADD_TEST(test_ring_round_trip) {
+  auto path = test_ring_path();
+  auto emitter = crogger::RingEmitter::create(path, 16, 64);
+  test_lib::assert_expected(emitter);
+  auto reader = crogger::RingReader::open(path);
+  test_lib::assert_expected(reader);
+  for (int i = 0; i != 10; i += 1) {
+    test_lib::assert_expected(emitter->emit(std::format("record {}\n", i)));
+  }
+  for (int i = 0; i != 10; i += 1) {
+    auto record = reader->next();
+    test_lib::assert_true(record.has_value());
+    test_lib::assert_true(record.value() == std::format("record {}\n", i));
+  }
+  test_lib::assert_false(reader->next().has_value());
+  std::filesystem::remove(path);
+}
+
+JOWI_ADD_TEST(test_ring_counts_overwritten_records) {
+  auto path = test_ring_path();
+  auto emitter = crogger::RingEmitter::create(path, 16, 64);
+  test_lib::assert_expected(emitter);
+  auto reader = crogger::RingReader::open(path);
+  test_lib::assert_expected(reader);
+  for (int i = 0; i != 40; i += 1) {
+    test_lib::assert_expected(emitter->emit(std::format("record {}\n", i)));
+  }
+  uint64_t read = 0;
+  while (auto record = reader->next()) {
+    read += 1;
+  }
+  test_lib::assert_equal(read, uint64_t{16});
+  test_lib::assert_equal(reader->lost(), uint64_t{24});
+  test_lib::assert_expected(emitter->emit(std::string(200, 'x')));
+  test_lib::assert_equal(reader->next().value().size(), size_t{48});
+  std::filesystem::remove(path);
+}
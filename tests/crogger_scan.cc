@@ -0,0 +1,77 @@
+import jowi.test_lib;
+import jowi.crogger;
+
+namespace crogger = jowi::crogger;
+namespace test_lib = jowi::test_lib;
+
+#include <jowi/test_lib.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+JOWI_ADD_TEST(test_find_in_matches_string_find) {
+  for (int i = 0; i != 2000; i += 1) {
+    auto hay = test_lib::random_string(static_cast<size_t>(test_lib::random_integer(0, 300)));
+    std::string needle;
+    if (!hay.empty() && i % 2 == 0) {
+      auto beg = static_cast<size_t>(test_lib::random_integer(0, static_cast<int>(hay.size()) - 1));
+      auto len = static_cast<size_t>(test_lib::random_integer(1, 40));
+      needle = hay.substr(beg, len);
+    } else {
+      needle = test_lib::random_string(static_cast<size_t>(test_lib::random_integer(1, 3)));
+    }
+    auto expected = std::string_view{hay}.find(needle);
+    auto found = crogger::find_in(hay, needle);
+    test_lib::assert_equal(found, expected == std::string_view::npos ? hay.size() : expected);
+  }
+}
+
+JOWI_ADD_TEST(test_find_in_from) {
+  std::string hay = "[INFO] timeout\n[WARN] timeout\n";
+  auto first = crogger::find_in(hay, "timeout");
+  test_lib::assert_equal(first, uint64_t{7});
+  auto second = crogger::find_in(hay, "timeout", first + 1);
+  test_lib::assert_equal(second, uint64_t{22});
+  test_lib::assert_equal(crogger::find_in(hay, "timeout", second + 1), hay.size());
+  test_lib::assert_equal(crogger::find_in(hay, "timeout", hay.size() + 5), hay.size());
+}
+
+JOWI_ADD_TEST(test_line_at) {
+  std::string_view data = "first\nsecond line\nlast";
+  test_lib::assert_equal(crogger::line_at(data, 8), std::string_view{"second line\n"});
+  test_lib::assert_equal(crogger::line_at(data, 0), std::string_view{"first\n"});
+  test_lib::assert_equal(crogger::line_at(data, 20), std::string_view{"last"});
+}
+
+JOWI_ADD_TEST(test_line_start_matches_backward_search) {
+  for (int i = 0; i != 2000; i += 1) {
+    auto data = test_lib::random_string(static_cast<size_t>(test_lib::random_integer(0, 300)));
+    for (auto &c : data) {
+      if (test_lib::random_integer(0, 15) == 0) c = '\n';
+    }
+    auto pos = static_cast<uint64_t>(test_lib::random_integer(0, static_cast<int>(data.size())));
+    auto nl = pos == 0 ? std::string_view::npos : std::string_view{data}.rfind('\n', pos - 1);
+    test_lib::assert_equal(
+      crogger::line_start(data, pos), nl == std::string_view::npos ? uint64_t{0} : nl + 1
+    );
+  }
+}
+
+JOWI_ADD_TEST(test_level_tag_at) {
+  std::string data = "[WARN] 2024-01-01T00:00:00Z slow\n"
+                     "\x1b[0m\x1b[31m[ERROR]\x1b[0m 2024-01-01T00:00:00Z failed\n"
+                     "[17] custom\n"
+                     "[WA\nRN] split\n"
+                     "[0123456789abcdefgh] too long for a level\n"
+                     "no tag";
+  test_lib::assert_equal(crogger::level_tag_at(data, 0), std::string_view{"WARN"});
+  auto second = data.find('\n') + 1;
+  test_lib::assert_equal(crogger::level_tag_at(data, second), std::string_view{"ERROR"});
+  auto third = data.find("[17]");
+  test_lib::assert_equal(crogger::level_tag_at(data, third), std::string_view{"17"});
+  test_lib::assert_true(crogger::level_tag_at(data, data.find("[WA")).empty());
+  test_lib::assert_true(crogger::level_tag_at(data, data.find("[0123")).empty());
+  test_lib::assert_true(crogger::level_tag_at(data, data.find("no tag")).empty());
+  test_lib::assert_true(crogger::level_tag_at("[WARN", 0).empty());
+}
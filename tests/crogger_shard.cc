@@ -0,0 +1,118 @@
+import jowi.test_lib;
+import jowi.crogger;
+
+namespace crogger = jowi::crogger;
+namespace test_lib = jowi::test_lib;
+
+#include <jowi/test_lib.hpp>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <format>
+#include <source_location>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+static fs::path shard_dir() {
+  return fs::temp_directory_path() /
+    std::format("crogger_shard_test.{}", test_lib::random_string(8));
+}
+
+static std::vector<crogger::ShardReader> open_shards(const fs::path &dir) {
+  std::vector<crogger::ShardReader> readers;
+  for (const auto &entry : fs::directory_iterator{dir}) {
+    auto reader = crogger::ShardReader::open(entry.path());
+    test_lib::assert_expected(reader);
+    readers.emplace_back(std::move(reader.value()));
+  }
+  return readers;
+}
+
+static void emit_at(const crogger::ShardedFileEmitter &emitter, int64_t ms, std::string_view d) {
+  auto message = crogger::Message{""};
+  auto time = std::chrono::system_clock::time_point{std::chrono::milliseconds{ms}};
+  auto ctx = crogger::LogContext{
+    crogger::LogLevel::info(), std::source_location::current(), time, message
+  };
+  test_lib::assert_expected(emitter.emit(ctx, d));
+}
+
+JOWI_ADD_TEST(test_shard_records_read_back) {
+  auto dir = shard_dir();
+  {
+    auto emitter = crogger::ShardedFileEmitter::open(dir, "app");
+    test_lib::assert_expected(emitter);
+    for (int i = 0; i != 100; i += 1) {
+      emit_at(emitter.value(), i, std::format("record {}\n", i));
+    }
+  }
+  auto readers = open_shards(dir);
+  test_lib::assert_equal(readers.size(), size_t{1});
+  for (int i = 0; i != 100; i += 1) {
+    auto record = readers[0].next();
+    test_lib::assert_true(record.has_value());
+    test_lib::assert_true(record->data == std::format("record {}\n", i));
+    test_lib::assert_equal(record->seq, uint64_t(i + 1));
+  }
+  test_lib::assert_false(readers[0].next().has_value());
+  fs::remove_all(dir);
+}
+
+JOWI_ADD_TEST(test_destroying_emitter_closes_live_threads_shards) {
+  auto dir = shard_dir();
+  std::atomic<int> written{0};
+  std::atomic<bool> release{false};
+  std::vector<std::jthread> threads;
+  {
+    auto emitter = crogger::ShardedFileEmitter::open(dir, "app");
+    test_lib::assert_expected(emitter);
+    for (int t = 0; t != 4; t += 1) {
+      threads.emplace_back([&, t]() {
+        emit_at(emitter.value(), t, std::format("thread {}\n", t));
+        written += 1;
+        release.wait(false);
+      });
+    }
+    while (written != 4) {
+      std::this_thread::yield();
+    }
+  }
+  // the threads are still alive, their shards were flushed when the emitter went away
+  auto readers = open_shards(dir);
+  test_lib::assert_equal(readers.size(), size_t{4});
+  for (auto &reader : readers) {
+    test_lib::assert_true(reader.next().has_value());
+  }
+  release = true;
+  release.notify_all();
+  threads.clear();
+  fs::remove_all(dir);
+}
+
+JOWI_ADD_TEST(test_merge_orders_by_time_across_shards) {
+  auto dir = shard_dir();
+  {
+    auto emitter = crogger::ShardedFileEmitter::open(dir, "app");
+    test_lib::assert_expected(emitter);
+    std::vector<std::jthread> threads;
+    for (int t = 0; t != 3; t += 1) {
+      threads.emplace_back([&, t]() {
+        // thread t writes the times t, t + 3, t + 6, ...: only the merge interleaves them
+        for (int i = t; i < 30; i += 3) {
+          emit_at(emitter.value(), i, std::format("{}\n", i));
+        }
+      });
+    }
+  }
+  auto merge = crogger::ShardMerge{open_shards(dir)};
+  for (int i = 0; i != 30; i += 1) {
+    auto record = merge.next();
+    test_lib::assert_true(record.has_value());
+    test_lib::assert_true(record->data == std::format("{}\n", i));
+  }
+  test_lib::assert_false(merge.next().has_value());
+  fs::remove_all(dir);
+}
@@ -0,0 +1,78 @@
+import jowi.test_lib;
+import jowi.crogger;
+
+namespace crogger = jowi::crogger;
+namespace test_lib = jowi::test_lib;
+
+#include <jowi/test_lib.hpp>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <format>
+#include <string>
+#include <string_view>
+#include <thread>
+
+static std::string frame(std::string_view record) {
+  uint32_t size = static_cast<uint32_t>(record.size());
+  std::string f{reinterpret_cast<const char *>(&size), sizeof(size)};
+  f.append(record);
+  return f;
+}
+
+JOWI_ADD_TEST(test_socket_frame_buffer_reassembles) {
+  auto bytes = frame("first\n") + frame("second\n");
+  crogger::SocketFrameBuffer frames;
+  frames.append(std::string_view{bytes}.substr(0, 7));
+  test_lib::assert_true(frames.next().value() == std::string_view{"first\n"});
+  test_lib::assert_false(frames.next().value().has_value());
+  frames.append(std::string_view{bytes}.substr(7));
+  test_lib::assert_true(frames.next().value() == std::string_view{"second\n"});
+  test_lib::assert_false(frames.next().value().has_value());
+}
+
+JOWI_ADD_TEST(test_socket_emitter_delivers_after_collector_starts) {
+  auto path = std::filesystem::temp_directory_path() /
+    std::format("crogger_socket_test.{}", test_lib::random_string(8));
+  uint64_t received = 0;
+  {
+    auto emitter = crogger::SocketEmitter::open(path, 256);
+    test_lib::assert_expected(emitter);
+    for (int i = 0; i != 500; i += 1) {
+      test_lib::assert_expected(emitter->emit(std::format("record {}\n", i)));
+    }
+
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    std::memcpy(addr.sun_path, path.c_str(), path.native().size() + 1);
+    test_lib::assert_equal(bind(listener, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)), 0);
+    test_lib::assert_equal(listen(listener, 1), 0);
+    std::thread collector{[&]() {
+      int fd = accept(listener, nullptr, nullptr);
+      crogger::SocketFrameBuffer frames;
+      std::array<char, 4096> buf;
+      ssize_t n;
+      while ((n = read(fd, buf.data(), buf.size())) > 0) {
+        frames.append(std::string_view{buf.data(), static_cast<size_t>(n)});
+        while (frames.next().value()) {
+          received += 1;
+        }
+      }
+      close(fd);
+    }};
+    for (int i = 500; i != 1000; i += 1) {
+      test_lib::assert_expected(emitter->emit(std::format("record {}\n", i)));
+    }
+    // destroying the emitter flushes the spool and closes the connection
+    emitter = crogger::SocketEmitter::open(path.string() + ".unused");
+    collector.join();
+    close(listener);
+  }
+  std::filesystem::remove(path);
+  test_lib::assert_equal(received, uint64_t{1000});
+}
@@ -0,0 +1,211 @@
+import jowi.test_lib;
+import jowi.cli;
+import jowi.crogger;
+
+namespace cli = jowi::cli;
+namespace crogger = jowi::crogger;
+namespace test_lib = jowi::test_lib;
+
+#include <jowi/test_lib.hpp>
+#include <sys/wait.h>
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fcntl.h>
+#include <filesystem>
+#include <print>
+#include <string>
+#include <thread>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+JOWI_ADD_TEST(test_forward_without_daemon_fails) {
+  auto sock = fs::temp_directory_path() / ("jowi_cli_none_" + std::to_string(::getpid()));
+  std::array argv = {"some_exec"};
+  test_lib::assert_true(!cli::Daemon::forward(sock, argv.size(), argv.data()).has_value());
+}
+
+// waits for the daemon serving sock to go idle and remove its socket
+static bool wait_for_exit(const fs::path &sock) {
+  for (int i = 0; i != 300 && fs::exists(sock); i += 1) {
+    std::this_thread::sleep_for(std::chrono::milliseconds{10});
+  }
+  return !fs::exists(sock);
+}
+
+JOWI_ADD_TEST(test_forward_returns_daemon_exit_code) {
+  auto sock = fs::temp_directory_path() / ("jowi_cli_daemon_" + std::to_string(::getpid()));
+  pid_t pid = ::fork();
+  if (pid == 0) {
+    auto res = cli::Daemon::serve(
+      sock,
+      [](int argc, const char **argv) { return std::atoi(argv[argc - 1]); },
+      std::chrono::milliseconds{500}
+    );
+    std::_Exit(res ? 0 : 1);
+  }
+  std::array argv = {"some_exec", "7"};
+  auto code = cli::Daemon::forward(sock, argv.size(), argv.data());
+  for (int i = 0; !code && i != 100; i += 1) {
+    std::this_thread::sleep_for(std::chrono::milliseconds{10});
+    code = cli::Daemon::forward(sock, argv.size(), argv.data());
+  }
+  test_lib::assert_expected(code);
+  test_lib::assert_equal(code.value(), 7);
+  int status;
+  ::waitpid(pid, &status, 0);
+  test_lib::assert_equal(WEXITSTATUS(status), 0);
+  test_lib::assert_true(!fs::exists(sock));
+}
+
+JOWI_ADD_TEST(test_run_spawns_a_daemon_writing_to_the_client) {
+  auto sock = fs::temp_directory_path() / ("jowi_cli_run_" + std::to_string(::getpid()));
+  int out[2];
+  test_lib::assert_equal(::pipe(out), 0);
+  // the client runs in its own process, its stdout being the pipe
+  std::fflush(nullptr);
+  pid_t client = ::fork();
+  if (client == 0) {
+    ::dup2(out[1], STDOUT_FILENO);
+    ::close(out[0]);
+    ::close(out[1]);
+    int initialized = 0;
+    auto make_handler = [&]() {
+      initialized += 1;
+      return [](int argc, const char **argv) {
+        std::println("{}", argv[1]);
+        std::fflush(stdout);
+        return argc;
+      };
+    };
+    auto idle = std::chrono::milliseconds{500};
+    std::array first = {"some_exec", "in_process"};
+    int first_code =
+      cli::Daemon::run(sock, first.size(), first.data(), nullptr, make_handler, idle);
+    // the spawned daemon answers once it listens
+    std::array second = {"some_exec", "forwarded", "x"};
+    auto second_code = cli::Daemon::forward(sock, second.size(), second.data());
+    for (int i = 0; !second_code && i != 100; i += 1) {
+      std::this_thread::sleep_for(std::chrono::milliseconds{10});
+      second_code = cli::Daemon::forward(sock, second.size(), second.data());
+    }
+    std::array third = {"some_exec", "run", "x", "y"};
+    int third_code =
+      cli::Daemon::run(sock, third.size(), third.data(), nullptr, make_handler, idle);
+    bool ok = first_code == 2 && second_code == 3 && third_code == 4 && initialized == 1;
+    std::_Exit(ok ? 0 : 1);
+  }
+  ::close(out[1]);
+  std::string output;
+  char buf[256];
+  for (ssize_t n; (n = ::read(out[0], buf, sizeof(buf))) > 0;) {
+    output.append(buf, static_cast<size_t>(n));
+  }
+  ::close(out[0]);
+  int status;
+  ::waitpid(client, &status, 0);
+  test_lib::assert_equal(WEXITSTATUS(status), 0);
+  // the forwarded invocations wrote straight to the descriptor the client passed
+  test_lib::assert_true(output == "in_process\nforwarded\nrun\n");
+  test_lib::assert_true(wait_for_exit(sock));
+}
+
+JOWI_ADD_TEST(test_daemon_output_stays_out_of_requests) {
+  auto sock = fs::temp_directory_path() / ("jowi_cli_out_" + std::to_string(::getpid()));
+  std::fflush(nullptr);
+  pid_t pid = ::fork();
+  if (pid == 0) {
+    // like a spawned daemon, writing to /dev/null, with its output left buffered
+    int null = ::open("/dev/null", O_WRONLY);
+    ::dup2(null, STDOUT_FILENO);
+    ::close(null);
+    crogger::Logger logger;
+    std::println("daemon print");
+    crogger::info(logger, crogger::Message{"daemon log"});
+    auto res = cli::Daemon::serve(
+      sock,
+      [&](int, const char **argv) {
+        std::println("{} print", argv[1]);
+        crogger::info(logger, crogger::Message{"{} log", argv[1]});
+        static_cast<void>(crogger::StdoutEmitter{}.flush());
+        return 0;
+      },
+      std::chrono::milliseconds{500}
+    );
+    std::_Exit(res ? 0 : 1);
+  }
+  int out[2];
+  test_lib::assert_equal(::pipe(out), 0);
+  pid_t client = ::fork();
+  if (client == 0) {
+    ::dup2(out[1], STDOUT_FILENO);
+    ::close(out[0]);
+    ::close(out[1]);
+    std::array argv = {"some_exec", "request"};
+    auto code = cli::Daemon::forward(sock, argv.size(), argv.data());
+    for (int i = 0; !code && i != 100; i += 1) {
+      std::this_thread::sleep_for(std::chrono::milliseconds{10});
+      code = cli::Daemon::forward(sock, argv.size(), argv.data());
+    }
+    std::_Exit(code && code.value() == 0 ? 0 : 1);
+  }
+  ::close(out[1]);
+  std::string output;
+  char buf[256];
+  for (ssize_t n; (n = ::read(out[0], buf, sizeof(buf))) > 0;) {
+    output.append(buf, static_cast<size_t>(n));
+  }
+  ::close(out[0]);
+  int status;
+  ::waitpid(client, &status, 0);
+  test_lib::assert_equal(WEXITSTATUS(status), 0);
+  test_lib::assert_true(output.contains("request print\n"));
+  test_lib::assert_true(output.contains("request log\n"));
+  test_lib::assert_false(output.contains("daemon"));
+  ::waitpid(pid, &status, 0);
+  test_lib::assert_equal(WEXITSTATUS(status), 0);
+}
+
+JOWI_ADD_TEST(test_daemon_serves_its_user_only) {
+  auto sock = fs::temp_directory_path() / ("jowi_cli_user_" + std::to_string(::getpid()));
+  std::fflush(nullptr);
+  pid_t pid = ::fork();
+  if (pid == 0) {
+    auto res = cli::Daemon::serve(
+      sock, [](int, const char **) { return 7; }, std::chrono::milliseconds{500}
+    );
+    std::_Exit(res ? 0 : 1);
+  }
+  std::array argv = {"some_exec"};
+  auto code = cli::Daemon::forward(sock, argv.size(), argv.data());
+  for (int i = 0; !code && i != 100; i += 1) {
+    std::this_thread::sleep_for(std::chrono::milliseconds{10});
+    code = cli::Daemon::forward(sock, argv.size(), argv.data());
+  }
+  test_lib::assert_expected(code);
+  test_lib::assert_equal(code.value(), 7);
+  auto perms = fs::status(sock).permissions();
+  auto shared = fs::perms::group_all | fs::perms::others_all;
+  test_lib::assert_true((perms & shared) == fs::perms::none);
+
+  // another user gets no answer, checked when the test may switch users
+  if (::geteuid() == 0) {
+    pid_t other = ::fork();
+    if (other == 0) {
+      if (::setuid(65534) != 0) {
+        std::_Exit(2);
+      }
+      auto res = cli::Daemon::forward(sock, argv.size(), argv.data());
+      std::_Exit(res && res.value() == 7 ? 1 : 0);
+    }
+    int status;
+    ::waitpid(other, &status, 0);
+    test_lib::assert_equal(WEXITSTATUS(status), 0);
+  }
+  int status;
+  ::waitpid(pid, &status, 0);
+  test_lib::assert_equal(WEXITSTATUS(status), 0);
+  test_lib::assert_true(!fs::exists(sock));
+}
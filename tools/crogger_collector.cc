@@ -0,0 +1,129 @@
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <array>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <string_view>
+#include <vector>
+import jowi.cli;
+import jowi.crogger;
+
+namespace cli = jowi::cli;
+namespace crogger = jowi::crogger;
+namespace fs = std::filesystem;
+
+struct FileCloser {
+  void operator()(FILE *f) {
+    if (f != nullptr && f != stdout) {
+      fclose(f);
+    }
+  }
+};
+
+struct Client {
+  int fd;
+  crogger::SocketFrameBuffer frames;
+};
+
+int listen_unix(cli::App &app, const fs::path &p) {
+  if (p.native().size() >= sizeof(sockaddr_un{}.sun_path)) {
+    app.error(1, "socket path {} is too long", p.c_str());
+  }
+  ::unlink(p.c_str());
+  int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  sockaddr_un addr{};
+  addr.sun_family = AF_UNIX;
+  std::memcpy(addr.sun_path, p.c_str(), p.native().size() + 1);
+  if (fd == -1 || bind(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0 ||
+      listen(fd, 16) != 0) {
+    app.error(1, "cannot listen on {}", p.c_str());
+  }
+  return fd;
+}
+
+/*
+  drain
+  reads what a client sent and writes the complete records to out. Returns false once the
+  client is gone or broke the framing.
+*/
+bool drain(Client &client, FILE *out) {
+  std::array<char, 64 * 1024> buf;
+  auto n = read(client.fd, buf.data(), buf.size());
+  if (n <= 0) {
+    return false;
+  }
+  client.frames.append(std::string_view{buf.data(), static_cast<size_t>(n)});
+  while (true) {
+    auto record = client.frames.next();
+    if (!record) {
+      fprintf(stderr, "crogger-collector: %s\n", record.error().what());
+      return false;
+    }
+    if (!record->has_value()) {
+      break;
+    }
+    auto data = record->value();
+    fwrite(data.data(), sizeof(char), data.size(), out);
+  }
+  fflush(out);
+  return true;
+}
+
+int main(int argc, const char **argv) {
+  auto app = cli::App{
+    cli::AppIdentity{
+      .name = "crogger-collector",
+      .description = "Receives records sent by crogger::SocketEmitter and writes them out",
+      .version = cli::AppVersion{1, 1, 0}
+    },
+    argc,
+    argv
+  };
+  app.add_argument("--socket").help("The Unix domain socket to listen on").required();
+  app.add_argument("--output")
+    .help("The file to append the records to, defaults to stdout")
+    .require_value()
+    .optional();
+  app.parse_args();
+
+  std::unique_ptr<FILE, FileCloser> out{stdout};
+  if (auto output = app.args().first_of("--output")) {
+    out.reset(fopen(fs::path{output.value()}.c_str(), "a"));
+    if (!out) {
+      app.error(1, "cannot open {}", output.value());
+    }
+  }
+  auto socket_path = fs::path{app.args().first_of("--socket").value()};
+  int listener = listen_unix(app, socket_path);
+
+  std::vector<Client> clients;
+  std::vector<pollfd> fds;
+  while (true) {
+    fds.clear();
+    fds.emplace_back(pollfd{listener, POLLIN, 0});
+    for (const auto &client : clients) {
+      fds.emplace_back(pollfd{client.fd, POLLIN, 0});
+    }
+    if (poll(fds.data(), fds.size(), -1) < 0) {
+      continue;
+    }
+    // clients are checked back to front so that erasing does not shift the unchecked ones
+    for (auto i = clients.size(); i != 0; i -= 1) {
+      if (fds[i].revents != 0 && !drain(clients[i - 1], out.get())) {
+        ::close(clients[i - 1].fd);
+        clients.erase(clients.begin() + static_cast<std::ptrdiff_t>(i - 1));
+      }
+    }
+    if ((fds[0].revents & POLLIN) != 0) {
+      int fd = accept4(listener, nullptr, nullptr, SOCK_CLOEXEC);
+      if (fd != -1) {
+        clients.emplace_back(Client{fd, crogger::SocketFrameBuffer{}});
+      }
+    }
+  }
+}
@@ -0,0 +1,205 @@
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <format>
+#include <iterator>
+#include <string>
+#include <string_view>
+#include <system_error>
+import jowi.cli;
+import jowi.crogger;
+import jowi.tui;
+
+namespace cli = jowi::cli;
+namespace crogger = jowi::crogger;
+namespace tui = jowi::tui;
+namespace fs = std::filesystem;
+
+struct GrepQuery {
+  std::string_view pattern;
+  unsigned int min_level;
+  bool color;
+
+  bool level_matches(std::string_view tag) const {
+    if (min_level == 0) return true;
+    return crogger::parse_level(tag).value_or(0) >= min_level;
+  }
+
+  static void append_styled(std::string &out, std::string_view text, tui::DomStyle style) {
+    if (text.empty()) return;
+    std::format_to(
+      std::back_inserter(out),
+      "{}",
+      tui::DomNode::vstack(
+        tui::Layout{}.style(style).append_child(tui::Paragraph(std::string{text}).no_newline())
+      )
+    );
+  }
+
+  /*
+    print_line
+    prints line with every occurrence of the pattern highlighted when color is on. The level tag
+    is colored like ColorfulFormatter does, unless the line already carries escape codes; a hit
+    inside the tag is highlighted like any other.
+  */
+  void print_line(std::string_view line, std::string &out) const {
+    if (!color) {
+      out.append(line);
+      return;
+    }
+    uint64_t tag_end = 0;
+    tui::DomStyle tag_style;
+    if (line.starts_with('[')) {
+      auto tag = crogger::level_tag_at(line, 0);
+      if (!tag.empty()) {
+        auto level = crogger::parse_level(tag).value_or(0);
+        tag_end = tag.size() + 2;
+        tag_style = tui::DomStyle{}.fg(crogger::ColorfulFormatter{}.get_level_color(level));
+      }
+    }
+    auto hit_style =
+      tui::DomStyle{}.effect(tui::TextEffect::BOLD).fg(tui::RgbColor::bright_red());
+    uint64_t pos = 0;
+    while (true) {
+      auto hit = crogger::find_in(line, pattern, pos);
+      auto tag_part = std::min(std::max(pos, tag_end), hit);
+      append_styled(out, line.substr(pos, tag_part - pos), tag_style);
+      out.append(line.substr(tag_part, hit - tag_part));
+      if (hit == line.size()) break;
+      append_styled(out, pattern, hit_style);
+      pos = hit + pattern.size();
+    }
+    if (!line.ends_with('\n')) {
+      out.push_back('\n');
+    }
+  }
+
+  /*
+    scan
+    prints the lines of data holding the pattern. The search runs over the whole buffer, lines are
+    only delimited around a hit, so non matching lines are never split.
+  */
+  void scan(std::string_view data, std::string &out) const {
+    uint64_t pos = 0;
+    while (pos < data.size()) {
+      auto hit = crogger::find_in(data, pattern, pos);
+      if (hit == data.size()) break;
+      // a record below the level is passed over from its tag alone
+      if (!level_matches(crogger::level_tag_at(data, crogger::line_start(data, hit)))) {
+        pos = crogger::find_in(data, "\n", hit) + 1;
+        continue;
+      }
+      auto line = crogger::line_at(data, hit);
+      print_line(line, out);
+      pos = static_cast<uint64_t>(line.data() - data.data()) + line.size();
+      if (out.size() >= 64 * 1024) {
+        fwrite(out.data(), sizeof(char), out.size(), stdout);
+        out.clear();
+      }
+    }
+    fwrite(out.data(), sizeof(char), out.size(), stdout);
+    out.clear();
+    fflush(stdout);
+  }
+};
+
+/*
+  follow
+  keeps scanning the lines appended to path after offset. Only complete lines are scanned, a
+  truncated file is scanned again from its start.
+*/
+[[noreturn]] void follow(
+  cli::App &app, const fs::path &path, uint64_t offset, const GrepQuery &query, std::string &out
+) {
+  int fd = inotify_init1(IN_CLOEXEC);
+  if (fd == -1 || inotify_add_watch(fd, path.c_str(), IN_MODIFY) == -1) {
+    app.error(1, "cannot watch {}", path.c_str());
+  }
+  std::array<char, 4096> events;
+  while (true) {
+    if (read(fd, events.data(), events.size()) <= 0) {
+      app.error(1, "cannot read events of {}", path.c_str());
+    }
+    std::error_code ec;
+    uint64_t size = fs::file_size(path, ec);
+    if (ec) {
+      app.error(1, "cannot stat {}", path.c_str());
+    }
+    if (size < offset) {
+      offset = 0;
+    }
+    auto file = crogger::MappedFile::open(path, offset, size - offset);
+    if (!file) {
+      app.error(1, "{}", file.error().what());
+    }
+    auto data = file->view();
+    auto last_line = data.rfind('\n');
+    if (last_line == std::string_view::npos) {
+      continue;
+    }
+    query.scan(data.substr(0, last_line + 1), out);
+    offset += last_line + 1;
+  }
+}
+
+int main(int argc, const char **argv) {
+  auto app = cli::App{
+    cli::AppIdentity{
+      .name = "crogger-grep",
+      .description = "Prints the lines of a log holding a pattern",
+      .version = cli::AppVersion{1, 1, 0}
+    },
+    argc,
+    argv
+  };
+  app.add_argument("--file").help("The log file to search").required();
+  app.add_argument("--pattern").help("The text to search for").required();
+  app.add_argument("--level")
+    .help("The minimum level of the printed lines, either a level name or a number")
+    .require_value()
+    .optional();
+  app.add_argument("--follow")
+    .help("Keep printing the matching lines appended to the file")
+    .optional()
+    .as_flag();
+  app.add_argument("--no-color").help("Never highlight the matches").optional().as_flag();
+  app.parse_args();
+
+  auto query = GrepQuery{
+    app.args().first_of("--pattern").value(),
+    app.args()
+      .first_of("--level")
+      .transform([&](std::string_view v) {
+        auto level = crogger::parse_level(v);
+        if (!level) {
+          app.error(1, "--level: {} is not a valid level", v);
+        }
+        return level.value();
+      })
+      .value_or(0),
+    !app.args().contains("--no-color") && isatty(STDOUT_FILENO) == 1
+  };
+  if (query.pattern.empty()) {
+    app.error(1, "--pattern: cannot be empty");
+  }
+
+  auto path = fs::path{app.args().first_of("--file").value()};
+  auto file = crogger::MappedFile::open(path);
+  if (!file) {
+    app.error(1, "{}", file.error().what());
+  }
+  std::string out;
+  auto data = file->view();
+  if (!app.args().contains("--follow")) {
+    query.scan(data, out);
+    return 0;
+  }
+  auto complete = data.rfind('\n');
+  uint64_t offset = complete == std::string_view::npos ? 0 : complete + 1;
+  query.scan(data.substr(0, offset), out);
+  follow(app, path, offset, query, out);
+}
@@ -0,0 +1,81 @@
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <optional>
+#include <string_view>
+#include <vector>
+import jowi.cli;
+import jowi.crogger;
+
+namespace cli = jowi::cli;
+namespace crogger = jowi::crogger;
+namespace fs = std::filesystem;
+
+int main(int argc, const char **argv) {
+  auto app = cli::App{
+    cli::AppIdentity{
+      .name = "crogger-merge",
+      .description = "Merges crogger shard files into a single time ordered log",
+      .version = cli::AppVersion{1, 1, 0}
+    },
+    argc,
+    argv
+  };
+  app.add_argument("--shard")
+    .help("A shard file to merge, can be given multiple times")
+    .require_value();
+  app.add_argument("--dir")
+    .help("Merges every *.shard file in this directory")
+    .require_value()
+    .optional();
+  app.add_argument("--output")
+    .help("The output file, defaults to stdout")
+    .require_value()
+    .optional();
+  app.parse_args();
+
+  std::vector<fs::path> paths;
+  for (auto shard : app.args().filter("--shard")) {
+    paths.emplace_back(shard);
+  }
+  if (auto dir = app.args().first_of("--dir")) {
+    for (const auto &entry : fs::directory_iterator{fs::path{dir.value()}}) {
+      if (entry.is_regular_file() && entry.path().extension() == ".shard") {
+        paths.emplace_back(entry.path());
+      }
+    }
+  }
+  if (paths.empty()) {
+    app.error(1, "no shard given, use --shard or --dir");
+  }
+
+  std::vector<crogger::ShardReader> readers;
+  readers.reserve(paths.size());
+  for (const auto &p : paths) {
+    auto reader = crogger::ShardReader::open(p);
+    if (!reader) {
+      app.error(1, "{}", reader.error().what());
+    }
+    readers.emplace_back(std::move(reader.value()));
+  }
+
+  FILE *out = stdout;
+  if (auto output = app.args().first_of("--output")) {
+    out = fopen(fs::path{output.value()}.c_str(), "w");
+    if (out == nullptr) {
+      app.error(1, "cannot open {}", output.value());
+    }
+  }
+
+  auto merge = crogger::ShardMerge{std::move(readers)};
+  while (auto record = merge.next()) {
+    if (fwrite(record->data.data(), sizeof(char), record->data.size(), out) !=
+        record->data.size()) {
+      app.error(1, "cannot write merged output");
+    }
+  }
+  fflush(out);
+  if (out != stdout) {
+    fclose(out);
+  }
+}
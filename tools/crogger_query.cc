@@ -0,0 +1,116 @@
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <optional>
+#include <string_view>
+#include <vector>
+import jowi.cli;
+import jowi.crogger;
+
+namespace cli = jowi::cli;
+namespace crogger = jowi::crogger;
+namespace fs = std::filesystem;
+
+using LogTime = std::chrono::sys_time<std::chrono::nanoseconds>;
+
+struct RecordQuery {
+  LogTime from;
+  LogTime to;
+  unsigned int min_level;
+
+  bool matches(const crogger::LogLine &line) const {
+    auto level = crogger::parse_level(line.level).value_or(0);
+    return line.time >= from && line.time <= to && level >= min_level;
+  }
+};
+
+/*
+  print_records
+  prints the records of data that match query. Lines that do not start a record (multi line
+  messages) follow the decision taken for the record they belong to.
+*/
+void print_records(std::string_view data, const RecordQuery &query) {
+  bool selected = false;
+  while (!data.empty()) {
+    auto line_end = data.find('\n');
+    auto line_size = line_end == std::string_view::npos ? data.size() : line_end + 1;
+    auto line = data.substr(0, line_size);
+    if (auto head = crogger::parse_log_line(line)) {
+      selected = query.matches(head.value());
+    }
+    if (selected) {
+      fwrite(line.data(), sizeof(char), line.size(), stdout);
+    }
+    data.remove_prefix(line_size);
+  }
+}
+
+int main(int argc, const char **argv) {
+  auto app = cli::App{
+    cli::AppIdentity{
+      .name = "crogger-query",
+      .description = "Prints the records of an indexed log within a time window",
+      .version = cli::AppVersion{1, 1, 0}
+    },
+    argc,
+    argv
+  };
+  app.add_argument("--log").help("The log file written by FileEmitter::open_indexed").required();
+  app.add_argument("--from")
+    .help("The start of the window, e.g. 2025-01-01T10:00:00Z")
+    .require_value()
+    .optional();
+  app.add_argument("--to")
+    .help("The end of the window, e.g. 2025-01-01T10:05:00Z")
+    .require_value()
+    .optional();
+  app.add_argument("--level")
+    .help("The minimum level to print, either a level name or a number")
+    .require_value()
+    .optional();
+  app.parse_args();
+
+  auto parse_time = [&](std::string_view key, LogTime fallback) {
+    return app.args()
+      .first_of(key)
+      .transform([&](std::string_view v) {
+        auto t = crogger::parse_log_time(v);
+        if (!t) {
+          app.error(1, "{}: {} is not a valid time", key, v);
+        }
+        return t.value();
+      })
+      .value_or(fallback);
+  };
+  auto query = RecordQuery{
+    parse_time("--from", LogTime::min()),
+    parse_time("--to", LogTime::max()),
+    app.args()
+      .first_of("--level")
+      .transform([&](std::string_view v) {
+        auto level = crogger::parse_level(v);
+        if (!level) {
+          app.error(1, "--level: {} is not a valid level", v);
+        }
+        return level.value();
+      })
+      .value_or(0)
+  };
+
+  auto log_path = fs::path{app.args().first_of("--log").value()};
+  std::vector<crogger::IndexRange> ranges;
+  uint64_t tail = 0;
+  if (auto index = crogger::IndexReader::open(log_path)) {
+    ranges = index->select(query.from, query.to, query.min_level);
+    tail = index->covered_until();
+  }
+  ranges.emplace_back(crogger::IndexRange{tail, static_cast<uint64_t>(-1)});
+
+  for (const auto &range : ranges) {
+    auto file = crogger::MappedFile::open(log_path, range.offset, range.size);
+    if (!file) {
+      app.error(1, "{}", file.error().what());
+    }
+    print_records(file->view(), query);
+  }
+}
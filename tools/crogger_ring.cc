@@ -0,0 +1,75 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <print>
+#include <signal.h>
+#include <string_view>
+#include <thread>
+import jowi.cli;
+import jowi.crogger;
+
+namespace cli = jowi::cli;
+namespace crogger = jowi::crogger;
+namespace fs = std::filesystem;
+
+/*
+  drain
+  prints the records available in the ring, returns whether any was printed.
+*/
+bool drain(crogger::RingReader &reader) {
+  bool any = false;
+  while (auto record = reader.next()) {
+    fwrite(record->data(), sizeof(char), record->size(), stdout);
+    any = true;
+  }
+  if (any) {
+    fflush(stdout);
+  }
+  return any;
+}
+
+int main(int argc, const char **argv) {
+  auto app = cli::App{
+    cli::AppIdentity{
+      .name = "crogger-ring",
+      .description = "Prints the records of a ring written by crogger::RingEmitter",
+      .version = cli::AppVersion{1, 1, 0}
+    },
+    argc,
+    argv
+  };
+  app.add_argument("--ring").help("The shared memory file of the ring").required();
+  app.add_argument("--follow")
+    .help("Keep printing records until the producer exits")
+    .optional()
+    .as_flag();
+  app.parse_args();
+
+  auto reader = crogger::RingReader::open(fs::path{app.args().first_of("--ring").value()});
+  if (!reader) {
+    app.error(1, "{}", reader.error().what());
+  }
+  drain(reader.value());
+  if (app.args().contains("--follow")) {
+    auto pid = static_cast<pid_t>(reader->producer_pid());
+    auto idle = std::chrono::microseconds{50};
+    while (true) {
+      if (drain(reader.value())) {
+        idle = std::chrono::microseconds{50};
+        continue;
+      }
+      if (kill(pid, 0) != 0) {
+        drain(reader.value());
+        break;
+      }
+      std::this_thread::sleep_for(idle);
+      idle = std::min(idle * 2, std::chrono::microseconds{10000});
+    }
+  }
+  if (reader->lost() != 0) {
+    std::println(
+      stderr, "crogger-ring: {} records were overwritten before being read", reader->lost()
+    );
+  }
+}
@@ -0,0 +1,41 @@
+#include <cstdio>
+#include <filesystem>
+#include <string_view>
+import jowi.cli;
+import jowi.crogger;
+
+namespace cli = jowi::cli;
+namespace crogger = jowi::crogger;
+namespace fs = std::filesystem;
+
+int main(int argc, const char **argv) {
+  auto app = cli::App{
+    cli::AppIdentity{
+      .name = "crogger-unpack",
+      .description = "Decompresses a log written by crogger::CompressedFileEmitter",
+      .version = cli::AppVersion{1, 1, 0}
+    },
+    argc,
+    argv
+  };
+  app.add_argument("--input").help("The compressed log file").required();
+  app.parse_args();
+
+  auto reader = crogger::BlockReader::open(fs::path{app.args().first_of("--input").value()});
+  if (!reader) {
+    app.error(1, "{}", reader.error().what());
+  }
+  while (true) {
+    auto block = reader->next();
+    if (!block) {
+      app.error(1, "{}", block.error().what());
+    }
+    if (!block->has_value()) {
+      break;
+    }
+    std::string_view data = block->value();
+    if (fwrite(data.data(), sizeof(char), data.size(), stdout) != data.size()) {
+      app.error(1, "cannot write to stdout");
+    }
+  }
+}
@@ -0,0 +1,117 @@
+#include <filesystem>
+#include <optional>
+#include <print>
+#include <string_view>
+import jowi.cli;
+import jowi.crogger;
+
+namespace cli = jowi::cli;
+namespace crogger = jowi::crogger;
+namespace fs = std::filesystem;
+
+struct Assignment {
+  std::string_view name;
+  std::string_view value;
+};
+
+std::optional<Assignment> parse_assignment(std::string_view v) {
+  auto eq = v.find('=');
+  if (eq == std::string_view::npos) {
+    return std::nullopt;
+  }
+  return Assignment{v.substr(0, eq), v.substr(eq + 1)};
+}
+
+// the root logger is stored as "" in the control file
+std::string_view logger_name(std::string_view name) {
+  return name == "root" ? std::string_view{} : name;
+}
+
+void print_control(const crogger::ControlBlock &ctl) {
+  std::println("pid {}, generation {}", ctl.pid(), ctl.generation());
+  std::println("loggers:");
+  for (const auto &e : ctl.loggers()) {
+    auto name = e.name.empty() ? std::string_view{"root"} : std::string_view{e.name};
+    if (e.value) {
+      std::println("  {} = {}", name, e.value.value());
+    } else {
+      std::println("  {} = inherit", name);
+    }
+  }
+  std::println("features:");
+  for (const auto &e : ctl.features()) {
+    std::println("  {} = {}", e.name, e.value.value_or(0));
+  }
+}
+
+int main(int argc, const char **argv) {
+  auto app = cli::App{
+    cli::AppIdentity{
+      .name = "croggerctl",
+      .description = "Changes the log levels and feature toggles of a running process",
+      .version = cli::AppVersion{1, 1, 0}
+    },
+    argc,
+    argv
+  };
+  app.add_argument("--pid")
+    .help("The process to control, its control file is /dev/shm/crogger.<pid>")
+    .require_value()
+    .optional();
+  app.add_argument("--file")
+    .help("The control file to open, instead of the one derived from --pid")
+    .require_value()
+    .optional();
+  app.add_argument("--list").help("Prints the levels and toggles").optional().as_flag();
+  app.add_argument("--set")
+    .help("Sets the level of a logger, e.g. net.http=DEBUG, root=WARN or net=inherit")
+    .require_value();
+  app.add_argument("--feature")
+    .help("Switches a feature toggle on or off, e.g. verbose_cache=1")
+    .require_value();
+  app.parse_args();
+
+  fs::path path;
+  if (auto file = app.args().first_of("--file")) {
+    path = fs::path{file.value()};
+  } else if (auto pid = app.args().first_of("--pid")) {
+    path = crogger::control_path(app.expect(cli::parse_arg<unsigned int>(pid.value())));
+  } else {
+    app.error(1, "no process given, use --pid or --file");
+  }
+  auto ctl = crogger::ControlBlock::open(path);
+  if (!ctl) {
+    app.error(1, "{}", ctl.error().what());
+  }
+
+  for (auto arg : app.args().filter("--set")) {
+    auto assignment = parse_assignment(arg);
+    if (!assignment) {
+      app.error(1, "--set: expected name=level, got {}", arg);
+    }
+    std::optional<unsigned int> level;
+    if (assignment->value != "inherit") {
+      level = crogger::parse_level(assignment->value);
+      if (!level) {
+        app.error(1, "--set: {} is not a valid level", assignment->value);
+      }
+    }
+    auto res = ctl->set_logger_level(logger_name(assignment->name), level);
+    if (!res) {
+      app.error(1, "{}", res.error().what());
+    }
+  }
+  for (auto arg : app.args().filter("--feature")) {
+    auto assignment = parse_assignment(arg);
+    if (!assignment || (assignment->value != "0" && assignment->value != "1")) {
+      app.error(1, "--feature: expected name=0 or name=1, got {}", arg);
+    }
+    auto res = ctl->set_feature(assignment->name, assignment->value == "1");
+    if (!res) {
+      app.error(1, "{}", res.error().what());
+    }
+  }
+  if (app.args().contains("--list")) {
+    print_control(ctl.value());
+  }
+}